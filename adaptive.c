@@ -0,0 +1,244 @@
+/**
+ * adaptive.c
+ *
+ * Implementation of the adaptive Huffman codes
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 18:50
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitstream.h"
+#include "tree.h"
+#include "adaptive.h"
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+// Bit after the code of the new character leaf tells what follows
+enum ESCAPE
+{
+	ESCAPE_CHAR = 0,		// new character follows
+	ESCAPE_END = 1,			// no more characters
+};
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Writes the code of the node (path from the root to the node)
+int put_path(BITSTREAM* bs, ADAPTIVETREE* tree, NODE* node);
+
+// Adds the character to the tree or increments its frequency
+void update_adaptive_tree(ADAPTIVETREE* tree, uchar ch);
+
+// Exchanges the places of two nodes (with their subtrees) in the tree
+void swap_nodes(ADAPTIVETREE* tree, NODE* a, NODE* b);
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Only node has the highest number
+void init_adaptive_tree(ADAPTIVETREE* tree)
+{
+	memset(tree, 0, sizeof(ADAPTIVETREE));
+	tree->root = &tree->nodes[0];
+	tree->nyt = tree->root;
+	tree->node_count = 1;
+	tree->number[0] = ADAPTIVE_NODES - 1;
+	tree->order[ADAPTIVE_NODES - 1] = tree->root;
+}
+
+// Characters seen before are coded with their leaf, new ones with the leaf
+// of new characters followed by the character itself
+int encode_adaptive_chars(BITSTREAM* bs, ADAPTIVETREE* tree, uchar* in, ulong count)
+{
+	ulong i;
+
+	for (i = 0; i < count; i++) {
+		NODE* leaf = tree->node_list[in[i]];
+		if (leaf != NULL) {
+			if (put_path(bs, tree, leaf) == FAILURE) {
+				return FAILURE;
+			}
+		} else if ((put_path(bs, tree, tree->nyt) == FAILURE) ||
+			(bs_write_bits(bs, (ESCAPE_CHAR << UCHAR_WIDTH) | in[i], 1 + UCHAR_WIDTH) == FAILURE)) {
+			return FAILURE;
+		}
+		update_adaptive_tree(tree, in[i]);
+	}
+	return SUCCESS;
+}
+
+// End is coded like the new character without the character
+int encode_adaptive_end(BITSTREAM* bs, ADAPTIVETREE* tree)
+{
+	if (put_path(bs, tree, tree->nyt) == FAILURE) {
+		return FAILURE;
+	}
+	return bs_write_bits(bs, ESCAPE_END, 1);
+}
+
+// Path is walked with the bits peeked from the stream at once, only the
+// used bits are consumed
+int decode_adaptive_chars(BITSTREAM* bs, ADAPTIVETREE* tree, uchar* out, ulong capacity, ulong* count, int* done)
+{
+	uint value;
+	uint used;
+
+	*count = 0;
+	*done = 0;
+	while (*count < capacity) {
+		NODE* node = tree->root;
+		while (node->left != NULL) {
+			if (bs_peek_bits(bs, MAX_PEEK_BITS, &value) == FAILURE) {
+				return FAILURE;
+			}
+			for (used = 0; (used < MAX_PEEK_BITS) && (node->left != NULL); used++) {
+				node = ((value >> (MAX_PEEK_BITS - 1 - used)) & 1) ? node->right : node->left;
+			}
+			if (bs_consume_bits(bs, used) == FAILURE) {
+				return FAILURE;
+			}
+		}
+		if (node == tree->nyt) {
+			if (bs_read_bits(bs, 1, &value) == FAILURE) {
+				return FAILURE;
+			}
+			if (value == ESCAPE_END) {
+				*done = 1;
+				return SUCCESS;
+			}
+			if (bs_read_bits(bs, UCHAR_WIDTH, &value) == FAILURE) {
+				return FAILURE;
+			}
+			if (tree->node_list[value] != NULL) {
+				// Character which is in the tree is never sent again
+				fprintf(stderr, "Archive is corrupted!\n");
+				return FAILURE;
+			}
+			out[(*count)++] = (uchar)value;
+		} else {
+			out[(*count)++] = node->ch;
+		}
+		update_adaptive_tree(tree, out[*count - 1]);
+	}
+	return SUCCESS;
+}
+
+/**
+ * Private methods of the library
+ */
+
+// Path is collected from the node up to the root and written in the
+// opposite order, 32 bits at once
+int put_path(BITSTREAM* bs, ADAPTIVETREE* tree, NODE* node)
+{
+	uchar path[ADAPTIVE_NODES];
+	uint depth = 0;
+	uint value = 0;
+	uint bits = 0;
+
+	for ( ; node != tree->root; node = node->parent) {
+		path[depth++] = (node == node->parent->right);
+	}
+	while (depth > 0) {
+		value = (value << 1) | path[--depth];
+		if (++bits == MAX_PEEK_BITS) {
+			if (bs_write_bits(bs, value, bits) == FAILURE) {
+				return FAILURE;
+			}
+			value = 0;
+			bits = 0;
+		}
+	}
+	return (bits > 0) ? bs_write_bits(bs, value, bits) : SUCCESS;
+}
+
+// New character splits the leaf of new characters into the new leaf of new
+// characters and the leaf of the character, then every node on the way to
+// the root is moved in front of the nodes of the same frequency before
+// its frequency is incremented (FGK)
+void update_adaptive_tree(ADAPTIVETREE* tree, uchar ch)
+{
+	NODE* node = tree->node_list[ch];
+
+	if (node == NULL) {
+		NODE* parent = tree->nyt;
+		uint number = tree->number[parent - tree->nodes];
+		NODE* leaf = &tree->nodes[tree->node_count++];
+		NODE* nyt = &tree->nodes[tree->node_count++];
+
+		memset(leaf, 0, sizeof(NODE));
+		memset(nyt, 0, sizeof(NODE));
+		leaf->ch = ch;
+		leaf->parent = parent;
+		nyt->parent = parent;
+		parent->left = nyt;
+		parent->right = leaf;
+
+		// New nodes get the numbers below their parent
+		tree->number[leaf - tree->nodes] = number - 1;
+		tree->order[number - 1] = leaf;
+		tree->number[nyt - tree->nodes] = number - 2;
+		tree->order[number - 2] = nyt;
+		tree->nyt = nyt;
+		tree->node_list[ch] = leaf;
+		node = leaf;
+	}
+
+	for ( ; node != NULL; node = node->parent) {
+		// Find the node of the highest number with the same frequency
+		uint leader = tree->number[node - tree->nodes];
+		while ((leader + 1 < ADAPTIVE_NODES) && (tree->order[leader + 1]->freq == node->freq)) {
+			leader++;
+		}
+		// Parent has the same frequency only if the other child is the
+		// leaf of new characters, it stays where it is
+		if ((tree->order[leader] != node) && (tree->order[leader] != node->parent)) {
+			swap_nodes(tree, node, tree->order[leader]);
+		}
+		node->freq++;
+	}
+}
+
+// Nodes take the place and the number of each other
+void swap_nodes(ADAPTIVETREE* tree, NODE* a, NODE* b)
+{
+	NODE* parent_a = a->parent;
+	NODE* parent_b = b->parent;
+	uint number_a = tree->number[a - tree->nodes];
+	uint number_b = tree->number[b - tree->nodes];
+
+	if (parent_a == parent_b) {
+		NODE* left = parent_a->left;
+		parent_a->left = parent_a->right;
+		parent_a->right = left;
+	} else {
+		if (parent_a->left == a) {
+			parent_a->left = b;
+		} else {
+			parent_a->right = b;
+		}
+		if (parent_b->left == b) {
+			parent_b->left = a;
+		} else {
+			parent_b->right = a;
+		}
+		a->parent = parent_b;
+		b->parent = parent_a;
+	}
+	tree->number[a - tree->nodes] = number_b;
+	tree->number[b - tree->nodes] = number_a;
+	tree->order[number_b] = a;
+	tree->order[number_a] = b;
+}
@@ -0,0 +1,47 @@
+/**
+ * adaptive.h
+ *
+ * Adaptive Huffman codes (FGK), the tree is updated after every character
+ * by both the encoder and the decoder, so no codes are stored
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 18:50
+ */
+
+#ifndef __INCLUDES_ADAPTIVE_H__
+#define __INCLUDES_ADAPTIVE_H__
+
+// Number of nodes when every character is in the tree (leafs, branches and
+// the leaf of the characters not seen yet)
+#define ADAPTIVE_NODES (2 * MAX_CHAR + 1)
+
+// Tree which changes while the characters are coded, nodes are numbered so
+// that the frequencies never decrease with the number (sibling property)
+typedef struct ADAPTIVETREE
+{
+	NODE* root;							// root of the tree
+	NODE* nyt;							// leaf for the characters not seen yet
+	NODE* node_list[MAX_CHAR];			// leaf of each character (NULL if not seen)
+	NODE nodes[ADAPTIVE_NODES];			// memory of all the nodes
+	uint node_count;					// how many nodes are in use
+	NODE* order[ADAPTIVE_NODES];		// nodes by their number (root is the last)
+	uint number[ADAPTIVE_NODES];		// number of each node of the memory
+} ADAPTIVETREE;
+
+// Prepares the tree which has only the leaf for new characters
+void init_adaptive_tree(ADAPTIVETREE* tree);
+
+// Encodes the characters and updates the tree after each of them
+// Returns error code
+int encode_adaptive_chars(BITSTREAM* bs, ADAPTIVETREE* tree, uchar* in, ulong count);
+
+// Writes the end of the coded characters
+// Returns error code
+int encode_adaptive_end(BITSTREAM* bs, ADAPTIVETREE* tree);
+
+// Decodes up to capacity characters, count tells how many were decoded and
+// done is set when the end was found
+// Returns error code
+int decode_adaptive_chars(BITSTREAM* bs, ADAPTIVETREE* tree, uchar* out, ulong capacity, ulong* count, int* done);
+
+#endif // __INCLUDES_ADAPTIVE_H__
@@ -0,0 +1,1066 @@
+/**
+ * archive.c
+ *
+ * Implementation of the archive of several files
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 22:30
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "bitstream.h"
+#include "compression.h"
+#include "tree.h"
+#include "table.h"
+#include "pool.h"
+#include "histogram.h"
+#include "mapping.h"
+#include "shared.h"
+#include "stats.h"
+#include "archive.h"
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+// How many members and tables are allocated at first
+#define DIRECTORY_INITIAL_CAPACITY 64
+
+// How many batches are given to each thread at once
+#define BATCHES_PER_THREAD 2
+
+// Longest name of the file inside the archive
+#define ARCHIVE_MAX_NAME ((1 << ARCHIVE_NAME_WIDTH) - 1)
+
+// Files of the archive which are coded by the worker thread, either single
+// file or the batch of small files
+typedef struct ARCHIVEJOB
+{
+	MEMBER* members;			// files of the batch (positions are counted
+								// from the output of the job)
+	uint count;					// how many files are in the batch
+	CODINGOPTIONS options;		// how the files are coded
+	SHAREDTABLE table;			// table trained for the batch of small files
+	int shared;					// set if any file of the batch uses the table
+	CODINGSTATS* stats;			// measurements of the job (NULL if not measured)
+	CODINGSTATS measured;		// where the stats point to
+	uchar* output;				// coded files of the batch
+	ulong output_size;			// how many bytes of output are used
+	ulong output_capacity;		// how many bytes are allocated for output
+	int direct;					// set if the large file is coded straight to
+								// the archive when it is written
+	int result;					// error code of the job
+} ARCHIVEJOB;
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Prepares empty directory
+void init_directory(DIRECTORY* directory);
+
+// Releases the names and the tables of the directory
+void release_directory(DIRECTORY* directory);
+
+// Adds the file of given name and size to the directory (name is copied)
+// Returns error code
+int add_member(DIRECTORY* directory, const char* name, uint64 size);
+
+// Adds the table to the directory (decoding table of it is owned by the
+// directory after that)
+// Returns error code
+int add_table(DIRECTORY* directory, SHAREDTABLE* table);
+
+// Adds the file at the path or all files in the directory at the path
+// Returns error code
+int collect_path(DIRECTORY* directory, const char* path, int follow);
+
+// Compares the names of the directory entries for sorting
+int compare_names(const void* a, const void* b);
+
+// Returns the name of the file inside the archive (path without the leading
+// slashes, current and parent directories)
+const char* archive_name(const char* path);
+
+// Tells if the name may be extracted below the target directory
+int is_safe_name(const char* name);
+
+// Codes the files of the job to its output
+void archive_job(void* arg);
+
+// Makes sure the buffer can hold at least size bytes
+int reserve_memory(uchar** buffer, ulong* capacity, ulong size);
+
+// Codes the large file straight to the archive
+// Returns error code
+int put_large_member(BITSTREAM* bs, MEMBER* member, CONTEXT* context, CODINGSTATS* stats);
+
+// Writes the tables, the files and the footer of the archive
+// Returns error code
+int put_directory(BITSTREAM* bs, DIRECTORY* directory, uint64 position);
+
+// Reads the directory from the end of the archive (file must be seekable)
+// Returns error code
+int get_directory(FILE* file_in, DIRECTORY* directory);
+
+// Finds the table of given identifier (NULL if there is none)
+SHAREDTABLE* find_table(DIRECTORY* directory, uint id);
+
+// Decodes the file of the archive and writes it to file_out
+// Returns error code
+int decode_member(FILE* file_in, DIRECTORY* directory, MEMBER* member, CONTEXT* context, FILE* file_out);
+
+// Creates the directories on the path of the file which do not exist yet
+// Returns error code
+int create_parents(char* path);
+
+// Writes 64-bit value in two halves
+int put_wide(BITSTREAM* bs, uint64 value);
+
+// Reads 64-bit value in two halves
+int get_wide(BITSTREAM* bs, uint64* value);
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Files are collected first, then coded in batches by the pool and written
+// in the order of the directory, so the archive does not depend on the
+// number of threads
+int create_archive(char** paths, uint path_count, FILE* file_out, CODINGOPTIONS* options)
+{
+	DIRECTORY directory;
+	ARCHIVEJOB* jobs;
+	POOL* pool;
+	BITSTREAM* bs;
+	CONTEXT* context;
+	CODINGSTATS* stats = options->stats;
+	double total = start_phase(stats);
+	uint threads = (options->threads > 0) ? options->threads : 1;
+	uint job_count = threads * BATCHES_PER_THREAD;
+	uint next = 0;
+	uint table_id = 0;
+	uint count;
+	uint i;
+	uint j;
+	uint64 position;
+	int result = SUCCESS;
+
+	// Find out the files and their sizes
+	init_directory(&directory);
+	for (i = 0; i < path_count; i++) {
+		if (collect_path(&directory, paths[i], 1) == FAILURE) {
+			release_directory(&directory);
+			return FAILURE;
+		}
+	}
+	for (i = 0; i < directory.count; i++) {
+		if (strlen(archive_name(directory.members[i].name)) > ARCHIVE_MAX_NAME) {
+			fprintf(stderr, "Name of the file is too long: %s\n", directory.members[i].name);
+			release_directory(&directory);
+			return FAILURE;
+		}
+	}
+
+	// Prepare the jobs, every job codes the files of its batch as the
+	// buffers of the container format
+	jobs = (ARCHIVEJOB*)calloc(job_count, sizeof(ARCHIVEJOB));
+	if (jobs == NULL) {
+		perror("Could not allocate memory for archive jobs (out of memory)");
+		release_directory(&directory);
+		return FAILURE;
+	}
+	for (i = 0; i < job_count; i++) {
+		jobs[i].options = *options;
+		jobs[i].options.legacy = 0;
+		jobs[i].options.sync_interval = 0;
+		jobs[i].options.stats = NULL;
+		if (stats != NULL) {
+			init_stats(&jobs[i].measured);
+			jobs[i].stats = &jobs[i].measured;
+		}
+	}
+	pool = pool_create(threads);
+	bs = bs_create(file_out, WRITE);
+	context = create_context(&jobs[0].options);
+	if ((pool == NULL) || (bs == NULL) || (context == NULL) ||
+		(bs_write_bits(bs, ARCHIVE_MAGIC, ARCHIVE_MAGIC_WIDTH) == FAILURE) ||
+		(bs_write_bits(bs, ARCHIVE_VERSION, ARCHIVE_VERSION_WIDTH) == FAILURE)) {
+		result = FAILURE;
+	}
+
+	while ((result == SUCCESS) && (next < directory.count)) {
+		// Small files which follow each other form the batch, other files
+		// are coded alone
+		for (count = 0; (count < job_count) && (next < directory.count); count++) {
+			ARCHIVEJOB* job = &jobs[count];
+			uint64 batch_size = directory.members[next].size;
+			job->members = &directory.members[next];
+			job->count = 1;
+			job->direct = (batch_size > ARCHIVE_LARGE_FILE);
+			job->table.id = table_id++;
+			if (batch_size < ARCHIVE_SMALL_FILE) {
+				while ((next + job->count < directory.count) && (job->count < ARCHIVE_BATCH_FILES) &&
+					(directory.members[next + job->count].size < ARCHIVE_SMALL_FILE) &&
+					(batch_size + directory.members[next + job->count].size <= ARCHIVE_BATCH_SIZE)) {
+					batch_size += directory.members[next + job->count].size;
+					job->count++;
+				}
+			}
+			next += job->count;
+		}
+		pool_run(pool, archive_job, jobs, sizeof(ARCHIVEJOB), count);
+
+		// Write the coded files in the order of the directory and keep the
+		// tables which were used
+		for (i = 0; i < count; i++) {
+			if (jobs[i].result == FAILURE) {
+				result = FAILURE;
+			}
+			if ((result == SUCCESS) && jobs[i].direct) {
+				result = put_large_member(bs, jobs[i].members, context, stats);
+			} else if (result == SUCCESS) {
+				position = bs_tell(bs) / UCHAR_WIDTH;
+				for (j = 0; j < jobs[i].count; j++) {
+					jobs[i].members[j].position += position;
+				}
+				if (bs_write_bytes(bs, jobs[i].output, jobs[i].output_size) == FAILURE) {
+					result = FAILURE;
+				}
+			}
+			if ((result == SUCCESS) && jobs[i].shared) {
+				if (add_table(&directory, &jobs[i].table) == FAILURE) {
+					result = FAILURE;
+				}
+			} else {
+				release_shared_table(&jobs[i].table);
+			}
+			if (stats != NULL) {
+				merge_stats(stats, &jobs[i].measured);
+				init_stats(&jobs[i].measured);
+			}
+		}
+	}
+
+	// Directory follows the last file
+	if ((result == SUCCESS) && (put_directory(bs, &directory, bs_tell(bs) / UCHAR_WIDTH) == FAILURE)) {
+		result = FAILURE;
+	}
+	if ((result == SUCCESS) && (stats != NULL)) {
+		stats->output_bytes += bs_tell(bs) / UCHAR_WIDTH;
+	}
+	if ((bs != NULL) && (bs_destroy(bs) == FAILURE)) {
+		result = FAILURE;
+	}
+	if (pool != NULL) {
+		pool_destroy(pool);
+	}
+	if (context != NULL) {
+		release_context(context);
+	}
+	for (i = 0; i < job_count; i++) {
+		free(jobs[i].output);
+	}
+	free(jobs);
+	release_directory(&directory);
+	if ((result == SUCCESS) && (stats != NULL)) {
+		end_total(stats, total);
+	}
+	return result;
+}
+
+// Table column tells the identifier of the shared table
+int list_archive(FILE* file_in, FILE* file_out)
+{
+	DIRECTORY directory;
+	uint i;
+
+	if (get_directory(file_in, &directory) == FAILURE) {
+		return FAILURE;
+	}
+	fprintf(file_out, "%12s %12s %8s  %s\n", "size", "coded", "table", "name");
+	for (i = 0; i < directory.count; i++) {
+		MEMBER* member = &directory.members[i];
+		if (member->table == ARCHIVE_OWN_CODES) {
+			fprintf(file_out, "%12llu %12llu %8s  %s\n", member->size, member->stored_size, "-", member->name);
+		} else {
+			fprintf(file_out, "%12llu %12llu %8u  %s\n", member->size, member->stored_size, member->table, member->name);
+		}
+	}
+	release_directory(&directory);
+	return SUCCESS;
+}
+
+// Only the directory and the coded file itself are read
+int extract_member(FILE* file_in, const char* name, FILE* file_out)
+{
+	DIRECTORY directory;
+	CONTEXT* context;
+	CODINGOPTIONS options;
+	int result = FAILURE;
+	uint i;
+
+	if (get_directory(file_in, &directory) == FAILURE) {
+		return FAILURE;
+	}
+	for (i = 0; i < directory.count; i++) {
+		if (strcmp(directory.members[i].name, name) == 0) {
+			break;
+		}
+	}
+	if (i == directory.count) {
+		fprintf(stderr, "Archive has no file %s\n", name);
+		release_directory(&directory);
+		return FAILURE;
+	}
+	init_coding_options(&options);
+	context = create_context(&options);
+	if (context != NULL) {
+		result = decode_member(file_in, &directory, &directory.members[i], context, file_out);
+		release_context(context);
+	}
+	release_directory(&directory);
+	return result;
+}
+
+// Names which would leave the target directory are refused before anything
+// is written
+int extract_archive(FILE* file_in, const char* path)
+{
+	DIRECTORY directory;
+	CONTEXT* context;
+	CODINGOPTIONS options;
+	FILE* file_out;
+	char* target = NULL;
+	size_t length = strlen(path);
+	int result = SUCCESS;
+	uint i;
+
+	if (get_directory(file_in, &directory) == FAILURE) {
+		return FAILURE;
+	}
+	for (i = 0; i < directory.count; i++) {
+		if (!is_safe_name(directory.members[i].name)) {
+			fprintf(stderr, "Archive has unsafe name %s\n", directory.members[i].name);
+			release_directory(&directory);
+			return FAILURE;
+		}
+	}
+	init_coding_options(&options);
+	context = create_context(&options);
+	if (context == NULL) {
+		release_directory(&directory);
+		return FAILURE;
+	}
+
+	for (i = 0; (i < directory.count) && (result == SUCCESS); i++) {
+		MEMBER* member = &directory.members[i];
+		target = (char*)malloc(length + strlen(member->name) + 2);
+		if (target == NULL) {
+			perror("Could not allocate memory for file name (out of memory)");
+			result = FAILURE;
+			break;
+		}
+		sprintf(target, "%s/%s", path, member->name);
+		if (create_parents(target) == FAILURE) {
+			result = FAILURE;
+		} else if ((file_out = fopen(target, "wb")) == NULL) {
+			perror("Could not open output file");
+			result = FAILURE;
+		} else {
+			result = decode_member(file_in, &directory, member, context, file_out);
+			if (fclose(file_out) == EOF) {
+				perror("Error occured when writing the file");
+				result = FAILURE;
+			}
+		}
+		free(target);
+	}
+	release_context(context);
+	release_directory(&directory);
+	return result;
+}
+
+/**
+ * Private methods of the library
+ */
+
+// Directory has no files or tables at first
+void init_directory(DIRECTORY* directory)
+{
+	memset(directory, 0, sizeof(DIRECTORY));
+}
+
+// Decoding tables are released with the names
+void release_directory(DIRECTORY* directory)
+{
+	uint i;
+
+	for (i = 0; i < directory->count; i++) {
+		free(directory->members[i].name);
+	}
+	for (i = 0; i < directory->table_count; i++) {
+		release_shared_table(&directory->tables[i]);
+	}
+	free(directory->members);
+	free(directory->tables);
+	init_directory(directory);
+}
+
+// List is doubled when it is full, the same way as the block index
+int add_member(DIRECTORY* directory, const char* name, uint64 size)
+{
+	MEMBER* member;
+
+	if (directory->count == directory->capacity) {
+		uint capacity = (directory->capacity > 0) ? 2 * directory->capacity : DIRECTORY_INITIAL_CAPACITY;
+		MEMBER* members = (MEMBER*)realloc(directory->members, capacity * sizeof(MEMBER));
+		if (members == NULL) {
+			perror("Could not allocate memory for archive directory (out of memory)");
+			return FAILURE;
+		}
+		directory->members = members;
+		directory->capacity = capacity;
+	}
+	member = &directory->members[directory->count];
+	memset(member, 0, sizeof(MEMBER));
+	member->name = (char*)malloc(strlen(name) + 1);
+	if (member->name == NULL) {
+		perror("Could not allocate memory for archive directory (out of memory)");
+		return FAILURE;
+	}
+	strcpy(member->name, name);
+	member->size = size;
+	member->table = ARCHIVE_OWN_CODES;
+	directory->count++;
+	return SUCCESS;
+}
+
+// Tables are added in the order of their identifiers
+int add_table(DIRECTORY* directory, SHAREDTABLE* table)
+{
+	if (directory->table_count == directory->table_capacity) {
+		uint capacity = (directory->table_capacity > 0) ? 2 * directory->table_capacity : DIRECTORY_INITIAL_CAPACITY;
+		SHAREDTABLE* tables = (SHAREDTABLE*)realloc(directory->tables, capacity * sizeof(SHAREDTABLE));
+		if (tables == NULL) {
+			perror("Could not allocate memory for archive directory (out of memory)");
+			return FAILURE;
+		}
+		directory->tables = tables;
+		directory->table_capacity = capacity;
+	}
+	directory->tables[directory->table_count++] = *table;
+	table->table = NULL;
+	return SUCCESS;
+}
+
+// Entries of the directory are sorted, so the archive is the same on every
+// file system, links found inside the directories are not followed
+int collect_path(DIRECTORY* directory, const char* path, int follow)
+{
+	struct stat info;
+	DIR* dir;
+	struct dirent* entry;
+	char** names = NULL;
+	uint count = 0;
+	uint capacity = 0;
+	char* child;
+	int result = SUCCESS;
+	uint i;
+
+	if ((follow ? stat(path, &info) : lstat(path, &info)) == -1) {
+		fprintf(stderr, "Could not read %s: %s\n", path, strerror(errno));
+		return FAILURE;
+	}
+	if (S_ISREG(info.st_mode)) {
+		return add_member(directory, path, (uint64)info.st_size);
+	}
+	if (!S_ISDIR(info.st_mode)) {
+		// Other entries of the directories are skipped
+		if (follow) {
+			fprintf(stderr, "Not a file or directory: %s\n", path);
+			return FAILURE;
+		}
+		return SUCCESS;
+	}
+
+	// Read the names of the directory first
+	dir = opendir(path);
+	if (dir == NULL) {
+		fprintf(stderr, "Could not read %s: %s\n", path, strerror(errno));
+		return FAILURE;
+	}
+	while ((entry = readdir(dir)) != NULL) {
+		if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0)) {
+			continue;
+		}
+		if (count == capacity) {
+			char** memory;
+			capacity = (capacity > 0) ? 2 * capacity : DIRECTORY_INITIAL_CAPACITY;
+			memory = (char**)realloc(names, capacity * sizeof(char*));
+			if (memory == NULL) {
+				perror("Could not allocate memory for file names (out of memory)");
+				result = FAILURE;
+				break;
+			}
+			names = memory;
+		}
+		names[count] = (char*)malloc(strlen(path) + strlen(entry->d_name) + 2);
+		if (names[count] == NULL) {
+			perror("Could not allocate memory for file names (out of memory)");
+			result = FAILURE;
+			break;
+		}
+		child = names[count++];
+		strcpy(child, path);
+		if ((child[0] != '\0') && (child[strlen(child) - 1] != '/')) {
+			strcat(child, "/");
+		}
+		strcat(child, entry->d_name);
+	}
+	closedir(dir);
+
+	// Then add the files of the sorted names
+	if (result == SUCCESS) {
+		qsort(names, count, sizeof(char*), compare_names);
+	}
+	for (i = 0; i < count; i++) {
+		if ((result == SUCCESS) && (collect_path(directory, names[i], 0) == FAILURE)) {
+			result = FAILURE;
+		}
+		free(names[i]);
+	}
+	free(names);
+	return result;
+}
+
+// Names are compared byte by byte, so the order does not depend on locale
+int compare_names(const void* a, const void* b)
+{
+	return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Archive stores relative names only
+const char* archive_name(const char* path)
+{
+	for (;;) {
+		if (path[0] == '/') {
+			path++;
+		} else if ((path[0] == '.') && (path[1] == '/')) {
+			path += 2;
+		} else if ((path[0] == '.') && (path[1] == '.') && (path[2] == '/')) {
+			path += 3;
+		} else {
+			return path;
+		}
+	}
+}
+
+// Name must be relative and must not go up from any directory
+int is_safe_name(const char* name)
+{
+	const char* part = name;
+
+	if ((name[0] == '\0') || (name[0] == '/')) {
+		return 0;
+	}
+	while (part != NULL) {
+		if ((strncmp(part, "..", 2) == 0) && ((part[2] == '/') || (part[2] == '\0'))) {
+			return 0;
+		}
+		part = strchr(part, '/');
+		if (part != NULL) {
+			part++;
+		}
+	}
+	return 1;
+}
+
+// Every file gets the codes of its own, files of the batch are coded with
+// the table of the whole batch instead when it gives shorter result (size
+// is known from the character counts, so they are not coded twice)
+void archive_job(void* arg)
+{
+	ARCHIVEJOB* job = (ARCHIVEJOB*)arg;
+	MAPPING* maps;
+	CONTEXT* context;
+	FREQTABLE freq_table;
+	ulong capacity = 0;
+	ulong size;
+	uint64 input_bytes = 0;
+	double phase;
+	uint mapped;
+	int ready;
+	uint i;
+
+	job->result = FAILURE;
+	job->output_size = 0;
+	job->shared = 0;
+	// Large file is left to the writer, so it never needs the buffer
+	if (job->direct) {
+		job->result = SUCCESS;
+		return;
+	}
+	maps = (MAPPING*)calloc(job->count, sizeof(MAPPING));
+	context = create_context(&job->options);
+	if ((maps == NULL) || (context == NULL)) {
+		if (maps == NULL) {
+			perror("Could not allocate memory for archive files (out of memory)");
+		}
+		free(maps);
+		if (context != NULL) {
+			release_context(context);
+		}
+		return;
+	}
+
+	// Read the files of the batch and count their characters for the table
+	memset(freq_table, 0, sizeof(FREQTABLE));
+	for (mapped = 0; mapped < job->count; mapped++) {
+		MEMBER* member = &job->members[mapped];
+		phase = start_phase(job->stats);
+		if (map_input(member->name, &maps[mapped]) == FAILURE) {
+			fprintf(stderr, "Could not read %s\n", member->name);
+			break;
+		}
+		end_phase(job->stats, PHASE_IO, phase);
+		member->size = maps[mapped].size;
+		input_bytes += member->size;
+		capacity += compress_bound((ulong)member->size);
+		if (job->count > 1) {
+			phase = start_phase(job->stats);
+			histogram_add(maps[mapped].data, (ulong)member->size, freq_table);
+			end_phase(job->stats, PHASE_HISTOGRAM, phase);
+		}
+	}
+	ready = (mapped == job->count);
+	if (ready && (job->count > 1)) {
+		phase = start_phase(job->stats);
+		ready = (train_shared_table(freq_table, job->table.id, job->options.max_length, &job->table) == SUCCESS);
+		end_phase(job->stats, PHASE_CODES, phase);
+	}
+
+	// Code the files one after another
+	if (ready && (reserve_memory(&job->output, &job->output_capacity, capacity) == SUCCESS)) {
+		for (i = 0; i < job->count; i++) {
+			MEMBER* member = &job->members[i];
+			uchar* out = &job->output[job->output_size];
+			phase = start_phase(job->stats);
+			if (encode_buffer(context, maps[i].data, (ulong)member->size, out, job->output_capacity - job->output_size, &size) == FAILURE) {
+				break;
+			}
+			member->table = ARCHIVE_OWN_CODES;
+			if (job->count > 1) {
+				histogram_block(maps[i].data, (ulong)member->size, freq_table);
+				if (shared_size(&job->table, freq_table) < size) {
+					if (encode_shared(&job->table, maps[i].data, (ulong)member->size, out, size, &size) == FAILURE) {
+						break;
+					}
+					member->table = job->table.id;
+					job->shared = 1;
+				}
+			}
+			end_phase(job->stats, PHASE_CODING, phase);
+			count_symbols(job->stats, maps[i].data, (ulong)member->size);
+			member->position = job->output_size;
+			member->stored_size = size;
+			job->output_size += size;
+		}
+		if (i == job->count) {
+			job->result = SUCCESS;
+		}
+	}
+	if (job->stats != NULL) {
+		job->stats->input_bytes += input_bytes;
+		job->stats->blocks += job->count;
+	}
+
+	for (i = 0; i < mapped; i++) {
+		unmap_file(&maps[i]);
+	}
+	free(maps);
+	release_context(context);
+}
+
+// Buffer grows to the exact size
+int reserve_memory(uchar** buffer, ulong* capacity, ulong size)
+{
+	uchar* memory;
+
+	if (size <= *capacity) {
+		return SUCCESS;
+	}
+	memory = (uchar*)realloc(*buffer, size);
+	if (memory == NULL) {
+		perror("Could not allocate memory for archive buffer (out of memory)");
+		return FAILURE;
+	}
+	*buffer = memory;
+	*capacity = size;
+	return SUCCESS;
+}
+
+// File is mapped, so only the pages being coded are in memory, coded size is
+// what the stream grows by
+int put_large_member(BITSTREAM* bs, MEMBER* member, CONTEXT* context, CODINGSTATS* stats)
+{
+	MAPPING input;
+	double phase;
+	int result;
+
+	phase = start_phase(stats);
+	if (map_input(member->name, &input) == FAILURE) {
+		fprintf(stderr, "Could not read %s\n", member->name);
+		return FAILURE;
+	}
+	end_phase(stats, PHASE_IO, phase);
+	member->size = input.size;
+	member->position = bs_tell(bs) / UCHAR_WIDTH;
+	phase = start_phase(stats);
+	result = encode_buffer_stream(context, input.data, (ulong)input.size, bs);
+	end_phase(stats, PHASE_CODING, phase);
+	member->stored_size = bs_tell(bs) / UCHAR_WIDTH - member->position;
+	if ((result == SUCCESS) && (stats != NULL)) {
+		count_symbols(stats, input.data, (ulong)input.size);
+		stats->input_bytes += input.size;
+		stats->blocks++;
+	}
+	unmap_file(&input);
+	return result;
+}
+
+// Directory has the tables and the files, footer after the byte boundary
+// tells where the directory starts
+int put_directory(BITSTREAM* bs, DIRECTORY* directory, uint64 position)
+{
+	uint i;
+	const char* name;
+
+	if (bs_write_bits(bs, directory->table_count, ARCHIVE_COUNT_WIDTH) == FAILURE) {
+		return FAILURE;
+	}
+	for (i = 0; i < directory->table_count; i++) {
+		if (put_shared_table(bs, &directory->tables[i]) == FAILURE) {
+			return FAILURE;
+		}
+	}
+	if (bs_write_bits(bs, directory->count, ARCHIVE_COUNT_WIDTH) == FAILURE) {
+		return FAILURE;
+	}
+	for (i = 0; i < directory->count; i++) {
+		MEMBER* member = &directory->members[i];
+		name = archive_name(member->name);
+		if (bs_write_bits(bs, (uint)strlen(name), ARCHIVE_NAME_WIDTH) == FAILURE) {
+			return FAILURE;
+		}
+		for (; *name != '\0'; name++) {
+			if (bs_write_bits(bs, (uchar)*name, UCHAR_WIDTH) == FAILURE) {
+				return FAILURE;
+			}
+		}
+		if ((put_wide(bs, member->size) == FAILURE) ||
+			(put_wide(bs, member->position) == FAILURE) ||
+			(put_wide(bs, member->stored_size) == FAILURE) ||
+			(bs_write_bits(bs, member->table, ARCHIVE_TABLE_WIDTH) == FAILURE)) {
+			return FAILURE;
+		}
+	}
+	if ((bs_align(bs) == FAILURE) ||
+		(put_wide(bs, position) == FAILURE) ||
+		(bs_write_bits(bs, DIRECTORY_MAGIC, ARCHIVE_MAGIC_WIDTH) == FAILURE)) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// Every file must lie between the header and the directory and refer to
+// the table which the directory has
+int get_directory(FILE* file_in, DIRECTORY* directory)
+{
+	BITSTREAM* bs;
+	SHAREDTABLE table;
+	uint64 position;
+	uint magic;
+	uint version;
+	uint count;
+	uint length;
+	uint value;
+	long end;
+	uint i;
+	uint j;
+
+	init_directory(directory);
+	if (fseek(file_in, 0, SEEK_SET)) {
+		perror("Could not seek the archive");
+		return FAILURE;
+	}
+	bs = bs_create(file_in, READ);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	if ((bs_read_bits(bs, ARCHIVE_MAGIC_WIDTH, &magic) == FAILURE) ||
+		(bs_read_bits(bs, ARCHIVE_VERSION_WIDTH, &version) == FAILURE)) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	bs_destroy(bs);
+	if (magic != ARCHIVE_MAGIC) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	if (version > ARCHIVE_VERSION) {
+		fprintf(stderr, "Archive was created by newer version of the program!\n");
+		return FAILURE;
+	}
+
+	// Footer tells where the directory is
+	if (fseek(file_in, -ARCHIVE_FOOTER_SIZE, SEEK_END) || ((end = ftell(file_in)) == -1L)) {
+		perror("Could not seek the archive directory");
+		return FAILURE;
+	}
+	bs = bs_create(file_in, READ);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	if ((get_wide(bs, &position) == FAILURE) || (bs_read_bits(bs, ARCHIVE_MAGIC_WIDTH, &magic) == FAILURE)) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	bs_destroy(bs);
+	if ((magic != DIRECTORY_MAGIC) || (position < ARCHIVE_HEADER_SIZE) || (position > (uint64)end)) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	if (fseek(file_in, (long)position, SEEK_SET)) {
+		perror("Could not seek the archive directory");
+		return FAILURE;
+	}
+	bs = bs_create(file_in, READ);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+
+	// Read the tables, their identifiers grow
+	if (bs_read_bits(bs, ARCHIVE_COUNT_WIDTH, &count) == FAILURE) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	for (i = 0; i < count; i++) {
+		if (get_shared_table(bs, &table) == FAILURE) {
+			release_shared_table(&table);
+			bs_destroy(bs);
+			release_directory(directory);
+			return FAILURE;
+		}
+		if ((i > 0) && (table.id <= directory->tables[i - 1].id)) {
+			fprintf(stderr, "Archive is corrupted!\n");
+			release_shared_table(&table);
+			bs_destroy(bs);
+			release_directory(directory);
+			return FAILURE;
+		}
+		if (add_table(directory, &table) == FAILURE) {
+			release_shared_table(&table);
+			bs_destroy(bs);
+			release_directory(directory);
+			return FAILURE;
+		}
+	}
+
+	// Read the files
+	if (bs_read_bits(bs, ARCHIVE_COUNT_WIDTH, &count) == FAILURE) {
+		bs_destroy(bs);
+		release_directory(directory);
+		return FAILURE;
+	}
+	for (i = 0; i < count; i++) {
+		MEMBER* member;
+		char* name;
+		if (bs_read_bits(bs, ARCHIVE_NAME_WIDTH, &length) == FAILURE) {
+			bs_destroy(bs);
+			release_directory(directory);
+			return FAILURE;
+		}
+		name = (char*)malloc(length + 1);
+		if (name == NULL) {
+			perror("Could not allocate memory for archive directory (out of memory)");
+			bs_destroy(bs);
+			release_directory(directory);
+			return FAILURE;
+		}
+		for (j = 0; j < length; j++) {
+			if (bs_read_bits(bs, UCHAR_WIDTH, &value) == FAILURE) {
+				break;
+			}
+			name[j] = (char)value;
+		}
+		name[j] = '\0';
+		if ((j < length) || (strlen(name) != length) || (add_member(directory, name, 0) == FAILURE)) {
+			if ((j == length) && (strlen(name) != length)) {
+				fprintf(stderr, "Archive is corrupted!\n");
+			}
+			free(name);
+			bs_destroy(bs);
+			release_directory(directory);
+			return FAILURE;
+		}
+		free(name);
+		member = &directory->members[i];
+		if ((get_wide(bs, &member->size) == FAILURE) ||
+			(get_wide(bs, &member->position) == FAILURE) ||
+			(get_wide(bs, &member->stored_size) == FAILURE) ||
+			(bs_read_bits(bs, ARCHIVE_TABLE_WIDTH, &member->table) == FAILURE)) {
+			bs_destroy(bs);
+			release_directory(directory);
+			return FAILURE;
+		}
+		if ((member->position < ARCHIVE_HEADER_SIZE) || (member->position > position) ||
+			(member->stored_size > position - member->position) ||
+			((member->table != ARCHIVE_OWN_CODES) && ((member->size >= ARCHIVE_SMALL_FILE) || (find_table(directory, member->table) == NULL)))) {
+			fprintf(stderr, "Archive is corrupted!\n");
+			bs_destroy(bs);
+			release_directory(directory);
+			return FAILURE;
+		}
+	}
+	bs_destroy(bs);
+	return SUCCESS;
+}
+
+// Identifiers of the tables are sorted, so the table is found by bisection
+SHAREDTABLE* find_table(DIRECTORY* directory, uint id)
+{
+	uint low = 0;
+	uint high = directory->table_count;
+
+	while (low < high) {
+		uint middle = low + (high - low) / 2;
+		if (directory->tables[middle].id < id) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return ((low < directory->table_count) && (directory->tables[low].id == id)) ? &directory->tables[low] : NULL;
+}
+
+// Coded file is read at once and decoded to the memory, the decoded size
+// must match the directory, large file is decoded from the archive chunk by
+// chunk instead (no coded file is ever larger than its bound, so corrupted
+// sizes are refused before anything is allocated)
+int decode_member(FILE* file_in, DIRECTORY* directory, MEMBER* member, CONTEXT* context, FILE* file_out)
+{
+	BITSTREAM* bs;
+	uchar* input;
+	uchar* output;
+	ulong size;
+	int result;
+
+	if (member->size > ARCHIVE_LARGE_FILE) {
+		if (fseek(file_in, (long)member->position, SEEK_SET)) {
+			perror("Could not seek the archive");
+			return FAILURE;
+		}
+		bs = bs_create(file_in, READ);
+		if (bs == NULL) {
+			return FAILURE;
+		}
+		result = decode_buffer_stream(bs, member->stored_size, file_out, member->size);
+		bs_destroy(bs);
+		return result;
+	}
+	if (member->stored_size > compress_bound((ulong)member->size)) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	input = (uchar*)malloc((size_t)member->stored_size + 1);
+	output = (uchar*)malloc((size_t)member->size + 1);
+	if ((input == NULL) || (output == NULL)) {
+		perror("Could not allocate memory for archive file (out of memory)");
+		free(input);
+		free(output);
+		return FAILURE;
+	}
+	if (fseek(file_in, (long)member->position, SEEK_SET) ||
+		(fread(input, 1, (size_t)member->stored_size, file_in) != member->stored_size)) {
+		if (ferror(file_in)) {
+			perror("Error occured when reading the file");
+		} else {
+			fprintf(stderr, "Unexpected end of file!\n");
+		}
+		free(input);
+		free(output);
+		return FAILURE;
+	}
+	if (member->table == ARCHIVE_OWN_CODES) {
+		result = decode_buffer(context, input, (ulong)member->stored_size, output, (ulong)member->size, &size);
+	} else {
+		result = decode_shared(find_table(directory, member->table), input, (ulong)member->stored_size, output, (ulong)member->size, &size);
+	}
+	if ((result == SUCCESS) && (size != member->size)) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		result = FAILURE;
+	}
+	if ((result == SUCCESS) && (fwrite(output, 1, size, file_out) != size)) {
+		perror("Error occured when writing the file");
+		result = FAILURE;
+	}
+	free(input);
+	free(output);
+	return result;
+}
+
+// Every directory on the path is created in turn, existing ones are fine
+int create_parents(char* path)
+{
+	char* slash = strchr(path, '/');
+
+	while (slash != NULL) {
+		if (slash != path) {
+			*slash = '\0';
+			if ((mkdir(path, 0777) == -1) && (errno != EEXIST)) {
+				fprintf(stderr, "Could not create directory %s: %s\n", path, strerror(errno));
+				*slash = '/';
+				return FAILURE;
+			}
+			*slash = '/';
+		}
+		slash = strchr(slash + 1, '/');
+	}
+	return SUCCESS;
+}
+
+// Same layout as the positions of the block index
+int put_wide(BITSTREAM* bs, uint64 value)
+{
+	if ((bs_write_bits(bs, (uint)(value >> 32), ARCHIVE_POSITION_WIDTH / 2) == FAILURE) ||
+		(bs_write_bits(bs, (uint)value, ARCHIVE_POSITION_WIDTH / 2) == FAILURE)) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// High half comes first
+int get_wide(BITSTREAM* bs, uint64* value)
+{
+	uint high;
+	uint low;
+
+	if ((bs_read_bits(bs, ARCHIVE_POSITION_WIDTH / 2, &high) == FAILURE) ||
+		(bs_read_bits(bs, ARCHIVE_POSITION_WIDTH / 2, &low) == FAILURE)) {
+		return FAILURE;
+	}
+	*value = ((uint64)high << 32) | low;
+	return SUCCESS;
+}
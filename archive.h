@@ -0,0 +1,102 @@
+/**
+ * archive.h
+ *
+ * Archive of several files, each file is coded on its own (small files may
+ * share the code table) and the directory at the end of the archive tells
+ * where every file is, so single files are decoded without the others
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 22:30
+ */
+
+#ifndef __INCLUDES_ARCHIVE_H__
+#define __INCLUDES_ARCHIVE_H__
+
+#ifndef __UINT_DEFINED__
+#define __UINT_DEFINED__
+typedef unsigned int uint;
+#endif
+
+#ifndef __UINT64_DEFINED__
+#define __UINT64_DEFINED__
+typedef unsigned long long uint64;
+#endif
+
+// First 32 bits of the archive ("HUA" and 0x1A)
+#define ARCHIVE_MAGIC 0x4855411A
+
+// Last 32 bits of the archive, after the position of the directory ("HUD"
+// and 0x1A)
+#define DIRECTORY_MAGIC 0x4855441A
+
+// Latest version of the archive format
+#define ARCHIVE_VERSION 1
+
+// Width of the fields of the archive header, directory and footer
+#define ARCHIVE_MAGIC_WIDTH 32
+#define ARCHIVE_VERSION_WIDTH 8
+#define ARCHIVE_COUNT_WIDTH 32
+#define ARCHIVE_TABLE_WIDTH 32
+#define ARCHIVE_NAME_WIDTH 16
+#define ARCHIVE_POSITION_WIDTH 64
+
+// Size of the archive header and the footer in bytes
+#define ARCHIVE_HEADER_SIZE ((ARCHIVE_MAGIC_WIDTH + ARCHIVE_VERSION_WIDTH) / 8)
+#define ARCHIVE_FOOTER_SIZE ((ARCHIVE_POSITION_WIDTH + ARCHIVE_MAGIC_WIDTH) / 8)
+
+// Table of the file which has codes of its own
+#define ARCHIVE_OWN_CODES 0xFFFFFFFF
+
+// Files smaller than this are coded in batches which share the code table
+#define ARCHIVE_SMALL_FILE 16384
+
+// Most characters and files in single batch of small files
+#define ARCHIVE_BATCH_SIZE 1048576
+#define ARCHIVE_BATCH_FILES 1024
+
+// Files larger than this are coded straight to the archive and decoded
+// straight from it instead of the buffers in memory
+#define ARCHIVE_LARGE_FILE 16777216
+
+// Describes single file of the archive
+typedef struct MEMBER
+{
+	char* name;					// path of the file inside the archive
+	uint64 size;				// original length of the file
+	uint64 position;			// where the coded file starts in the archive
+	uint64 stored_size;			// how many bytes the coded file takes
+	uint table;					// identifier of the shared table which codes
+								// the file (ARCHIVE_OWN_CODES for none)
+} MEMBER;
+
+// List of the files and the shared tables of the archive
+typedef struct DIRECTORY
+{
+	MEMBER* members;			// files in the order of the archive
+	uint count;					// how many files are in the list
+	uint capacity;				// how many members are allocated
+	struct SHAREDTABLE* tables;	// shared tables in the order of their identifiers
+	uint table_count;			// how many tables are in the list
+	uint table_capacity;		// how many tables are allocated
+} DIRECTORY;
+
+// Codes the files and the files in the directories (recursively) at given
+// paths to the archive, files are coded by the threads of the options
+// Returns error code
+int create_archive(char** paths, uint path_count, FILE* file_out, CODINGOPTIONS* options);
+
+// Writes the name, size, coded size and the table of every file in the
+// archive (file_in must be seekable)
+// Returns error code
+int list_archive(FILE* file_in, FILE* file_out);
+
+// Decodes the file of given name from the archive (file_in must be seekable)
+// Returns error code
+int extract_member(FILE* file_in, const char* name, FILE* file_out);
+
+// Decodes every file of the archive to the directory at given path, missing
+// directories are created (file_in must be seekable)
+// Returns error code
+int extract_archive(FILE* file_in, const char* path);
+
+#endif // __INCLUDES_ARCHIVE_H__
@@ -0,0 +1,1283 @@
+/**
+ * bench.c
+ *
+ * Measures the speed of the coder and its stages over generated inputs and
+ * writes the results as JSON, so the builds can be compared
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 17:20
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bitstream.h"
+#include "tree.h"
+#include "table.h"
+#include "canonical.h"
+#include "pool.h"
+#include "histogram.h"
+#include "compression.h"
+#include "corpus.h"
+#include "cpu.h"
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+// Version of the report format
+#define BENCH_VERSION 2
+
+// Default size of each input in MiB
+#define BENCH_SIZE 16
+
+// Default number of runs of each stage (fastest run is reported)
+#define BENCH_REPEAT 3
+
+// How many bytes of the large input are generated or compared at once
+#define BENCH_CHUNK 4194304
+
+// Size of the messages coded by the buffer functions
+#define BENCH_MESSAGE_SIZE 4096
+
+// Maximum number of stages of single input
+#define MAX_STAGES 32
+
+// Smallest and largest blocks whose trees are measured on their own, block
+// size is doubled between them
+#define TREE_BLOCK_MIN 4096
+#define TREE_BLOCK_MAX 65536
+
+// Bytes of the code length header of single block at most
+#define MAX_HEADER_SIZE 256
+
+// Number of kernels which are measured with and without the extensions
+#define KERNEL_COUNT 5
+
+// Time and output of single stage
+typedef struct STAGE
+{
+	const char* name;			// name of the stage in the report
+	double seconds;				// time of the fastest run
+	uint64 output;				// bytes written by the stage (0 if none)
+} STAGE;
+
+// Kernel measured with and without the extensions of the processor
+typedef struct KERNEL
+{
+	const char* name;			// name of the kernel in the report
+	uint features;				// extensions the kernel uses (CPUFEATURE)
+	int available;				// set if the processor has the extensions
+	double scalar_seconds;		// fastest run without the extensions
+	double seconds;				// fastest run with the extensions
+} KERNEL;
+
+// Results of single input
+typedef struct RESULT
+{
+	const char* name;			// name of the input
+	uint64 size;				// size of the input in bytes
+	uint64 compressed;			// size of the archive written by encode
+	int verified;				// set if all decoders gave back the input
+	STAGE stages[MAX_STAGES];	// measured stages
+	uint stage_count;			// how many stages were measured
+	KERNEL kernels[KERNEL_COUNT];	// measured kernels
+	uint kernel_count;			// how many kernels were measured
+} RESULT;
+
+// Settings of the benchmark
+typedef struct BENCHOPTIONS
+{
+	ulong size;					// size of each input in bytes
+	uint huge;					// size of the large input in GiB (0 for none)
+	uint repeat;				// how many times each stage is run
+	uint64 seed;				// seed of the inputs
+	const char* path_out;		// where the report is written (NULL for stdout)
+	const char* corpus_dir;		// where the inputs are written instead of
+								// measuring them (NULL to measure)
+} BENCHOPTIONS;
+
+// Input of the kernels, blocks have their codes and coded streams and the
+// context decoder has its archive
+typedef struct KERNELINPUT
+{
+	uchar* input;				// characters which are coded
+	ulong size;					// how many characters there are
+	uint block_count;			// number of blocks of the input
+	CODETABLE* codes;			// canonical codes of each block
+	DECODETABLE** tables;		// decoding tables of each block
+	uchar* output;				// coded blocks, each has output_capacity bytes
+	ulong output_capacity;		// room for single coded block
+	ulong* output_sizes;		// bytes of each coded block
+	uchar* scratch;				// output_capacity bytes where the encoder
+								// writes every block
+	uchar** streams;			// interleaved streams of the blocks (each has
+								// stream_capacity bytes)
+	ulong stream_capacity;		// room for single interleaved stream
+	ulong* stream_sizes;		// bytes of each interleaved stream
+	uchar* decoded;				// room for the decoded input
+	FILE* context;				// archive of the context blocks
+} KERNELINPUT;
+
+// Blocks of the input and their codes, shared by the stages
+typedef struct BLOCKS
+{
+	uint count;					// number of blocks
+	ulong block_size;			// characters in each block (last may be less)
+	FREQTABLE* freq_tables;		// frequencies of each block
+	CODETABLE* codes;			// canonical codes of each block
+	uchar* output;				// coded blocks, each has output_capacity bytes
+	ulong output_capacity;		// room for single coded block
+	ulong* output_sizes;		// bytes of each coded block
+	uchar* decoded;				// decoded input
+} BLOCKS;
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Reads the command line
+int read_bench_options(int argc, char** argv, BENCHOPTIONS* options);
+
+// Returns the time in seconds from some fixed moment
+double bench_clock(void);
+
+// Adds measured stage to the results
+void add_stage(RESULT* result, const char* name, double seconds, uint64 output);
+
+// Measures the stages of the block coder over the input in memory
+int bench_stages(uchar* input, ulong size, uint repeat, RESULT* result);
+
+// Builds and releases the tree of every small block, so the cost of single
+// tree is measured where it is not hidden by coding the characters
+int bench_trees(uchar* input, ulong size, uint repeat, RESULT* result);
+
+// Measures the interleaved decoder of the blocks coded by bench_stages
+int bench_interleaved(uchar* input, ulong size, BLOCKS* blocks, uint repeat, RESULT* result);
+
+// Measures the coder and decoder working on the files
+int bench_files(uchar* input, ulong size, uint repeat, RESULT* result,
+	const char* encode_name, int (*encoder)(FILE*, FILE*, CODINGOPTIONS*),
+	const char* decode_name, int (*decoder)(FILE*, FILE*, CODINGOPTIONS*));
+
+// Encodes the stream of order-1 context blocks
+int encode_context_stream(FILE* file_in, FILE* file_out, CODINGOPTIONS* options);
+
+// Encodes the stream of transformed blocks
+int encode_transform_stream(FILE* file_in, FILE* file_out, CODINGOPTIONS* options);
+
+// Encodes the stream of blocks with checksums
+int encode_checksum_stream(FILE* file_in, FILE* file_out, CODINGOPTIONS* options);
+
+// Encodes the stream of blocks with pipelined reading and writing
+int encode_pipeline_stream(FILE* file_in, FILE* file_out, CODINGOPTIONS* options);
+
+// Decodes the stream of blocks with pipelined reading and writing
+int decode_pipeline_stream(FILE* file_in, FILE* file_out, CODINGOPTIONS* options);
+
+// Measures the buffer functions coding the input as separate messages
+int bench_buffers(uchar* input, ulong size, uint repeat, RESULT* result);
+
+// Measures every kernel without the extensions it uses and with them
+int bench_kernels(uchar* input, ulong size, uint repeat, RESULT* result);
+
+// Prepares the codes, coded blocks and archive of the kernels
+int prepare_kernels(KERNELINPUT* kernels);
+
+// Encodes the input to the temporary archive with given options
+FILE* encode_archive(uchar* input, ulong size, CODINGOPTIONS* options);
+
+// Releases the codes, coded blocks and archive of the kernels
+void release_kernels(KERNELINPUT* kernels);
+
+// Counts the characters of small messages, so adding the lanes to the table
+// takes much of the time
+int run_histogram_merge(KERNELINPUT* kernels);
+
+// Encodes every block with its codes over the same output
+int run_encode_chars(KERNELINPUT* kernels);
+
+// Decodes every coded block with its decoding table
+int run_decode_chars(KERNELINPUT* kernels);
+
+// Decodes the interleaved streams of every block
+int run_decode_interleaved(KERNELINPUT* kernels);
+
+// Decodes the archive of the context blocks without writing it
+int run_decode_context(KERNELINPUT* kernels);
+
+// Measures the stream coder over the input which does not fit to the memory
+int bench_huge(BENCHOPTIONS* options, RESULT* result);
+
+// Writes the inputs to the files of the directory
+int write_corpus(BENCHOPTIONS* options);
+
+// Writes the results as JSON
+void print_results(FILE* file_out, BENCHOPTIONS* options, RESULT* results, uint count);
+
+// Releases the buffers of the blocks
+void release_blocks(BLOCKS* blocks);
+
+// Main entry point of the benchmark
+int main(int argc, char** argv)
+{
+	BENCHOPTIONS options;
+	RESULT results[CORPUS_KINDS + 1];
+	CORPUS* corpus;
+	FILE* file_out = stdout;
+	uchar* input;
+	uint count = 0;
+	uint kind;
+	int result = SUCCESS;
+
+	if (read_bench_options(argc, argv, &options) == FAILURE) {
+		fprintf(stderr, "Usage: bench [-s MiB] [-g GiB] [-r repeat] [-S seed] [-o report.json] [-w corpus_dir]\n");
+		return FAILURE;
+	}
+	if (options.corpus_dir != NULL) {
+		return write_corpus(&options);
+	}
+
+	corpus = (CORPUS*)malloc(sizeof(CORPUS));
+	input = (uchar*)malloc(options.size);
+	if ((corpus == NULL) || (input == NULL)) {
+		perror("Could not allocate memory for the input (out of memory)");
+		free(corpus);
+		free(input);
+		return FAILURE;
+	}
+
+	// Every input is measured stage by stage and then as a whole
+	for (kind = 0; (kind < CORPUS_KINDS) && (result == SUCCESS); kind++) {
+		RESULT* current = &results[count++];
+		memset(current, 0, sizeof(RESULT));
+		current->name = corpus_name(kind);
+		current->size = options.size;
+		current->verified = 1;
+		fprintf(stderr, "%s\n", current->name);
+
+		init_corpus(corpus, kind, options.seed);
+		fill_corpus(corpus, input, options.size);
+		if ((bench_stages(input, options.size, options.repeat, current) == FAILURE) ||
+			(bench_trees(input, options.size, options.repeat, current) == FAILURE) ||
+			(bench_files(input, options.size, options.repeat, current, "encode", encode, "decode", decode) == FAILURE) ||
+			(bench_files(input, options.size, options.repeat, current, "encode_stream", encode_stream, "decode_stream", decode_stream) == FAILURE) ||
+			(bench_files(input, options.size, options.repeat, current, "encode_context", encode_context_stream, "decode_context", decode_stream) == FAILURE) ||
+			(bench_files(input, options.size, options.repeat, current, "encode_transform", encode_transform_stream, "decode_transform", decode_stream) == FAILURE) ||
+			(bench_files(input, options.size, options.repeat, current, "encode_checksum", encode_checksum_stream, "decode_checksum", decode_stream) == FAILURE) ||
+			(bench_files(input, options.size, options.repeat, current, "encode_pipeline", encode_pipeline_stream, "decode_pipeline", decode_pipeline_stream) == FAILURE) ||
+			(bench_buffers(input, options.size, options.repeat, current) == FAILURE) ||
+			(bench_kernels(input, options.size, options.repeat, current) == FAILURE)) {
+			result = FAILURE;
+		}
+	}
+	free(input);
+	free(corpus);
+
+	// Large input is coded only as the stream
+	if ((result == SUCCESS) && (options.huge > 0)) {
+		fprintf(stderr, "huge\n");
+		if (bench_huge(&options, &results[count++]) == FAILURE) {
+			result = FAILURE;
+		}
+	}
+	if (result == FAILURE) {
+		return FAILURE;
+	}
+
+	if (options.path_out != NULL) {
+		file_out = fopen(options.path_out, "w");
+		if (file_out == NULL) {
+			perror("Could not open the file");
+			return FAILURE;
+		}
+	}
+	print_results(file_out, &options, results, count);
+	if ((file_out != stdout) && (fclose(file_out) == EOF)) {
+		perror("Error occured when writing the file");
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+/**
+ * Private methods of the library
+ */
+
+// Options are given as separate arguments with their values
+int read_bench_options(int argc, char** argv, BENCHOPTIONS* options)
+{
+	int i;
+
+	options->size = (ulong)BENCH_SIZE << 20;
+	options->huge = 0;
+	options->repeat = BENCH_REPEAT;
+	options->seed = CORPUS_SEED;
+	options->path_out = NULL;
+	options->corpus_dir = NULL;
+
+	for (i = 1; i < argc; i++) {
+		if (i + 1 >= argc) {
+			return FAILURE;
+		}
+		if (strcmp(argv[i], "-s") == 0) {
+			options->size = (ulong)atoi(argv[++i]) << 20;
+		} else if (strcmp(argv[i], "-g") == 0) {
+			options->huge = (uint)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-r") == 0) {
+			options->repeat = (uint)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-S") == 0) {
+			options->seed = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "-o") == 0) {
+			options->path_out = argv[++i];
+		} else if (strcmp(argv[i], "-w") == 0) {
+			options->corpus_dir = argv[++i];
+		} else {
+			return FAILURE;
+		}
+	}
+	return ((options->size == 0) || (options->repeat == 0)) ? FAILURE : SUCCESS;
+}
+
+// Monotonic clock is not affected by the changes of the system time
+double bench_clock(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Stages are reported in the order they are added
+void add_stage(RESULT* result, const char* name, double seconds, uint64 output)
+{
+	STAGE* stage;
+
+	if (result->stage_count == MAX_STAGES) {
+		return;
+	}
+	stage = &result->stages[result->stage_count++];
+	stage->name = name;
+	stage->seconds = seconds;
+	stage->output = output;
+}
+
+// Input is split to the blocks of the stream coder and every stage runs over
+// all the blocks, so the stages are measured in the same sizes the coder
+// uses them
+int bench_stages(uchar* input, ulong size, uint repeat, RESULT* result)
+{
+	BLOCKS blocks;
+	TREE tree;
+	CODETABLE tree_codes;
+	uchar header[MAX_HEADER_SIZE];
+	double best[6] = { 0, 0, 0, 0, 0, 0 };
+	uint64 header_size = 0;
+	uint64 payload_size = 0;
+	uint r;
+	uint b;
+	uint s;
+
+	memset(&blocks, 0, sizeof(BLOCKS));
+	blocks.block_size = STREAM_BLOCK_SIZE;
+	blocks.count = (uint)((size + blocks.block_size - 1) / blocks.block_size);
+	blocks.output_capacity = blocks.block_size * MAX_CANONICAL_LENGTH / UCHAR_WIDTH + 1;
+	blocks.freq_tables = (FREQTABLE*)malloc(blocks.count * sizeof(FREQTABLE));
+	blocks.codes = (CODETABLE*)malloc(blocks.count * sizeof(CODETABLE));
+	blocks.output = (uchar*)malloc(blocks.count * blocks.output_capacity);
+	blocks.output_sizes = (ulong*)malloc(blocks.count * sizeof(ulong));
+	blocks.decoded = (uchar*)malloc(size);
+	if ((blocks.freq_tables == NULL) || (blocks.codes == NULL) || (blocks.output == NULL) ||
+		(blocks.output_sizes == NULL) || (blocks.decoded == NULL)) {
+		perror("Could not allocate memory for the blocks (out of memory)");
+		release_blocks(&blocks);
+		return FAILURE;
+	}
+
+	for (r = 0; r < repeat; r++) {
+		double times[6];
+		double start = bench_clock();
+
+		// Counting the characters
+		for (b = 0; b < blocks.count; b++) {
+			ulong offset = b * blocks.block_size;
+			ulong count = (size - offset < blocks.block_size) ? size - offset : blocks.block_size;
+			histogram_block(input + offset, count, blocks.freq_tables[b]);
+		}
+		times[0] = bench_clock();
+
+		// Codes from the tree (legacy and -l 0 blocks)
+		for (b = 0; b < blocks.count; b++) {
+			init_freq_tree(&tree, blocks.freq_tables[b]);
+			build_code_table(&tree, &tree_codes);
+		}
+		times[1] = bench_clock();
+
+		// Length-limited canonical codes (default blocks)
+		for (b = 0; b < blocks.count; b++) {
+			if ((limit_code_lengths(blocks.freq_tables[b], DEFAULT_CANONICAL_LENGTH, &blocks.codes[b]) == FAILURE) ||
+				(build_canonical_codes(&blocks.codes[b]) == FAILURE)) {
+				release_blocks(&blocks);
+				return FAILURE;
+			}
+		}
+		times[2] = bench_clock();
+
+		// Writing the code lengths
+		header_size = 0;
+		for (b = 0; b < blocks.count; b++) {
+			BITSTREAM* bs = bs_create_memory(header, MAX_HEADER_SIZE, WRITE);
+			if ((bs == NULL) || (put_code_lengths(bs, &blocks.codes[b]) == FAILURE) || (bs_destroy(bs) == FAILURE)) {
+				release_blocks(&blocks);
+				return FAILURE;
+			}
+			header_size += (code_lengths_bits(&blocks.codes[b]) + UCHAR_WIDTH - 1) / UCHAR_WIDTH;
+		}
+		times[3] = bench_clock();
+
+		// Coding the characters
+		payload_size = 0;
+		for (b = 0; b < blocks.count; b++) {
+			ulong offset = b * blocks.block_size;
+			ulong count = (size - offset < blocks.block_size) ? size - offset : blocks.block_size;
+			BITSTREAM* bs = bs_create_memory(blocks.output + b * blocks.output_capacity, blocks.output_capacity, WRITE);
+			if ((bs == NULL) || (encode_chars(bs, &blocks.codes[b], input + offset, count) == FAILURE) || (bs_destroy(bs) == FAILURE)) {
+				release_blocks(&blocks);
+				return FAILURE;
+			}
+			blocks.output_sizes[b] = 0;
+			if (!blocks.codes[b].uniform) {
+				uint64 bits = 0;
+				uint c;
+				for (c = 0; c < MAX_CHAR; c++) {
+					bits += blocks.freq_tables[b][c] * blocks.codes[b].length[c];
+				}
+				blocks.output_sizes[b] = (ulong)((bits + UCHAR_WIDTH - 1) / UCHAR_WIDTH);
+			}
+			payload_size += blocks.output_sizes[b];
+		}
+		times[4] = bench_clock();
+
+		// Decoding the characters (building the decoding table included)
+		for (b = 0; b < blocks.count; b++) {
+			ulong offset = b * blocks.block_size;
+			ulong count = (size - offset < blocks.block_size) ? size - offset : blocks.block_size;
+			DECODETABLE* table = build_decode_table(&blocks.codes[b]);
+			BITSTREAM* bs = bs_create_memory(blocks.output + b * blocks.output_capacity, blocks.output_sizes[b], READ);
+			int failed = (table == NULL) || (bs == NULL) || (decode_chars(bs, table, blocks.decoded + offset, count) == FAILURE);
+			if (table != NULL) {
+				release_decode_table(table);
+			}
+			if (bs != NULL) {
+				bs_destroy(bs);
+			}
+			if (failed) {
+				release_blocks(&blocks);
+				return FAILURE;
+			}
+		}
+		times[5] = bench_clock();
+
+		// Keep the fastest run of each stage
+		for (s = 0; s < 6; s++) {
+			double seconds = times[s] - ((s > 0) ? times[s - 1] : start);
+			if ((r == 0) || (seconds < best[s])) {
+				best[s] = seconds;
+			}
+		}
+	}
+	if (memcmp(input, blocks.decoded, size) != 0) {
+		result->verified = 0;
+	}
+
+	add_stage(result, "freq_table", best[0], 0);
+	add_stage(result, "build_tree", best[1], 0);
+	add_stage(result, "code_lengths", best[2], 0);
+	add_stage(result, "header", best[3], header_size);
+	add_stage(result, "encode_chars", best[4], payload_size);
+	add_stage(result, "decode_chars", best[5], 0);
+	r = bench_interleaved(input, size, &blocks, repeat, result);
+	release_blocks(&blocks);
+	return r;
+}
+
+// Histograms are counted before the clock starts, every stage is the time of
+// all trees of the input (time of single tree is ns_per_byte times the block
+// size)
+int bench_trees(uchar* input, ulong size, uint repeat, RESULT* result)
+{
+	static const char* names[] = { "tree_4k", "tree_8k", "tree_16k", "tree_32k", "tree_64k" };
+	FREQTABLE* freq_tables;
+	ulong block_size;
+	uint n = 0;
+	uint r;
+	ulong b;
+
+	freq_tables = (FREQTABLE*)malloc(((size + TREE_BLOCK_MIN - 1) / TREE_BLOCK_MIN) * sizeof(FREQTABLE));
+	if (freq_tables == NULL) {
+		perror("Could not allocate memory for the blocks (out of memory)");
+		return FAILURE;
+	}
+	for (block_size = TREE_BLOCK_MIN; block_size <= TREE_BLOCK_MAX; block_size *= 2) {
+		ulong count = (size + block_size - 1) / block_size;
+		double best = 0;
+
+		for (b = 0; b < count; b++) {
+			ulong offset = b * block_size;
+			histogram_block(input + offset, (size - offset < block_size) ? size - offset : block_size, freq_tables[b]);
+		}
+		for (r = 0; r < repeat; r++) {
+			double start = bench_clock();
+			double seconds;
+			for (b = 0; b < count; b++) {
+				TREE* tree = build_freq_tree(freq_tables[b]);
+				if (tree == NULL) {
+					free(freq_tables);
+					return FAILURE;
+				}
+				release_tree(tree);
+			}
+			seconds = bench_clock() - start;
+			if ((r == 0) || (seconds < best)) {
+				best = seconds;
+			}
+		}
+		add_stage(result, names[n++], best, 0);
+	}
+	free(freq_tables);
+	return SUCCESS;
+}
+
+// Blocks are coded again to four streams each (not measured), only the
+// decoding is measured
+int bench_interleaved(uchar* input, ulong size, BLOCKS* blocks, uint repeat, RESULT* result)
+{
+	ulong stream_capacity = blocks->output_capacity / INTERLEAVE_STREAMS + 1;
+	uchar** streams;
+	ulong* sizes;
+	double best = 0;
+	uint r;
+	uint b;
+	uint s;
+
+	streams = (uchar**)malloc(blocks->count * INTERLEAVE_STREAMS * sizeof(uchar*));
+	sizes = (ulong*)malloc(blocks->count * INTERLEAVE_STREAMS * sizeof(ulong));
+	if ((streams == NULL) || (sizes == NULL)) {
+		perror("Could not allocate memory for the streams (out of memory)");
+		free(streams);
+		free(sizes);
+		return FAILURE;
+	}
+
+	// Streams of each block share the output of the block
+	for (b = 0; b < blocks->count; b++) {
+		ulong offset = b * blocks->block_size;
+		ulong count = (size - offset < blocks->block_size) ? size - offset : blocks->block_size;
+		for (s = 0; s < INTERLEAVE_STREAMS; s++) {
+			uint i = b * INTERLEAVE_STREAMS + s;
+			ulong stream_count = (count > s) ? (count - s + INTERLEAVE_STREAMS - 1) / INTERLEAVE_STREAMS : 0;
+			uint64 bits = 0;
+			ulong j;
+			BITSTREAM* bs;
+			streams[i] = blocks->output + b * blocks->output_capacity + s * stream_capacity;
+			bs = bs_create_memory(streams[i], stream_capacity, WRITE);
+			if ((bs == NULL) || (encode_strided(bs, &blocks->codes[b], input + offset + s, stream_count, INTERLEAVE_STREAMS) == FAILURE) ||
+				(bs_destroy(bs) == FAILURE)) {
+				free(streams);
+				free(sizes);
+				return FAILURE;
+			}
+			for (j = 0; (j < stream_count) && !blocks->codes[b].uniform; j++) {
+				bits += blocks->codes[b].length[input[offset + s + j * INTERLEAVE_STREAMS]];
+			}
+			sizes[i] = (ulong)((bits + UCHAR_WIDTH - 1) / UCHAR_WIDTH);
+		}
+	}
+
+	memset(blocks->decoded, 0, size);
+	for (r = 0; r < repeat; r++) {
+		double start = bench_clock();
+		double seconds;
+		for (b = 0; b < blocks->count; b++) {
+			ulong offset = b * blocks->block_size;
+			ulong count = (size - offset < blocks->block_size) ? size - offset : blocks->block_size;
+			DECODETABLE* table = build_decode_table(&blocks->codes[b]);
+			if ((table == NULL) || (decode_interleaved(&streams[b * INTERLEAVE_STREAMS], &sizes[b * INTERLEAVE_STREAMS],
+				table, blocks->decoded + offset, count) == FAILURE)) {
+				if (table != NULL) {
+					release_decode_table(table);
+				}
+				free(streams);
+				free(sizes);
+				return FAILURE;
+			}
+			release_decode_table(table);
+		}
+		seconds = bench_clock() - start;
+		if ((r == 0) || (seconds < best)) {
+			best = seconds;
+		}
+	}
+	if (memcmp(input, blocks->decoded, size) != 0) {
+		result->verified = 0;
+	}
+	add_stage(result, "decode_interleaved", best, 0);
+	free(streams);
+	free(sizes);
+	return SUCCESS;
+}
+
+// Files are temporary files, so the times include writing and reading them
+// through the file cache (input file is written before the measurement)
+int bench_files(uchar* input, ulong size, uint repeat, RESULT* result,
+	const char* encode_name, int (*encoder)(FILE*, FILE*, CODINGOPTIONS*),
+	const char* decode_name, int (*decoder)(FILE*, FILE*, CODINGOPTIONS*))
+{
+	CODINGOPTIONS options;
+	FILE* file_in = NULL;
+	FILE* archive = NULL;
+	FILE* file_out = NULL;
+	double best[2] = { 0, 0 };
+	uint64 archive_size = 0;
+	uchar* decoded;
+	uint r;
+	int failed = 0;
+
+	init_coding_options(&options);
+	decoded = (uchar*)malloc(size);
+	file_in = tmpfile();
+	if ((decoded == NULL) || (file_in == NULL) || (fwrite(input, 1, size, file_in) != size) || fflush(file_in)) {
+		perror("Could not prepare the input file");
+		free(decoded);
+		if (file_in != NULL) {
+			fclose(file_in);
+		}
+		return FAILURE;
+	}
+
+	for (r = 0; (r < repeat) && !failed; r++) {
+		double start;
+		double middle;
+		double end;
+
+		archive = tmpfile();
+		file_out = tmpfile();
+		if ((archive == NULL) || (file_out == NULL)) {
+			perror("Could not create temporary file");
+			failed = 1;
+			break;
+		}
+		rewind(file_in);
+		start = bench_clock();
+		failed = (encoder(file_in, archive, &options) == FAILURE) || fflush(archive);
+		middle = bench_clock();
+		archive_size = (uint64)ftell(archive);
+		rewind(archive);
+		failed = failed || (decoder(archive, file_out, &options) == FAILURE) || fflush(file_out);
+		end = bench_clock();
+
+		// Check the output outside of the measurement
+		rewind(file_out);
+		if (failed || (fread(decoded, 1, size, file_out) != size) || (fgetc(file_out) != EOF) || (memcmp(input, decoded, size) != 0)) {
+			result->verified = 0;
+		}
+		if ((r == 0) || (middle - start < best[0])) {
+			best[0] = middle - start;
+		}
+		if ((r == 0) || (end - middle < best[1])) {
+			best[1] = end - middle;
+		}
+		fclose(archive);
+		fclose(file_out);
+		archive = NULL;
+		file_out = NULL;
+	}
+	if (archive != NULL) {
+		fclose(archive);
+	}
+	if (file_out != NULL) {
+		fclose(file_out);
+	}
+	fclose(file_in);
+	free(decoded);
+	if (failed) {
+		return FAILURE;
+	}
+
+	// Size of the default archive is the compressed size of the input
+	if (strcmp(encode_name, "encode") == 0) {
+		result->compressed = archive_size;
+	}
+	add_stage(result, encode_name, best[0], archive_size);
+	add_stage(result, decode_name, best[1], 0);
+	return SUCCESS;
+}
+
+// Default options are changed only by the order of the model
+int encode_context_stream(FILE* file_in, FILE* file_out, CODINGOPTIONS* options)
+{
+	CODINGOPTIONS context_options = *options;
+	context_options.order = 1;
+	return encode_stream(file_in, file_out, &context_options);
+}
+
+// Default options are changed only by the transforms of the blocks
+int encode_transform_stream(FILE* file_in, FILE* file_out, CODINGOPTIONS* options)
+{
+	CODINGOPTIONS transform_options = *options;
+	transform_options.transform = 1;
+	return encode_stream(file_in, file_out, &transform_options);
+}
+
+// Default options are changed only by the checksums
+int encode_checksum_stream(FILE* file_in, FILE* file_out, CODINGOPTIONS* options)
+{
+	CODINGOPTIONS checksum_options = *options;
+	checksum_options.checksum = 1;
+	return encode_stream(file_in, file_out, &checksum_options);
+}
+
+// Default options are changed only by the pipelined reading and writing
+int encode_pipeline_stream(FILE* file_in, FILE* file_out, CODINGOPTIONS* options)
+{
+	CODINGOPTIONS pipeline_options = *options;
+	pipeline_options.pipeline = 1;
+	return encode_stream(file_in, file_out, &pipeline_options);
+}
+
+// Decoding is pipelined the same way
+int decode_pipeline_stream(FILE* file_in, FILE* file_out, CODINGOPTIONS* options)
+{
+	CODINGOPTIONS pipeline_options = *options;
+	pipeline_options.pipeline = 1;
+	return decode_stream(file_in, file_out, &pipeline_options);
+}
+
+// Every run of the kernel is measured first without its extensions and
+// then with them, fastest runs are reported
+int bench_kernels(uchar* input, ulong size, uint repeat, RESULT* result)
+{
+	static const char* names[KERNEL_COUNT] = { "histogram_merge", "encode_chars", "decode_chars", "decode_interleaved", "decode_context" };
+	static const uint features[KERNEL_COUNT] = { CPU_AVX2, CPU_BMI2, CPU_BMI2, CPU_BMI2, CPU_AVX2 };
+	static int (*const runs[KERNEL_COUNT])(KERNELINPUT*) = { run_histogram_merge, run_encode_chars, run_decode_chars,
+		run_decode_interleaved, run_decode_context };
+	KERNELINPUT kernels;
+	uint available = cpu_features();
+	uint r;
+	uint k;
+	int failed = 0;
+
+	memset(&kernels, 0, sizeof(KERNELINPUT));
+	kernels.input = input;
+	kernels.size = size;
+	if (prepare_kernels(&kernels) == FAILURE) {
+		release_kernels(&kernels);
+		return FAILURE;
+	}
+
+	for (k = 0; (k < KERNEL_COUNT) && !failed; k++) {
+		KERNEL* kernel = &result->kernels[result->kernel_count++];
+		kernel->name = names[k];
+		kernel->features = features[k];
+		kernel->available = ((available & features[k]) == features[k]);
+		for (r = 0; (r < repeat) && !failed; r++) {
+			double start;
+			double middle;
+			double end;
+
+			cpu_allow(CPU_ALL & ~features[k]);
+			start = bench_clock();
+			failed = (runs[k](&kernels) == FAILURE);
+			middle = bench_clock();
+			cpu_allow(CPU_ALL);
+			failed = failed || (runs[k](&kernels) == FAILURE);
+			end = bench_clock();
+			if ((r == 0) || (middle - start < kernel->scalar_seconds)) {
+				kernel->scalar_seconds = middle - start;
+			}
+			if ((r == 0) || (end - middle < kernel->seconds)) {
+				kernel->seconds = end - middle;
+			}
+		}
+	}
+	cpu_allow(CPU_ALL);
+	release_kernels(&kernels);
+	return failed ? FAILURE : SUCCESS;
+}
+
+// Blocks have the default canonical codes, they are coded once with the
+// plain kernels so the decoders have their input, the archive is written
+// once and only its decoding is measured
+int prepare_kernels(KERNELINPUT* kernels)
+{
+	CODINGOPTIONS options;
+	FREQTABLE freq_table;
+	BITSTREAM bs;
+	uint b;
+	uint s;
+
+	kernels->block_count = (uint)((kernels->size + STREAM_BLOCK_SIZE - 1) / STREAM_BLOCK_SIZE);
+	kernels->output_capacity = (ulong)STREAM_BLOCK_SIZE * MAX_CANONICAL_LENGTH / UCHAR_WIDTH + 1;
+	kernels->stream_capacity = kernels->output_capacity / INTERLEAVE_STREAMS + 1;
+	kernels->codes = (CODETABLE*)malloc(kernels->block_count * sizeof(CODETABLE));
+	kernels->tables = (DECODETABLE**)calloc(kernels->block_count, sizeof(DECODETABLE*));
+	kernels->output = (uchar*)malloc(kernels->block_count * kernels->output_capacity);
+	kernels->output_sizes = (ulong*)malloc(kernels->block_count * sizeof(ulong));
+	kernels->streams = (uchar**)calloc(kernels->block_count * INTERLEAVE_STREAMS, sizeof(uchar*));
+	kernels->stream_sizes = (ulong*)malloc(kernels->block_count * INTERLEAVE_STREAMS * sizeof(ulong));
+	kernels->scratch = (uchar*)malloc(kernels->output_capacity);
+	kernels->decoded = (uchar*)malloc(kernels->size);
+	if ((kernels->codes == NULL) || (kernels->tables == NULL) || (kernels->output == NULL) || (kernels->output_sizes == NULL) ||
+		(kernels->scratch == NULL) || (kernels->streams == NULL) || (kernels->stream_sizes == NULL) || (kernels->decoded == NULL)) {
+		perror("Could not allocate memory for the kernels (out of memory)");
+		return FAILURE;
+	}
+	cpu_allow(CPU_ALL & ~CPU_BMI2);
+	for (b = 0; b < kernels->block_count; b++) {
+		ulong offset = (ulong)b * STREAM_BLOCK_SIZE;
+		ulong count = (kernels->size - offset < STREAM_BLOCK_SIZE) ? kernels->size - offset : STREAM_BLOCK_SIZE;
+		histogram_block(kernels->input + offset, count, freq_table);
+		if ((limit_code_lengths(freq_table, DEFAULT_CANONICAL_LENGTH, &kernels->codes[b]) == FAILURE) ||
+			(build_canonical_codes(&kernels->codes[b]) == FAILURE)) {
+			cpu_allow(CPU_ALL);
+			return FAILURE;
+		}
+		kernels->tables[b] = build_decode_table(&kernels->codes[b]);
+		bs_init_memory(&bs, kernels->output + b * kernels->output_capacity, kernels->output_capacity, WRITE);
+		if ((kernels->tables[b] == NULL) || (encode_chars(&bs, &kernels->codes[b], kernels->input + offset, count) == FAILURE) ||
+			(bs_close(&bs) == FAILURE)) {
+			cpu_allow(CPU_ALL);
+			return FAILURE;
+		}
+		kernels->output_sizes[b] = (ulong)((bs_tell(&bs) + UCHAR_WIDTH - 1) / UCHAR_WIDTH);
+		for (s = 0; s < INTERLEAVE_STREAMS; s++) {
+			uint i = b * INTERLEAVE_STREAMS + s;
+			ulong stream_count = (count > s) ? (count - s + INTERLEAVE_STREAMS - 1) / INTERLEAVE_STREAMS : 0;
+			kernels->streams[i] = (uchar*)malloc(kernels->stream_capacity);
+			if (kernels->streams[i] == NULL) {
+				perror("Could not allocate memory for the kernels (out of memory)");
+				cpu_allow(CPU_ALL);
+				return FAILURE;
+			}
+			bs_init_memory(&bs, kernels->streams[i], kernels->stream_capacity, WRITE);
+			if ((encode_strided(&bs, &kernels->codes[b], kernels->input + offset + s, stream_count, INTERLEAVE_STREAMS) == FAILURE) ||
+				(bs_close(&bs) == FAILURE)) {
+				cpu_allow(CPU_ALL);
+				return FAILURE;
+			}
+			kernels->stream_sizes[i] = (ulong)((bs_tell(&bs) + UCHAR_WIDTH - 1) / UCHAR_WIDTH);
+		}
+	}
+	cpu_allow(CPU_ALL);
+
+	init_coding_options(&options);
+	options.order = 1;
+	kernels->context = encode_archive(kernels->input, kernels->size, &options);
+	return (kernels->context == NULL) ? FAILURE : SUCCESS;
+}
+
+// Input goes through the temporary file, because the stream coder reads a
+// file
+FILE* encode_archive(uchar* input, ulong size, CODINGOPTIONS* options)
+{
+	FILE* file_in = tmpfile();
+	FILE* archive = tmpfile();
+
+	if ((file_in == NULL) || (archive == NULL) || (fwrite(input, 1, size, file_in) != size) || fflush(file_in)) {
+		perror("Could not prepare the input file");
+		if (file_in != NULL) {
+			fclose(file_in);
+		}
+		if (archive != NULL) {
+			fclose(archive);
+		}
+		return NULL;
+	}
+	rewind(file_in);
+	if ((encode_stream(file_in, archive, options) == FAILURE) || fflush(archive)) {
+		fclose(file_in);
+		fclose(archive);
+		return NULL;
+	}
+	fclose(file_in);
+	return archive;
+}
+
+// Missing codes, blocks and archive are skipped
+void release_kernels(KERNELINPUT* kernels)
+{
+	uint b;
+
+	for (b = 0; (kernels->tables != NULL) && (b < kernels->block_count); b++) {
+		if (kernels->tables[b] != NULL) {
+			release_decode_table(kernels->tables[b]);
+		}
+	}
+	for (b = 0; (kernels->streams != NULL) && (b < kernels->block_count * INTERLEAVE_STREAMS); b++) {
+		free(kernels->streams[b]);
+	}
+	free(kernels->codes);
+	free(kernels->tables);
+	free(kernels->output);
+	free(kernels->output_sizes);
+	free(kernels->scratch);
+	free(kernels->streams);
+	free(kernels->stream_sizes);
+	free(kernels->decoded);
+	if (kernels->context != NULL) {
+		fclose(kernels->context);
+	}
+}
+
+// Messages are as large as the messages of the buffer coder
+int run_histogram_merge(KERNELINPUT* kernels)
+{
+	FREQTABLE freq_table;
+	ulong offset;
+
+	for (offset = 0; offset < kernels->size; offset += BENCH_MESSAGE_SIZE) {
+		ulong count = (kernels->size - offset < BENCH_MESSAGE_SIZE) ? kernels->size - offset : BENCH_MESSAGE_SIZE;
+		histogram_block(kernels->input + offset, count, freq_table);
+	}
+	return SUCCESS;
+}
+
+// Every block is written over the same scratch output, so the coded blocks
+// of the decoders stay
+int run_encode_chars(KERNELINPUT* kernels)
+{
+	BITSTREAM bs;
+	uint b;
+
+	for (b = 0; b < kernels->block_count; b++) {
+		ulong offset = (ulong)b * STREAM_BLOCK_SIZE;
+		ulong count = (kernels->size - offset < STREAM_BLOCK_SIZE) ? kernels->size - offset : STREAM_BLOCK_SIZE;
+		bs_init_memory(&bs, kernels->scratch, kernels->output_capacity, WRITE);
+		if ((encode_chars(&bs, &kernels->codes[b], kernels->input + offset, count) == FAILURE) || (bs_close(&bs) == FAILURE)) {
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+// Decoding tables are built once, only the characters are decoded
+int run_decode_chars(KERNELINPUT* kernels)
+{
+	BITSTREAM bs;
+	uint b;
+
+	for (b = 0; b < kernels->block_count; b++) {
+		ulong offset = (ulong)b * STREAM_BLOCK_SIZE;
+		ulong count = (kernels->size - offset < STREAM_BLOCK_SIZE) ? kernels->size - offset : STREAM_BLOCK_SIZE;
+		bs_init_memory(&bs, kernels->output + b * kernels->output_capacity, kernels->output_sizes[b], READ);
+		if (decode_chars(&bs, kernels->tables[b], kernels->decoded + offset, count) == FAILURE) {
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+// Streams of each block are decoded together
+int run_decode_interleaved(KERNELINPUT* kernels)
+{
+	uint b;
+
+	for (b = 0; b < kernels->block_count; b++) {
+		ulong offset = (ulong)b * STREAM_BLOCK_SIZE;
+		ulong count = (kernels->size - offset < STREAM_BLOCK_SIZE) ? kernels->size - offset : STREAM_BLOCK_SIZE;
+		if (decode_interleaved(&kernels->streams[b * INTERLEAVE_STREAMS], &kernels->stream_sizes[b * INTERLEAVE_STREAMS],
+			kernels->tables[b], kernels->decoded + offset, count) == FAILURE) {
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+// Archive is only tested, so writing the output is not measured
+int run_decode_context(KERNELINPUT* kernels)
+{
+	CODINGOPTIONS options;
+
+	init_coding_options(&options);
+	rewind(kernels->context);
+	return decode_stream(kernels->context, NULL, &options);
+}
+
+// Every message is encoded to its own archive with the same context, the
+// archives are kept for decoding
+int bench_buffers(uchar* input, ulong size, uint repeat, RESULT* result)
+{
+	CODINGOPTIONS options;
+	CONTEXT* context;
+	ulong count = (size + BENCH_MESSAGE_SIZE - 1) / BENCH_MESSAGE_SIZE;
+	ulong capacity = compress_bound(BENCH_MESSAGE_SIZE);
+	ulong* sizes;
+	uchar* archives;
+	uchar* decoded;
+	double best[2] = { 0, 0 };
+	uint64 archive_size = 0;
+	ulong i;
+	uint r;
+	int failed = 0;
+
+	init_coding_options(&options);
+	context = create_context(&options);
+	sizes = (ulong*)malloc(count * sizeof(ulong));
+	archives = (uchar*)malloc(count * capacity);
+	decoded = (uchar*)malloc(size);
+	if ((context == NULL) || (sizes == NULL) || (archives == NULL) || (decoded == NULL)) {
+		perror("Could not allocate memory for the messages (out of memory)");
+		failed = 1;
+	}
+
+	for (r = 0; (r < repeat) && !failed; r++) {
+		double start = bench_clock();
+		double middle;
+		archive_size = 0;
+		for (i = 0; (i < count) && !failed; i++) {
+			ulong length = (size - i * BENCH_MESSAGE_SIZE < BENCH_MESSAGE_SIZE) ? size - i * BENCH_MESSAGE_SIZE : BENCH_MESSAGE_SIZE;
+			failed = encode_buffer(context, input + i * BENCH_MESSAGE_SIZE, length, archives + i * capacity, capacity, &sizes[i]);
+			archive_size += sizes[i];
+		}
+		middle = bench_clock();
+		for (i = 0; (i < count) && !failed; i++) {
+			ulong length;
+			failed = decode_buffer(context, archives + i * capacity, sizes[i], decoded + i * BENCH_MESSAGE_SIZE, size - i * BENCH_MESSAGE_SIZE, &length);
+		}
+		if ((r == 0) || (middle - start < best[0])) {
+			best[0] = middle - start;
+		}
+		if ((r == 0) || (bench_clock() - middle < best[1])) {
+			best[1] = bench_clock() - middle;
+		}
+	}
+	if (!failed && (memcmp(input, decoded, size) != 0)) {
+		result->verified = 0;
+	}
+	if (context != NULL) {
+		release_context(context);
+	}
+	free(sizes);
+	free(archives);
+	free(decoded);
+	if (failed) {
+		return FAILURE;
+	}
+	add_stage(result, "encode_buffer", best[0], archive_size);
+	add_stage(result, "decode_buffer", best[1], 0);
+	return SUCCESS;
+}
+
+// Input is written to the temporary file piece by piece and coded once,
+// decoded output is compared with the input generated again
+int bench_huge(BENCHOPTIONS* options, RESULT* result)
+{
+	CODINGOPTIONS coding_options;
+	CORPUS* corpus;
+	uchar* buffer;
+	uchar* expected;
+	FILE* file_in;
+	FILE* archive;
+	FILE* file_out;
+	uint64 size = (uint64)options->huge << 30;
+	uint64 done;
+	double start;
+	double middle;
+	int failed;
+
+	memset(result, 0, sizeof(RESULT));
+	result->name = "huge";
+	result->size = size;
+	result->verified = 1;
+
+	corpus = (CORPUS*)malloc(sizeof(CORPUS));
+	buffer = (uchar*)malloc(BENCH_CHUNK);
+	expected = (uchar*)malloc(BENCH_CHUNK);
+	file_in = tmpfile();
+	archive = tmpfile();
+	file_out = tmpfile();
+	failed = (corpus == NULL) || (buffer == NULL) || (expected == NULL) || (file_in == NULL) || (archive == NULL) || (file_out == NULL);
+	if (failed) {
+		perror("Could not prepare the large input");
+	}
+
+	// Text-like input is the most common case
+	if (!failed) {
+		init_corpus(corpus, CORPUS_TEXT, options->seed);
+		for (done = 0; (done < size) && !failed; done += BENCH_CHUNK) {
+			fill_corpus(corpus, buffer, BENCH_CHUNK);
+			if (fwrite(buffer, 1, BENCH_CHUNK, file_in) != BENCH_CHUNK) {
+				perror("Error occured when writing the file");
+				failed = 1;
+			}
+		}
+		failed = failed || fflush(file_in);
+		rewind(file_in);
+	}
+
+	if (!failed) {
+		init_coding_options(&coding_options);
+		start = bench_clock();
+		failed = (encode_stream(file_in, archive, &coding_options) == FAILURE) || fflush(archive);
+		middle = bench_clock();
+		result->compressed = (uint64)ftello(archive);
+		rewind(archive);
+		failed = failed || (decode_stream(archive, file_out, &coding_options) == FAILURE) || fflush(file_out);
+		add_stage(result, "encode_stream", middle - start, result->compressed);
+		add_stage(result, "decode_stream", bench_clock() - middle, 0);
+	}
+
+	// Compare the output with the input
+	if (!failed) {
+		rewind(file_out);
+		init_corpus(corpus, CORPUS_TEXT, options->seed);
+		for (done = 0; done < size; done += BENCH_CHUNK) {
+			fill_corpus(corpus, expected, BENCH_CHUNK);
+			if ((fread(buffer, 1, BENCH_CHUNK, file_out) != BENCH_CHUNK) || (memcmp(buffer, expected, BENCH_CHUNK) != 0)) {
+				result->verified = 0;
+				break;
+			}
+		}
+		if (fgetc(file_out) != EOF) {
+			result->verified = 0;
+		}
+	}
+
+	if (file_in != NULL) {
+		fclose(file_in);
+	}
+	if (archive != NULL) {
+		fclose(archive);
+	}
+	if (file_out != NULL) {
+		fclose(file_out);
+	}
+	free(expected);
+	free(buffer);
+	free(corpus);
+	return failed ? FAILURE : SUCCESS;
+}
+
+// Files are named by the kind of the input
+int write_corpus(BENCHOPTIONS* options)
+{
+	CORPUS* corpus;
+	uchar* buffer;
+	char path[4096];
+	uint kind;
+	int result = SUCCESS;
+
+	corpus = (CORPUS*)malloc(sizeof(CORPUS));
+	buffer = (uchar*)malloc(BENCH_CHUNK);
+	if ((corpus == NULL) || (buffer == NULL)) {
+		perror("Could not allocate memory for the input (out of memory)");
+		free(corpus);
+		free(buffer);
+		return FAILURE;
+	}
+
+	for (kind = 0; (kind <= CORPUS_KINDS) && (result == SUCCESS); kind++) {
+		// Last file is the large text-like input
+		uint64 size = (kind < CORPUS_KINDS) ? options->size : (uint64)options->huge << 30;
+		uint64 done;
+		FILE* file;
+		if (size == 0) {
+			continue;
+		}
+		snprintf(path, sizeof(path), "%s/%s.bin", options->corpus_dir, (kind < CORPUS_KINDS) ? corpus_name(kind) : "huge");
+		file = fopen(path, "wb");
+		if (file == NULL) {
+			perror("Could not open the file");
+			result = FAILURE;
+			break;
+		}
+		init_corpus(corpus, (kind < CORPUS_KINDS) ? kind : CORPUS_TEXT, options->seed);
+		for (done = 0; done < size; done += BENCH_CHUNK) {
+			ulong count = (size - done < BENCH_CHUNK) ? (ulong)(size - done) : BENCH_CHUNK;
+			fill_corpus(corpus, buffer, count);
+			if (fwrite(buffer, 1, count, file) != count) {
+				result = FAILURE;
+				break;
+			}
+		}
+		if ((fclose(file) == EOF) || (result == FAILURE)) {
+			perror("Error occured when writing the file");
+			result = FAILURE;
+		}
+	}
+	free(buffer);
+	free(corpus);
+	return result;
+}
+
+// Speeds are counted from the size of the input, ratio is the output of
+// the stage against the input
+void print_results(FILE* file_out, BENCHOPTIONS* options, RESULT* results, uint count)
+{
+	uint i;
+	uint s;
+
+	fprintf(file_out, "{\n");
+	fprintf(file_out, "  \"version\": %d,\n", BENCH_VERSION);
+#ifdef __VERSION__
+	fprintf(file_out, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+	fprintf(file_out, "  \"seed\": %llu,\n", options->seed);
+	fprintf(file_out, "  \"repeat\": %u,\n", options->repeat);
+	fprintf(file_out, "  \"block_size\": %d,\n", STREAM_BLOCK_SIZE);
+	fprintf(file_out, "  \"inputs\": [\n");
+	for (i = 0; i < count; i++) {
+		RESULT* result = &results[i];
+		fprintf(file_out, "    {\n");
+		fprintf(file_out, "      \"name\": \"%s\",\n", result->name);
+		fprintf(file_out, "      \"size\": %llu,\n", result->size);
+		fprintf(file_out, "      \"compressed\": %llu,\n", result->compressed);
+		fprintf(file_out, "      \"ratio\": %.6f,\n", (double)result->compressed / result->size);
+		fprintf(file_out, "      \"verified\": %s,\n", result->verified ? "true" : "false");
+		fprintf(file_out, "      \"stages\": [\n");
+		for (s = 0; s < result->stage_count; s++) {
+			STAGE* stage = &result->stages[s];
+			fprintf(file_out, "        { \"stage\": \"%s\", \"seconds\": %.6f, \"mb_per_s\": %.2f, \"ns_per_byte\": %.3f",
+				stage->name, stage->seconds, (stage->seconds > 0) ? result->size / stage->seconds / 1e6 : 0.0,
+				stage->seconds * 1e9 / result->size);
+			if (stage->output > 0) {
+				fprintf(file_out, ", \"output\": %llu, \"ratio\": %.6f", stage->output, (double)stage->output / result->size);
+			}
+			fprintf(file_out, " }%s\n", (s + 1 < result->stage_count) ? "," : "");
+		}
+		fprintf(file_out, "      ],\n");
+		fprintf(file_out, "      \"kernels\": [\n");
+		for (s = 0; s < result->kernel_count; s++) {
+			KERNEL* kernel = &result->kernels[s];
+			uint feature;
+			fprintf(file_out, "        { \"kernel\": \"%s\", \"features\": \"", kernel->name);
+			for (feature = 1; feature <= kernel->features; feature <<= 1) {
+				if (kernel->features & feature) {
+					fprintf(file_out, "%s%s", (kernel->features & (feature - 1)) ? "+" : "", cpu_feature_name(feature));
+				}
+			}
+			fprintf(file_out, "\", \"available\": %s, \"scalar_seconds\": %.6f, \"seconds\": %.6f, \"speedup\": %.3f }%s\n",
+				kernel->available ? "true" : "false", kernel->scalar_seconds, kernel->seconds,
+				(kernel->seconds > 0) ? kernel->scalar_seconds / kernel->seconds : 0.0, (s + 1 < result->kernel_count) ? "," : "");
+		}
+		fprintf(file_out, "      ]\n");
+		fprintf(file_out, "    }%s\n", (i + 1 < count) ? "," : "");
+	}
+	fprintf(file_out, "  ]\n");
+	fprintf(file_out, "}\n");
+}
+
+// Missing buffers are skipped
+void release_blocks(BLOCKS* blocks)
+{
+	free(blocks->freq_tables);
+	free(blocks->codes);
+	free(blocks->output);
+	free(blocks->output_sizes);
+	free(blocks->decoded);
+}
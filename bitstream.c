@@ -9,6 +9,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "bitstream.h"
 
@@ -20,6 +21,31 @@
 #define FAILURE 1
 #endif
 
+// Number of bytes in the bit buffer
+#define BIT_BUFFER_BYTES (BIT_BUFFER_WIDTH / UCHAR_WIDTH)
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Loads bytes from the block until the bit buffer cannot take another byte
+int bs_fill_buffer(BITSTREAM* bs);
+
+// Moves all complete bytes from the bit buffer to the block
+int bs_flush_buffer(BITSTREAM* bs);
+
+// Loads next bytes from the file to the block
+int bs_read_block(BITSTREAM* bs);
+
+// Writes the bytes collected in the block to the file
+int bs_write_block(BITSTREAM* bs);
+
+// Reads 64-bit word from the memory (highest byte first)
+uint64 bs_load_word(uchar* bytes);
+
+// Stores 64-bit word to the memory (highest byte first)
+void bs_store_word(uchar* bytes, uint64 word);
+
 /**
  * Public methods of the bitstream library
  */
@@ -28,97 +54,439 @@
 // Mode describes how this stream is used (not recommended to mix modes)
 BITSTREAM* bs_create(FILE* file_in, enum BITSTREAMMODE mode)
 {
-	// Try to allocate memory for the stream
-	BITSTREAM* bs = (BITSTREAM*)malloc(sizeof(BITSTREAM));
-	if (bs == NULL) {
+	return bs_create_buffered(file_in, mode, BS_BLOCK_SIZE);
+}
+
+// Creates new bitstream from the file given, the file is read and written
+// in blocks of block_size bytes
+BITSTREAM* bs_create_buffered(FILE* file_in, enum BITSTREAMMODE mode, size_t block_size)
+{
+	BITSTREAM* bs;
+	uchar* block;
+
+	// Block must hold at least one word of the bit buffer
+	if (block_size < BIT_BUFFER_BYTES) {
+		block_size = BIT_BUFFER_BYTES;
+	}
+	
+	// Try to allocate memory for the block
+	block = (uchar*)malloc(block_size);
+	if (block == NULL) {
 		perror("Could not allocate memory for bitstream (out of memory)");
 		return NULL;
 	}
 	
-	// Initialize stream and its buffer
+	// Create the stream on top of the block
+	bs = bs_create_memory(block, block_size, mode);
+	if (bs == NULL) {
+		free(block);
+		return NULL;
+	}
 	bs->file = file_in;
-	bs->mode = mode;
-	bs->byte_buffer = 0;
-	bs->byte_buffer_count = 0;
+	bs->block_owned = 1;
+	// Nothing is read from the file yet
+	if (mode == READ) {
+		bs->block_length = 0;
+	}
 	
 	return bs;
 }
 
+// Creates new bitstream on top of the memory block
+BITSTREAM* bs_create_memory(uchar* block, size_t size, enum BITSTREAMMODE mode)
+{
+	// Try to allocate memory for the stream
+	BITSTREAM* bs = (BITSTREAM*)malloc(sizeof(BITSTREAM));
+	if (bs == NULL) {
+		perror("Could not allocate memory for bitstream (out of memory)");
+		return NULL;
+	}
+	bs_init_memory(bs, block, size, mode);
+	return bs;
+}
+
+// Initializes the stream and its buffer
+void bs_init_memory(BITSTREAM* bs, uchar* block, size_t size, enum BITSTREAMMODE mode)
+{
+	bs->file = NULL;
+	bs->mode = mode;
+	bs->bit_buffer = 0;
+	bs->bit_buffer_count = 0;
+	bs->block = block;
+	bs->block_size = size;
+	bs->block_position = 0;
+	bs->block_length = size;
+	bs->block_owned = 0;
+	bs->file_bytes = 0;
+}
+
 // Releases the stream object and its allocated memory
 int bs_destroy(BITSTREAM* bs)
 {
+	int result = bs_close(bs);
+
+	// Release allocated memory
+	if (bs->block_owned) {
+		free(bs->block);
+	}
+	free(bs);
+	return result;
+}
+
+// Flushes the stream, the structure stays valid
+int bs_close(BITSTREAM* bs)
+{
+	int result = SUCCESS;
+
 	// In case the stream was opened in write mode, we should flush the buffer
 	// to the file (in case it has something in it)
-	if ((bs->mode == WRITE) && (bs->byte_buffer_count))
+	if (bs->mode == WRITE)
 	{
-		// Fill extra bits of the buffer with low bits
-		bs->byte_buffer <<= (UCHAR_WIDTH - bs->byte_buffer_count);
-		// Write the buffer to the file
-		if ((fputc(bs->byte_buffer, bs->file) == EOF) && ferror(bs->file)) {
-			perror("Error occured when writing the file");
-			return FAILURE;
+		// Extra bits of the last byte are already low in the buffer
+		bs->bit_buffer_count = (bs->bit_buffer_count + UCHAR_WIDTH - 1) & ~(UCHAR_WIDTH - 1);
+		if ((bs_flush_buffer(bs) == FAILURE) || (bs_write_block(bs) == FAILURE)) {
+			result = FAILURE;
 		}
 	}
-	// Release allocated memory
-	free(bs);
-	return SUCCESS;
+	return result;
 }
 
 // Reads single bit from the stream
 int bs_read_bit(BITSTREAM* bs, enum BIT* bit)
 {
-	int ch;
+	uint value;
 
-	// In case our buffer is empty, we must read next byte from the file
-	if (!bs->byte_buffer_count)
-	{
-		// If we're at the end of file, then something must be wrong
-		if (feof(bs->file)) {
-			fprintf(stderr, "Unexpected end of file!");
+	if (bs_read_bits(bs, 1, &value) == FAILURE) {
+		return FAILURE;
+	}
+	*bit = value ? HIGH : LOW;
+
+	return SUCCESS;
+}
+
+// Writes next bit to the stream
+int bs_write_bit(BITSTREAM* bs, enum BIT bit)
+{
+	return bs_write_bits(bs, (bit == HIGH) ? 1 : 0, 1);
+}
+
+// Writes several bits to the stream
+int bs_write_bits(BITSTREAM* bs, uint value, uint nbits)
+{
+	// Make room for the new bits by moving complete bytes to the block
+	if (bs->bit_buffer_count + nbits > BIT_BUFFER_WIDTH) {
+		if (bs_flush_buffer(bs) == FAILURE) {
 			return FAILURE;
 		}
-		// Read next byte from the file
-		ch = fgetc(bs->file);
-		if ((ch == EOF) && ferror(bs->file)) {
+	}
+	// Append the bits right after the bits which are already in buffer
+	bs->bit_buffer |= (uint64)value << (BIT_BUFFER_WIDTH - bs->bit_buffer_count - nbits);
+	bs->bit_buffer_count += nbits;
+	return SUCCESS;
+}
+
+// Reads several bits from the stream
+int bs_read_bits(BITSTREAM* bs, uint nbits, uint* value)
+{
+	if ((bs_peek_bits(bs, nbits, value) == FAILURE) || (bs_consume_bits(bs, nbits) == FAILURE)) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// Reads next bits from the stream without moving the cursor
+int bs_peek_bits(BITSTREAM* bs, uint nbits, uint* value)
+{
+	// Load more bytes only if the buffer cannot serve the request
+	if (bs->bit_buffer_count < nbits) {
+		if (bs_fill_buffer(bs) == FAILURE) {
+			return FAILURE;
+		}
+	}
+	// Bits which are not available at the end of file are low, because
+	// nothing is ever loaded past the last byte
+	*value = (uint)(bs->bit_buffer >> (BIT_BUFFER_WIDTH - nbits));
+	return SUCCESS;
+}
+
+// Moves the cursor of the stream past the bits which were peeked
+int bs_consume_bits(BITSTREAM* bs, uint nbits)
+{
+	// If file ended before these bits, then something must be wrong
+	if (bs->bit_buffer_count < nbits) {
+		fprintf(stderr, "Unexpected end of file!\n");
+		return FAILURE;
+	}
+	bs->bit_buffer <<= nbits;
+	bs->bit_buffer_count -= nbits;
+	return SUCCESS;
+}
+
+// Skips the bits until the byte boundary
+int bs_align(BITSTREAM* bs)
+{
+	// Bytes are always moved to and from the bit buffer as a whole, so the
+	// bits over the whole bytes are the ones we are looking for
+	uint rest = bs->bit_buffer_count % UCHAR_WIDTH;
+	if (bs->mode == WRITE) {
+		// Padding bits are already low in the buffer
+		if (rest) {
+			bs->bit_buffer_count += UCHAR_WIDTH - rest;
+		}
+		return SUCCESS;
+	}
+	return bs_consume_bits(bs, rest);
+}
+
+// Any whole byte after the padding is more data, failed read is not the end
+int bs_at_end(BITSTREAM* bs)
+{
+	if ((bs->bit_buffer_count < UCHAR_WIDTH) && (bs_fill_buffer(bs) == FAILURE)) {
+		return 0;
+	}
+	return bs->bit_buffer_count < UCHAR_WIDTH;
+}
+
+// Writes complete bytes from the buffer and block to the file
+int bs_flush(BITSTREAM* bs)
+{
+	if ((bs_flush_buffer(bs) == FAILURE) || (bs_write_block(bs) == FAILURE)) {
+		return FAILURE;
+	}
+	if ((bs->file != NULL) && fflush(bs->file)) {
+		perror("Error occured when writing the file");
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// Written bits are still in the block and the buffer, read bits were taken
+// from the block to the buffer (bytes loaded from the file include the block)
+uint64 bs_tell(BITSTREAM* bs)
+{
+	uint64 bytes;
+
+	if (bs->mode == WRITE) {
+		return (bs->file_bytes + bs->block_position) * UCHAR_WIDTH + bs->bit_buffer_count;
+	}
+	bytes = (bs->file != NULL) ? bs->file_bytes - (bs->block_length - bs->block_position) : bs->block_position;
+	return bytes * UCHAR_WIDTH - bs->bit_buffer_count;
+}
+
+// Reads whole bytes from the stream, bypassing the bit buffer where possible
+int bs_read_bytes(BITSTREAM* bs, uchar* bytes, size_t count)
+{
+	size_t n;
+
+	if (bs->bit_buffer_count % UCHAR_WIDTH) {
+		fprintf(stderr, "Stream is not aligned to the byte!\n");
+		return FAILURE;
+	}
+	// Take the bytes which are already in the bit buffer
+	while ((count > 0) && (bs->bit_buffer_count > 0)) {
+		*bytes++ = (uchar)(bs->bit_buffer >> (BIT_BUFFER_WIDTH - UCHAR_WIDTH));
+		bs->bit_buffer <<= UCHAR_WIDTH;
+		bs->bit_buffer_count -= UCHAR_WIDTH;
+		count--;
+	}
+	if (count == 0) {
+		return SUCCESS;
+	}
+	// Empty buffer may still hold the part of the byte at block position
+	bs->bit_buffer = 0;
+	// Copy the bytes which are loaded to the block
+	n = bs->block_length - bs->block_position;
+	if (n > count) {
+		n = count;
+	}
+	memcpy(bytes, &bs->block[bs->block_position], n);
+	bs->block_position += n;
+	bytes += n;
+	count -= n;
+	// Read the rest directly from the file
+	if ((count > 0) && ((bs->file == NULL) || (fread(bytes, 1, count, bs->file) != count))) {
+		if ((bs->file != NULL) && ferror(bs->file)) {
 			perror("Error occured when reading the file");
+		} else {
+			fprintf(stderr, "Unexpected end of file!\n");
+		}
+		return FAILURE;
+	}
+	bs->file_bytes += count;
+	return SUCCESS;
+}
+
+// Writes whole bytes to the stream, bypassing the bit buffer
+int bs_write_bytes(BITSTREAM* bs, uchar* bytes, size_t count)
+{
+	size_t n;
+
+	if (bs->bit_buffer_count % UCHAR_WIDTH) {
+		fprintf(stderr, "Stream is not aligned to the byte!\n");
+		return FAILURE;
+	}
+	// Move the bytes from bit buffer to the block first
+	if (bs_flush_buffer(bs) == FAILURE) {
+		return FAILURE;
+	}
+	while (count > 0) {
+		// Large pieces go directly to the file
+		if ((bs->file != NULL) && (count >= bs->block_size)) {
+			if (bs_write_block(bs) == FAILURE) {
+				return FAILURE;
+			}
+			if (fwrite(bytes, 1, count, bs->file) != count) {
+				perror("Error occured when writing the file");
+				return FAILURE;
+			}
+			bs->file_bytes += count;
+			return SUCCESS;
+		}
+		// Write full block to the file before adding more
+		if (bs->block_position == bs->block_size) {
+			if (bs->file == NULL) {
+				fprintf(stderr, "Output buffer is full!\n");
+				return FAILURE;
+			}
+			if (bs_write_block(bs) == FAILURE) {
+				return FAILURE;
+			}
+		}
+		n = bs->block_size - bs->block_position;
+		if (n > count) {
+			n = count;
+		}
+		memcpy(&bs->block[bs->block_position], bytes, n);
+		bs->block_position += n;
+		bytes += n;
+		count -= n;
+	}
+	return SUCCESS;
+}
+
+// Memory streams have nowhere to write, their room is what is left
+int bs_reserve(BITSTREAM* bs, size_t room)
+{
+	if (bs_flush_buffer(bs) == FAILURE) {
+		return FAILURE;
+	}
+	if ((bs->file != NULL) && (bs->block_size - bs->block_position < room)) {
+		return bs_write_block(bs);
+	}
+	return SUCCESS;
+}
+
+/**
+ * Private methods of the bitstream library
+ */
+
+// Fills the bit buffer with the bytes from the block
+int bs_fill_buffer(BITSTREAM* bs)
+{
+	// Load next bytes from the file when the block cannot fill whole word
+	if ((bs->file != NULL) && (bs->block_length - bs->block_position < BIT_BUFFER_BYTES)) {
+		if (bs_read_block(bs) == FAILURE) {
 			return FAILURE;
 		}
-		bs->byte_buffer = (uchar)ch;
-		// Set buffer size to full
-		bs->byte_buffer_count = UCHAR_WIDTH;
 	}
-	// Read next bit value and save it
-	*bit = (bs->byte_buffer & UCHAR_GET_MASK) ? HIGH : LOW;
-	// Set cursor to the next bit
-	bs->byte_buffer <<= 1;
-	// Decrease the number of bits in the buffer
-	bs->byte_buffer_count--;
 
+	if (bs->block_length - bs->block_position >= BIT_BUFFER_BYTES) {
+		// Load whole word at once, right after the bits already in buffer
+		// Partially loaded last byte is loaded again by the next fill, which
+		// is harmless as the bits are the same
+		bs->bit_buffer |= bs_load_word(&bs->block[bs->block_position]) >> bs->bit_buffer_count;
+		bs->block_position += (BIT_BUFFER_WIDTH - 1 - bs->bit_buffer_count) / UCHAR_WIDTH;
+		bs->bit_buffer_count |= BIT_BUFFER_WIDTH - UCHAR_WIDTH;
+	} else {
+		// Near the end of the data load byte by byte
+		while ((bs->bit_buffer_count <= BIT_BUFFER_WIDTH - UCHAR_WIDTH) && (bs->block_position < bs->block_length)) {
+			bs->bit_buffer |= (uint64)bs->block[bs->block_position++] << (BIT_BUFFER_WIDTH - UCHAR_WIDTH - bs->bit_buffer_count);
+			bs->bit_buffer_count += UCHAR_WIDTH;
+		}
+	}
 	return SUCCESS;
 }
 
-// Writes next bit to the stream
-int bs_write_bit(BITSTREAM* bs, enum BIT bit)
+// Moves complete bytes from the bit buffer to the block
+int bs_flush_buffer(BITSTREAM* bs)
 {
-	// Add new bit to the buffer (initially low)
-	bs->byte_buffer <<= 1;
-	if (bit == HIGH)
-	{
-		// Bit must be high, set it so
-		bs->byte_buffer |= UCHAR_SET_MASK;
+	uint bytes = bs->bit_buffer_count / UCHAR_WIDTH;
+
+	// Write the block to the file when it cannot take whole word
+	if (bs->block_size - bs->block_position < BIT_BUFFER_BYTES) {
+		if (bs_write_block(bs) == FAILURE) {
+			return FAILURE;
+		}
 	}
-	// Increase the number of bits in the buffer
-	bs->byte_buffer_count++;
-	// In case we have reached the limit of the buffer, write buffer to the file
-	if (bs->byte_buffer_count >= UCHAR_WIDTH)
-	{
-		if ((fputc(bs->byte_buffer, bs->file) == EOF) && ferror(bs->file)) {
-			perror("Error occured when writing the file");
+
+	if (bs->block_size - bs->block_position >= BIT_BUFFER_BYTES) {
+		// Store whole word at once, bytes which are not complete yet are
+		// overwritten by the next flush
+		bs_store_word(&bs->block[bs->block_position], bs->bit_buffer);
+		bs->block_position += bytes;
+	} else {
+		// Near the end of the memory block store byte by byte
+		uint i;
+		if (bs->block_size - bs->block_position < bytes) {
+			fprintf(stderr, "Output buffer is full!\n");
 			return FAILURE;
 		}
-		// Reset the buffer
-		bs->byte_buffer = 0;
-		bs->byte_buffer_count = 0;
+		for (i = 0; i < bytes; i++) {
+			bs->block[bs->block_position++] = (uchar)(bs->bit_buffer >> (BIT_BUFFER_WIDTH - UCHAR_WIDTH * (i + 1)));
+		}
+	}
+	// Remove stored bytes from the buffer (shifting by full width is undefined)
+	bs->bit_buffer = (bytes < BIT_BUFFER_BYTES) ? (bs->bit_buffer << (bytes * UCHAR_WIDTH)) : 0;
+	bs->bit_buffer_count -= bytes * UCHAR_WIDTH;
+	return SUCCESS;
+}
+
+// Moves unused bytes to the beginning of the block and fills the rest of it
+// from the file
+int bs_read_block(BITSTREAM* bs)
+{
+	size_t rest = bs->block_length - bs->block_position;
+
+	memmove(bs->block, &bs->block[bs->block_position], rest);
+	bs->block_position = 0;
+	bs->block_length = rest + fread(&bs->block[rest], 1, bs->block_size - rest, bs->file);
+	bs->file_bytes += bs->block_length - rest;
+	if (ferror(bs->file)) {
+		perror("Error occured when reading the file");
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// Writes the complete bytes of the block to the file
+int bs_write_block(BITSTREAM* bs)
+{
+	// Memory streams have nowhere to write
+	if (bs->file == NULL) {
+		return SUCCESS;
+	}
+	if (fwrite(bs->block, 1, bs->block_position, bs->file) != bs->block_position) {
+		perror("Error occured when writing the file");
+		return FAILURE;
 	}
+	bs->file_bytes += bs->block_position;
+	bs->block_position = 0;
 	return SUCCESS;
 }
+
+// Reads 64-bit word from the memory
+uint64 bs_load_word(uchar* bytes)
+{
+	return ((uint64)bytes[0] << 56) | ((uint64)bytes[1] << 48) | ((uint64)bytes[2] << 40) | ((uint64)bytes[3] << 32) |
+		((uint64)bytes[4] << 24) | ((uint64)bytes[5] << 16) | ((uint64)bytes[6] << 8) | (uint64)bytes[7];
+}
+
+// Stores 64-bit word to the memory
+void bs_store_word(uchar* bytes, uint64 word)
+{
+	int i;
+	for (i = BIT_BUFFER_BYTES - 1; i >= 0; i--) {
+		bytes[i] = (uchar)word;
+		word >>= UCHAR_WIDTH;
+	}
+}
@@ -30,6 +30,20 @@ typedef unsigned char uchar;
 typedef unsigned int uint;
 #endif
 
+#ifndef __UINT64_DEFINED__
+#define __UINT64_DEFINED__
+typedef unsigned long long uint64;
+#endif
+
+// Width of the bit buffer used for reading/writing several bits at once
+#define BIT_BUFFER_WIDTH 64
+
+// Maximum number of bits which can be peeked from the stream at once
+#define MAX_PEEK_BITS 32
+
+// Default size of the block buffer for reading/writing the file
+#define BS_BLOCK_SIZE 65536
+
 // Enumeration type for describing bit values
 enum BIT
 {
@@ -47,23 +61,82 @@ enum BITSTREAMMODE
 // Structure to hold file and written bytes info
 typedef struct BITSTREAM
 {
-	FILE* file; 				// binary file which contains byte data
+	FILE* file; 				// binary file which contains byte data (NULL
+								// if stream works on memory block only)
 	enum BITSTREAMMODE mode;	// how this stream is used
-	uchar byte_buffer;			// active byte loaded from file
-	uint byte_buffer_count;		// how many bits we have already used from byte
+	uint64 bit_buffer;			// bits loaded from file (aligned to the highest bit)
+	uint bit_buffer_count;		// how many bits are available in the buffer
+	uchar* block;				// bytes read from or waiting to be written to file
+	size_t block_size;			// how many bytes the block can hold
+	size_t block_position;		// position of the next unused byte in the block
+	size_t block_length;		// how many bytes of the block are valid (reading)
+	int block_owned;			// set if block is allocated by the stream
+	uint64 file_bytes;			// how many bytes were read from or written to
+								// the file
 } BITSTREAM;
 
-// Creates new bitstream from given file, rewinds the file to read from the
-// beginning
+// Creates new bitstream from given file with default block buffer
 BITSTREAM* bs_create(FILE* file_in, enum BITSTREAMMODE mode);
 
+// Creates new bitstream from given file with block buffer of given size
+BITSTREAM* bs_create_buffered(FILE* file_in, enum BITSTREAMMODE mode, size_t block_size);
+
+// Creates new bitstream which reads/writes the given memory block (stream
+// fails when reading or writing past the end of the block)
+BITSTREAM* bs_create_memory(uchar* block, size_t size, enum BITSTREAMMODE mode);
+
+// Sets up the stream structure owned by the caller on top of the memory
+// block (nothing is allocated, stream is finished with bs_close)
+void bs_init_memory(BITSTREAM* bs, uchar* block, size_t size, enum BITSTREAMMODE mode);
+
 // Releases bitstream which was created by bs_create method
 int bs_destroy(BITSTREAM* bs);
 
+// Writes out the last bits of the stream without releasing the structure
+int bs_close(BITSTREAM* bs);
+
 // Reads next bit from the stream
 int bs_read_bit(BITSTREAM* bs, enum BIT* bit);
 
 // Writes given bit to the stream
 int bs_write_bit(BITSTREAM* bs, enum BIT bit);
 
+// Writes lowest nbits (up to MAX_PEEK_BITS) of the value to the stream
+int bs_write_bits(BITSTREAM* bs, uint value, uint nbits);
+
+// Reads next nbits (1 to MAX_PEEK_BITS) from the stream
+int bs_read_bits(BITSTREAM* bs, uint nbits, uint* value);
+
+// Reads next nbits (1 to MAX_PEEK_BITS) from the stream without moving the
+// cursor, missing bits at the end of file are returned as low bits
+int bs_peek_bits(BITSTREAM* bs, uint nbits, uint* value);
+
+// Moves the cursor nbits forward (bits must be peeked before consuming)
+int bs_consume_bits(BITSTREAM* bs, uint nbits);
+
+// Moves the cursor to the beginning of the next byte (written bits are
+// padded with low bits)
+int bs_align(BITSTREAM* bs);
+
+// Writes all complete bytes of the stream to the file
+int bs_flush(BITSTREAM* bs);
+
+// Returns how many bits were read from or written to the stream so far
+uint64 bs_tell(BITSTREAM* bs);
+
+// Returns non-zero if only the padding of the last byte is left to read
+int bs_at_end(BITSTREAM* bs);
+
+// Reads count whole bytes from the stream (stream must be aligned)
+int bs_read_bytes(BITSTREAM* bs, uchar* bytes, size_t count);
+
+// Writes count whole bytes to the stream (stream must be aligned)
+int bs_write_bytes(BITSTREAM* bs, uchar* bytes, size_t count);
+
+// Moves the complete bytes of the bit buffer to the block, so the buffer
+// keeps less than a byte, and writes the block to the file first when less
+// than room bytes would be free after them (writing kernels store their
+// bytes straight to the block)
+int bs_reserve(BITSTREAM* bs, size_t room);
+
 #endif // __INCLUDES_BITSTREAM_H__
@@ -0,0 +1,298 @@
+/**
+ * canonical.c
+ *
+ * Implementation of the length-limited canonical codes
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 15:05
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitstream.h"
+#include "tree.h"
+#include "table.h"
+#include "canonical.h"
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+// Single item of the package-merge lists, either a character or package of
+// two items from the previous list
+typedef struct PACKAGE
+{
+	uint64 weight;				// total frequency of the characters in item
+	int ch;						// character of the item (-1 for packages)
+	int left;					// first packaged item (index in item list)
+	int right;					// second packaged item (index in item list)
+} PACKAGE;
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Function for sorting characters by their frequency
+int compare_packages(const void* p1, const void* p2);
+
+// Adds one to the code length of every character in the item
+void count_package(PACKAGE* items, int item, CODETABLE* codes);
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Finds the code lengths with the package-merge algorithm: characters are
+// coins of width 2^-max_length, on every level the cheapest pairs of the
+// previous level are packaged and merged with the characters, cheapest
+// 2n-2 items of the last level tell how long each code is
+int limit_code_lengths(FREQTABLE freq_table, uint max_length, CODETABLE* codes)
+{
+	PACKAGE items[MAX_CHAR * MAX_CANONICAL_LENGTH];
+	int lists[2][2 * MAX_CHAR];
+	int* previous = lists[0];
+	int* current = lists[1];
+	uint previous_count;
+	uint current_count;
+	uint item_count = 0;
+	uint leaf_count;
+	uint level;
+	uint i;
+
+	memset(codes, 0, sizeof(CODETABLE));
+
+	// Collect the characters which occur and sort them by frequency
+	for (i = 0; i < MAX_CHAR; i++) {
+		if (freq_table[i] > 0) {
+			items[item_count].weight = freq_table[i];
+			items[item_count].ch = (int)i;
+			items[item_count].left = -1;
+			items[item_count].right = -1;
+			item_count++;
+		}
+	}
+	leaf_count = item_count;
+	if (leaf_count == 0) {
+		return SUCCESS;
+	}
+	// Single character still needs a length to be stored in the header
+	if (leaf_count == 1) {
+		codes->length[items[0].ch] = 1;
+		return SUCCESS;
+	}
+	qsort(items, leaf_count, sizeof(PACKAGE), compare_packages);
+
+	// Limit must leave room for all the characters
+	if (max_length > MAX_CANONICAL_LENGTH) {
+		max_length = MAX_CANONICAL_LENGTH;
+	}
+	while ((1U << max_length) < leaf_count) {
+		max_length++;
+	}
+
+	// First level holds only the characters
+	for (i = 0; i < leaf_count; i++) {
+		previous[i] = (int)i;
+	}
+	previous_count = leaf_count;
+
+	// Each next level merges the characters with the packages of the
+	// previous level
+	for (level = 1; level < max_length; level++) {
+		uint leaf = 0;
+		uint pair = 0;
+		uint pair_count = previous_count / 2;
+		current_count = 0;
+		while ((leaf < leaf_count) || (pair < pair_count)) {
+			uint64 pair_weight = 0;
+			if (pair < pair_count) {
+				pair_weight = items[previous[2 * pair]].weight + items[previous[2 * pair + 1]].weight;
+			}
+			if ((pair >= pair_count) || ((leaf < leaf_count) && (items[leaf].weight <= pair_weight))) {
+				current[current_count++] = (int)leaf++;
+			} else {
+				items[item_count].weight = pair_weight;
+				items[item_count].ch = -1;
+				items[item_count].left = previous[2 * pair];
+				items[item_count].right = previous[2 * pair + 1];
+				current[current_count++] = (int)item_count++;
+				pair++;
+			}
+		}
+		// Current level becomes the previous one
+		previous = current;
+		current = (previous == lists[0]) ? lists[1] : lists[0];
+		previous_count = current_count;
+	}
+
+	// Every time the character is in the selected items its code gets one
+	// bit longer
+	for (i = 0; i < 2 * leaf_count - 2; i++) {
+		count_package(items, previous[i], codes);
+	}
+	return SUCCESS;
+}
+
+// Gives consecutive codes to the characters of the same length, shorter
+// codes first and characters in their natural order
+int build_canonical_codes(CODETABLE* codes)
+{
+	uint count[MAX_CANONICAL_LENGTH + 1];
+	uint64 next_code[MAX_CANONICAL_LENGTH + 1];
+	uint64 code = 0;
+	uint64 space = 0;
+	uint used = 0;
+	uint last = 0;
+	uint i;
+
+	// Count the characters of each length
+	memset(count, 0, sizeof(count));
+	for (i = 0; i < MAX_CHAR; i++) {
+		if (codes->length[i] > MAX_CANONICAL_LENGTH) {
+			fprintf(stderr, "Archive is corrupted!\n");
+			return FAILURE;
+		}
+		if (codes->length[i] > 0) {
+			count[codes->length[i]]++;
+			used++;
+			last = i;
+		}
+	}
+	codes->uniform = 0;
+
+	// Single character is coded with zero bits
+	if (used == 1) {
+		codes->uniform = 1;
+		codes->uniform_ch = (uchar)last;
+		return SUCCESS;
+	}
+
+	// Find the first code of each length, lengths must fill the whole
+	// code space exactly
+	for (i = 1; i <= MAX_CANONICAL_LENGTH; i++) {
+		code = (code + count[i - 1]) << 1;
+		next_code[i] = code;
+		space += (uint64)count[i] << (MAX_CANONICAL_LENGTH - i);
+	}
+	if (space != (1ULL << MAX_CANONICAL_LENGTH)) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+
+	// Assign the codes
+	for (i = 0; i < MAX_CHAR; i++) {
+		if (codes->length[i] > 0) {
+			codes->code[i] = next_code[codes->length[i]]++;
+		}
+	}
+	return SUCCESS;
+}
+
+// Counts the bits of the code length header
+uint code_lengths_bits(CODETABLE* codes)
+{
+	uint bits = 0;
+	uint i = 0;
+
+	while (i < MAX_CHAR) {
+		bits += CODE_LENGTH_WIDTH;
+		if (codes->length[i] > 0) {
+			i++;
+			continue;
+		}
+		// Run of unused characters has its length after the zero
+		bits += ZERO_RUN_WIDTH;
+		while ((i < MAX_CHAR) && (codes->length[i] == 0)) {
+			i++;
+		}
+	}
+	return bits;
+}
+
+// Writes the length of each character, runs of unused characters are
+// written as zero length followed by the run length
+int put_code_lengths(BITSTREAM* bs, CODETABLE* codes)
+{
+	uint i = 0;
+
+	while (i < MAX_CHAR) {
+		uint run = 0;
+		if (codes->length[i] > 0) {
+			if (bs_write_bits(bs, codes->length[i], CODE_LENGTH_WIDTH) == FAILURE) {
+				return FAILURE;
+			}
+			i++;
+			continue;
+		}
+		while ((i + run < MAX_CHAR) && (codes->length[i + run] == 0)) {
+			run++;
+		}
+		if (bs_write_bits(bs, run - 1, CODE_LENGTH_WIDTH + ZERO_RUN_WIDTH) == FAILURE) {
+			return FAILURE;
+		}
+		i += run;
+	}
+	return SUCCESS;
+}
+
+// Reads the length of each character
+int get_code_lengths(BITSTREAM* bs, CODETABLE* codes)
+{
+	uint value;
+	uint i = 0;
+
+	memset(codes, 0, sizeof(CODETABLE));
+	while (i < MAX_CHAR) {
+		if (bs_read_bits(bs, CODE_LENGTH_WIDTH, &value) == FAILURE) {
+			return FAILURE;
+		}
+		if (value > 0) {
+			codes->length[i++] = (uchar)value;
+			continue;
+		}
+		// Skip the run of unused characters
+		if (bs_read_bits(bs, ZERO_RUN_WIDTH, &value) == FAILURE) {
+			return FAILURE;
+		}
+		if (i + value + 1 > MAX_CHAR) {
+			fprintf(stderr, "Archive is corrupted!\n");
+			return FAILURE;
+		}
+		i += value + 1;
+	}
+	return SUCCESS;
+}
+
+/**
+ * Private methods of the library
+ */
+
+// Compares characters by their frequency (rarest first)
+int compare_packages(const void* p1, const void* p2)
+{
+	PACKAGE* package1 = (PACKAGE*)p1;
+	PACKAGE* package2 = (PACKAGE*)p2;
+
+	if (package1->weight != package2->weight) {
+		return (package1->weight > package2->weight) ? 1 : -1;
+	}
+	// Same frequency characters are kept in their natural order
+	return package1->ch - package2->ch;
+}
+
+// Walks the item down to its characters
+void count_package(PACKAGE* items, int item, CODETABLE* codes)
+{
+	if (items[item].ch >= 0) {
+		codes->length[items[item].ch]++;
+		return;
+	}
+	count_package(items, items[item].left, codes);
+	count_package(items, items[item].right, codes);
+}
@@ -0,0 +1,41 @@
+/**
+ * canonical.h
+ *
+ * Length-limited canonical codes which are described by code lengths only
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 15:05
+ */
+
+#ifndef __INCLUDES_CANONICAL_H__
+#define __INCLUDES_CANONICAL_H__
+
+// Longest code length which can be stored in the header
+#define MAX_CANONICAL_LENGTH 15
+
+// Default limit for the code lengths (codes fit to the first level of the
+// decoding table)
+#define DEFAULT_CANONICAL_LENGTH DECODE_TABLE_BITS
+
+// Width of the fields in the code length header
+#define CODE_LENGTH_WIDTH 4
+#define ZERO_RUN_WIDTH 8
+
+// Finds optimal code lengths for given frequencies so that no code is
+// longer than max_length (package-merge algorithm)
+int limit_code_lengths(FREQTABLE freq_table, uint max_length, CODETABLE* codes);
+
+// Assigns canonical codes to the characters based on their code lengths,
+// fails if lengths do not describe complete code
+int build_canonical_codes(CODETABLE* codes);
+
+// Returns how many bits put_code_lengths writes for the table
+uint code_lengths_bits(CODETABLE* codes);
+
+// Writes the code lengths of the table to the stream
+int put_code_lengths(BITSTREAM* bs, CODETABLE* codes);
+
+// Reads the code lengths from the stream to the table
+int get_code_lengths(BITSTREAM* bs, CODETABLE* codes);
+
+#endif // __INCLUDES_CANONICAL_H__
@@ -0,0 +1,132 @@
+/**
+ * checksum.c
+ *
+ * Implementation of the CRC32C checksums
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 21:00
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "checksum.h"
+
+// Reflected polynomial of CRC32C
+#define CRC32C_POLYNOMIAL 0x82F63B78
+
+// Tables of the software checksum, each table moves the checksum one more
+// byte further (8 bytes are taken at once)
+static uint crc_tables[8][256];
+
+// Tables are built only once, by the first thread which needs them
+static pthread_once_t crc_tables_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Builds the tables of the software checksum
+void build_crc_tables(void);
+
+// Checksum with the tables, 8 bytes per step
+uint crc32c_software(uint crc, uchar* block, ulong size);
+
+// Checksum with the crc32 instruction, 8 bytes per instruction
+uint crc32c_hardware(uint crc, uchar* block, ulong size);
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Processor is checked on every call, the check only reads the flags which
+// are filled when the program starts
+uint crc32c(uchar* block, ulong size)
+{
+#if defined(__GNUC__) && defined(__x86_64__)
+	if (__builtin_cpu_supports("sse4.2")) {
+		return ~crc32c_hardware(~0U, block, size);
+	}
+#endif
+	pthread_once(&crc_tables_once, build_crc_tables);
+	return ~crc32c_software(~0U, block, size);
+}
+
+/**
+ * Private methods of the library
+ */
+
+// First table is the usual bytewise table, others continue from it
+void build_crc_tables(void)
+{
+	uint crc;
+	uint i;
+	uint k;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (k = 0; k < 8; k++) {
+			crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+		}
+		crc_tables[0][i] = crc;
+	}
+	for (i = 0; i < 256; i++) {
+		for (k = 1; k < 8; k++) {
+			crc_tables[k][i] = (crc_tables[k - 1][i] >> 8) ^ crc_tables[0][crc_tables[k - 1][i] & 0xFF];
+		}
+	}
+}
+
+// Bytes are taken in little-endian order whatever the processor is
+uint crc32c_software(uint crc, uchar* block, ulong size)
+{
+	while (size >= 8) {
+		uint low = crc ^ ((uint)block[0] | ((uint)block[1] << 8) | ((uint)block[2] << 16) | ((uint)block[3] << 24));
+		uint high = (uint)block[4] | ((uint)block[5] << 8) | ((uint)block[6] << 16) | ((uint)block[7] << 24);
+		crc = crc_tables[7][low & 0xFF] ^ crc_tables[6][(low >> 8) & 0xFF] ^
+			crc_tables[5][(low >> 16) & 0xFF] ^ crc_tables[4][low >> 24] ^
+			crc_tables[3][high & 0xFF] ^ crc_tables[2][(high >> 8) & 0xFF] ^
+			crc_tables[1][(high >> 16) & 0xFF] ^ crc_tables[0][high >> 24];
+		block += 8;
+		size -= 8;
+	}
+	while (size-- > 0) {
+		crc = (crc >> 8) ^ crc_tables[0][(crc ^ *block++) & 0xFF];
+	}
+	return crc;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+// Compiled for SSE4.2 even if the rest of the program is not
+__attribute__((target("sse4.2")))
+uint crc32c_hardware(uint crc, uchar* block, ulong size)
+{
+	unsigned long long value = crc;
+	unsigned long long word;
+
+	while (size >= 8) {
+		memcpy(&word, block, 8);
+		value = __builtin_ia32_crc32di(value, word);
+		block += 8;
+		size -= 8;
+	}
+	crc = (uint)value;
+	while (size-- > 0) {
+		crc = __builtin_ia32_crc32qi(crc, *block++);
+	}
+	return crc;
+}
+
+#else
+
+// Other processors use the tables
+uint crc32c_hardware(uint crc, uchar* block, ulong size)
+{
+	pthread_once(&crc_tables_once, build_crc_tables);
+	return crc32c_software(crc, block, size);
+}
+
+#endif
@@ -0,0 +1,38 @@
+/**
+ * checksum.h
+ *
+ * CRC32C (Castagnoli) checksums of the decoded blocks, computed with the
+ * crc32 instruction of SSE4.2 when the processor has it
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 21:00
+ */
+
+#ifndef __INCLUDES_CHECKSUM_H__
+#define __INCLUDES_CHECKSUM_H__
+
+#ifndef __UINT_DEFINED__
+#define __UINT_DEFINED__
+typedef unsigned int uint;
+#endif
+
+#ifndef __UCHAR_DEFINED__
+#define __UCHAR_DEFINED__
+typedef unsigned char uchar;
+#endif
+
+#ifndef __ULONG_DEFINED__
+#define __ULONG_DEFINED__
+typedef unsigned long ulong;
+#endif
+
+// Width of the checksum in the archive
+#define CHECKSUM_WIDTH 32
+
+// Size of the checksum in bytes
+#define CHECKSUM_SIZE (CHECKSUM_WIDTH / 8)
+
+// Returns the CRC32C of the block
+uint crc32c(uchar* block, ulong size);
+
+#endif // __INCLUDES_CHECKSUM_H__
@@ -14,6 +14,20 @@
 #include "bitstream.h"
 #include "compression.h"
 #include "tree.h"
+#include "table.h"
+#include "pool.h"
+#include "histogram.h"
+#include "canonical.h"
+#include "mapping.h"
+#include "container.h"
+#include "index.h"
+#include "adaptive.h"
+#include "model.h"
+#include "stats.h"
+#include "checksum.h"
+#include "pipeline.h"
+#include "sync.h"
+#include "transform.h"
 
 #ifndef SUCCESS
 #define SUCCESS 0
@@ -23,6 +37,122 @@
 #define FAILURE 1
 #endif
 
+// How many characters are read from the file before encoding them
+#define ENCODE_CHUNK_SIZE 65536
+
+// How many characters are decoded before writing them to the file
+#define DECODE_CHUNK_SIZE 65536
+
+// Width of the fields in the block header
+#define BLOCK_SIZE_WIDTH 32
+#define BLOCK_TYPE_WIDTH 8
+
+// Size of the block header in bytes
+#define BLOCK_HEADER_SIZE ((2 * BLOCK_SIZE_WIDTH + BLOCK_TYPE_WIDTH) / 8)
+
+// Size of the stream sizes in the interleaved block (last stream takes the
+// rest of the payload, so its size is not stored)
+#define STREAM_SIZES_SIZE ((INTERLEAVE_STREAMS - 1) * BLOCK_SIZE_WIDTH / 8)
+
+// Size of the position of the whole block and the size of the transformed
+// block in the transformed block
+#define TRANSFORM_HEADER_SIZE (2 * BLOCK_SIZE_WIDTH / 8)
+
+// How many bytes the payload may exceed its block (description of the codes
+// and the transform header, as in compress_bound), larger payloads are
+// never written because such blocks are stored
+#define PAYLOAD_OVERHEAD_BOUND (BUFFER_HEADER_BOUND + TRANSFORM_HEADER_SIZE)
+
+// How many blocks are given to each thread at once
+#define BLOCKS_PER_THREAD 2
+
+// Longest file which fits to the legacy header
+#define LEGACY_MAX_LENGTH 0xFFFFFFFFULL
+
+// Describes how the block payload is coded
+enum BLOCKTYPE
+{
+	BLOCK_TREE = 0,		// serialized tree followed by character codes
+	BLOCK_CANONICAL = 1,	// code lengths followed by canonical codes
+	BLOCK_INTERLEAVED = 2,	// code lengths followed by the sizes of the
+							// streams and the streams of canonical codes
+	BLOCK_CONTEXT = 3,		// order-1 context model followed by canonical
+							// codes from the table of each context
+	BLOCK_STORED = 4,		// characters as they are
+	BLOCK_RUN = 5,			// single character which fills the whole block
+	BLOCK_TRANSFORM = 6,	// Burrows-Wheeler, move-to-front and zero-run
+							// transforms followed by code lengths and
+							// canonical codes of the transformed characters
+};
+
+// Tables of the buffer coding, kept between the calls so the calls do not
+// allocate memory
+struct CONTEXT
+{
+	CODINGOPTIONS options;		// how the buffers are encoded
+	FREQTABLE freq_table;		// frequencies of the last buffer
+	TREE tree;					// tree of the last buffer (tree codes only)
+	CODETABLE codes;			// codes of the last buffer
+	DECODETABLE table;			// decoding table, entries are reused
+	BITSTREAM bs;				// stream on top of the buffer
+};
+
+// Holds the data of single block which is coded by the worker thread
+typedef struct BLOCKJOB
+{
+	uint type;					// how the block is coded (BLOCKTYPE)
+	uint max_length;			// longest canonical code (0 for tree blocks)
+	int interleave;				// set to encode interleaved block
+	uint order;					// order of the model (1 for context block)
+	int transform;				// set to code the block after the transforms
+	CODINGSTATS* stats;			// measurements of the block (NULL if not measured)
+	int checksum;				// set if CRC32C of the characters follows the
+								// payload
+	uint crc;					// checksum read from the archive
+	uchar* input;				// data which is coded
+	ulong input_size;			// how many bytes of input are used
+	ulong input_capacity;		// how many bytes are allocated for input
+	uchar* output;				// coded data
+	ulong output_size;			// how many bytes of output are used
+	ulong output_capacity;		// how many bytes are allocated for output
+	int result;					// error code of the job
+} BLOCKJOB;
+
+// State of the stage which reads or writes the blocks of the stream (the
+// stage may run in its own thread, so it has its own measurements)
+typedef struct BLOCKSTAGE
+{
+	FILE* file;					// file which is read or written (NULL for none)
+	BITSTREAM* bs;				// archive which is read or written
+	CONTAINER* container;		// header of the archive (NULL for legacy)
+	BLOCKINDEX* index;			// index of the written blocks (NULL for none)
+	ulong block_size;			// how many characters are read for each block
+	uint64 position;			// offset of the next block in the archive (or
+								// characters in the blocks read from it)
+	CODINGSTATS* stats;			// measurements of the stage (NULL if not measured)
+	CODINGSTATS measured;		// where the stats point to
+} BLOCKSTAGE;
+
+// Holds the part of the whole file between its sync points, which is decoded
+// by the worker thread
+typedef struct SYNCJOB
+{
+	uchar* input;				// coded data from the byte of the first code
+	size_t input_size;			// how many bytes there are before the sync table
+	uint skip;					// bits of the first byte before the first code
+	uint64 end;					// where the codes of the part end (bits from
+								// the input)
+	int last;					// set if the part ends the file (end is then
+								// only the limit of the codes)
+	DECODETABLE* table;			// table of the whole file (only read)
+	uchar* output;				// where the characters of the part go
+	ulong output_size;			// how many characters the part has
+	int fd;						// file where the part is written at offset (-1
+								// if the output is not written by the job)
+	uint64 offset;				// where the part goes in the file
+	int result;					// error code of the job
+} SYNCJOB;
+
 /**
  * Definitions for the private methods of the library
  */
@@ -33,107 +163,391 @@ int get_length(BITSTREAM* bs, ulong* size);
 // Reads the tree structure from the stream
 int get_tree(BITSTREAM* bs, TREE** tree);
 
+// Reads the tree structure from the stream to the existing tree
+int read_tree(BITSTREAM* bs, TREE* tree);
+
 // Reads the node and its subnodes from the stream
 int get_node(BITSTREAM* bs, TREE* tree, NODE** node);
 
-// Reads the character from the stream
-int get_char(BITSTREAM* bs, NODE* node, uchar* ch);
-
-// Writes specified node information to the stream
-int put_node(BITSTREAM* bs, NODE* node);
-
-// Writes specified character to the stream
-int put_char(BITSTREAM* bs, uchar ch);
-
 // Writes the size of the original file to the stream
 int put_length(BITSTREAM* bs, ulong size);
 
 // Writes the encoding tree to the stream
 int put_tree(BITSTREAM* bs, NODE* node);
 
+// Writes the header of the whole file archive (legacy length or container)
+int put_header(BITSTREAM* bs, uint64 size, int stored, CODINGOPTIONS* options);
+
+// Reads the header of the whole file archive, tells the size of the
+// original file and if canonical codes are used
+int get_header(BITSTREAM* bs, CONTAINER* container);
+
+// Tells if the codes of the whole file are followed by the sync points
+int is_synced(uint64 size, int stored, CODINGOPTIONS* options);
+
+// Tells if the whole file archive is decoded by several threads (its header
+// tells that it has the sync points)
+int is_parallel(CONTAINER* container, DECODETABLE* table, CODINGOPTIONS* options);
+
+// Encodes the characters and adds the sync point to the table at every
+// interval of the file (codes must follow each other without gaps)
+// Returns error code
+int put_synced(BITSTREAM* bs, CODETABLE* codes, uchar* block, ulong size, SYNCTABLE* sync);
+
+// Decodes the whole file in the memory by several threads, each of them
+// decodes the parts between the sync points (start tells where the codes
+// begin in the data)
+// Returns error code
+int decode_synced(uchar* data, size_t size, uint64 start, CONTAINER* container, DECODETABLE* table, uchar* out, uint threads);
+
+// Decodes the whole file by several threads the same way to their own
+// buffers, positioned writes put each part to its place in the file while
+// other files (pipes) get the parts in their order
+// Returns error code
+int write_synced(uchar* data, size_t size, uint64 start, CONTAINER* container, DECODETABLE* table, FILE* file_out, uint threads, CODINGSTATS* stats);
+
+// Sets the input of the job which decodes the parts from first to next
+// (parts past the last sync point end at the limit of the codes)
+void plan_synced(SYNCJOB* job, uchar* data, uint64 start, size_t limit, SYNCTABLE* sync, uint64 first, uint64 next);
+
+// Decodes the part of the file and checks that its codes end at the next
+// sync point
+void sync_job(void* arg);
+
+// Finds the codes for the character frequencies, tree is built only for the
+// tree codes (max_length 0)
+int find_codes(FREQTABLE freq_table, uint max_length, TREE* tree, CODETABLE* codes);
+
+// Tells if the coded characters and their code description cannot be
+// shorter than the characters themselves
+int is_incompressible(FREQTABLE freq_table, uint64 size);
+
+// Finds the codes of the whole file or sets stored if the file is not made
+// smaller by coding (legacy format is always coded)
+int choose_codes(FREQTABLE freq_table, uint64 size, uint max_length, int legacy, TREE* tree, CODETABLE* codes, int* stored);
+
+// Encodes the characters, or copies them if there are no codes (stored)
+int put_chars(BITSTREAM* bs, CODETABLE* codes, uchar* block, ulong size);
+
+// Decodes the characters, or copies them if there is no table (stored)
+int get_chars(BITSTREAM* bs, DECODETABLE* table, uchar* block, ulong size);
+
+// Counts the bits of the code description (tree or code lengths) and all
+// the coded characters
+uint64 count_bits(FREQTABLE freq_table, uint max_length, CODETABLE* codes);
+
+// Counts the bits of the coded characters only
+uint64 count_code_bits(FREQTABLE freq_table, CODETABLE* codes);
+
+// Writes the code description (code lengths or the tree)
+int put_description(BITSTREAM* bs, int canonical, TREE* tree, CODETABLE* codes);
+
+// Reads the code description and prepares the decoding table for it
+int get_description(BITSTREAM* bs, int canonical, DECODETABLE** table);
+
+// Writes the block header and encoded block contents to the job output
+int put_block(BLOCKJOB* job);
+
+// Writes the block header and the contents with the order-0 codes already
+// found for the histogram, block which is not made smaller is stored
+int put_coded(BLOCKJOB* job, FREQTABLE freq_table, TREE* tree, CODETABLE* codes);
+
+// Writes the block header and the contents split to interleaved streams
+int put_interleaved(BLOCKJOB* job);
+
+// Decodes the contents of the interleaved block to the job output
+int get_interleaved(BLOCKJOB* job);
+
+// Writes the block header and the contents coded with the context model,
+// block of order-0 codes is written instead when it is not larger
+int put_context(BLOCKJOB* job);
+
+// Decodes the contents of the context block to the job output
+int get_context(BLOCKJOB* job);
+
+// Writes the block header and the codes of the transformed contents, block
+// of order-0 codes is written instead when it is not larger
+int put_transform(BLOCKJOB* job);
+
+// Decodes the transformed block and restores its contents to the job output
+int get_transform(BLOCKJOB* job);
+
+// Tells if the block is written without codes: it has single character or
+// coding cannot make it smaller
+int is_uncoded(FREQTABLE freq_table, ulong size);
+
+// Writes the run block of single character or the stored block
+int put_uncoded(BLOCKJOB* job, FREQTABLE freq_table);
+
+// Writes the characters of the block as they are
+int put_stored(BLOCKJOB* job, FREQTABLE freq_table);
+
+// Copies or fills the job output from the payload of the stored or run block
+int get_uncoded(BLOCKJOB* job);
+
+// Prepares the job output for the block and writes the block header to it
+BITSTREAM* open_block(BLOCKJOB* job, uint type, ulong payload_size);
+
+// Encodes the block of the job (run by the worker thread)
+void encode_job(void* arg);
+
+// Decodes the block of the job (run by the worker thread)
+void decode_job(void* arg);
+
+// Reads the header and payload of the next block to the job, sets done at
+// the end of the stream, container (if any) limits the size of the block
+int read_block(BITSTREAM* bs, BLOCKJOB* job, CONTAINER* container, int* done);
+
+// Decodes the blocks which follow in the stream until the end of stream,
+// pipelined decoding reads and writes the blocks in their own threads
+int decode_blocks(BITSTREAM* bs, FILE* file_out, uint threads, int pipeline, CONTAINER* container, CODINGSTATS* stats);
+
+// Reads next block of the input file to the job (read stage of encoding)
+int read_input(void* context, void* slot, int* done);
+
+// Writes the encoded block and adds it to the index (write stage of encoding)
+int write_output(void* context, void* slot);
+
+// Reads next block of the archive to the job (read stage of decoding)
+int read_archive(void* context, void* slot, int* done);
+
+// Writes the decoded block to the file (write stage of decoding)
+int write_decoded(void* context, void* slot);
+
+// Clears the stage and gives it its own measurements if the coding is
+// measured
+void init_stage(BLOCKSTAGE* stage, CODINGSTATS* stats);
+
+// Adds the measurements of the stage to the stats
+void collect_stage(BLOCKSTAGE* stage, CODINGSTATS* stats);
+
+// Decodes only the blocks which cover the range, using the block index
+int decode_indexed(FILE* file_in, FILE* file_out, CONTAINER* container, uint64 start, uint64 length);
+
+// Decodes the rest of the archive described by the container
+int decode_container(BITSTREAM* bs, FILE* file_out, uint threads, int pipeline, CONTAINER* container, CODINGSTATS* stats);
+
+// Decodes the adaptive codes which follow in the stream and writes only the
+// characters in the range to the file
+int decode_adaptive(BITSTREAM* bs, FILE* file_out, uint64 start, uint64 length, CODINGSTATS* stats);
+
+// Writes the checksum of the characters after the payload of the block
+void put_checksum(BLOCKJOB* job);
+
+// Checks the decoded characters against the checksum of the block
+// Returns error code
+int check_checksum(BLOCKJOB* job);
+
+// Makes sure the buffer can hold at least size bytes
+int reserve_buffer(uchar** buffer, ulong* capacity, ulong size);
+
+// Releases the buffers of the jobs
+void release_jobs(BLOCKJOB* jobs, uint count);
+
+// Gives every job its own measurements when the coding is measured
+int measure_jobs(BLOCKJOB* jobs, uint count, CODINGSTATS* stats);
+
+// Adds the measurements of the jobs to the stats and clears them
+void collect_jobs(BLOCKJOB* jobs, uint count, CODINGSTATS* stats);
+
+// Flushes the output stream and counts the bytes written to the file, then
+// releases the stream
+int finish_output(BITSTREAM* bs, CODINGSTATS* stats);
+
+// Reads the tree from the stream and prepares the decoding table for it
+int get_decode_table(BITSTREAM* bs, DECODETABLE** table);
+
+// Reads the code lengths from the stream and prepares the decoding table
+int get_canonical_table(BITSTREAM* bs, DECODETABLE** table);
+
+// Decodes size characters from the stream and writes them to the file
+int write_chars(BITSTREAM* bs, DECODETABLE* table, uint64 size, uchar* buffer, FILE* file_out, CODINGSTATS* stats);
+
+// Decodes size characters from the stream and writes only the characters
+// in the range to the file
+int write_range(BITSTREAM* bs, DECODETABLE* table, uint64 size, uint64 start, uint64 length, uchar* buffer, FILE* file_out, CODINGSTATS* stats);
+
+// Finds how many characters are left in the file (fails for pipes)
+int get_remaining(FILE* file_in, uint64* size);
+
+// Checks that the legacy archive ends right after its characters
+// Returns error code
+int check_legacy_end(BITSTREAM* bs, CONTAINER* container);
+
+// Counts the characters of the buffer and chooses its codes
+// Returns error code
+int choose_buffer_codes(CONTEXT* context, uchar* in, ulong in_size, int* stored);
+
+// Writes the header, the codes and the characters of the buffer
+// Returns error code
+int put_buffer(CONTEXT* context, BITSTREAM* bs, uchar* in, ulong in_size, int stored);
+
+// Encodes the input which could not be mapped, input which cannot be seeked
+// (pipe) is read only once
+int encode_unmapped(FILE* file_in, FILE* file_out, CODINGOPTIONS* options);
+
+// Copies the rest of the input to the temporary file and encodes it from
+// there as a whole file
+int encode_spooled(FILE* file_in, FILE* file_out, CODINGOPTIONS* options);
+
+// Opens the files at given paths (NULL for stdin/stdout) and codes them with
+// the coder function
+int code_paths(const char* path_in, const char* path_out, CODINGOPTIONS* options, int (*coder)(FILE*, FILE*, CODINGOPTIONS*));
+
+// Opens the output file for the stream when it could not be mapped
+BITSTREAM* open_output(const char* path_out, FILE** file_out);
+
+// Closes the output file opened by open_output (if any)
+int close_output(FILE* file_out);
+
 /**
  * Implementation of the public library methods
  */
 
+// Sets the defaults: container of 1 MiB blocks coded by single thread with
+// canonical codes which fit to the first level of the decoding table
+void init_coding_options(CODINGOPTIONS* options)
+{
+	options->block_size = STREAM_BLOCK_SIZE;
+	options->threads = 1;
+	options->max_length = DEFAULT_CANONICAL_LENGTH;
+	options->legacy = 0;
+	options->interleave = 0;
+	options->order = 0;
+	options->transform = 0;
+	options->checksum = 0;
+	options->pipeline = 0;
+	options->sync_interval = 0;
+	options->stats = NULL;
+}
+
 // Encodes contents of the input file and writes result to the output file
-int encode(FILE* file_in, FILE* file_out)
+int encode(FILE* file_in, FILE* file_out, CODINGOPTIONS* options)
 {
-	long s;
-	ulong size;
-	TREE* tree;
+	uint64 size;
+	uint max_length = options->legacy ? 0 : options->max_length;
+	CODINGSTATS* stats = options->stats;
+	FREQTABLE freq_table;
+	TREE tree;
+	CODETABLE codes;
+	SYNCTABLE sync;
+	uchar* buffer;
+	size_t count;
+	long start;
+	double total = start_phase(stats);
+	double phase;
+	int stored;
+	int synced;
+	int result;
+	BITSTREAM* bs;
 
-	// Open new stream for writing
-	BITSTREAM* bs = bs_create(file_out, WRITE);
-	if (bs == NULL) {
+	// Find out the size of the original file
+	start = ftell(file_in);
+	if ((start == -1L) || (get_remaining(file_in, &size) == FAILURE)) {
+		perror("Could not find out the size of the input file");
 		return FAILURE;
 	}
 	
-	// Find out the size of the original file
-	if (fseek(file_in, 0, SEEK_END)) {
-		perror("Could not seek end of input file");
-		bs_destroy(bs);
+	// Build the codes based on the contents of the file
+	phase = start_phase(stats);
+	if (histogram_file(file_in, freq_table, 1) == FAILURE) {
 		return FAILURE;
 	}
-	s = ftell(file_in);
-	if (s == 1L) {
-		perror("Could not tell cursor location in the input file");
-		bs_destroy(bs);
+	end_phase(stats, PHASE_HISTOGRAM, phase);
+	phase = start_phase(stats);
+	if (choose_codes(freq_table, size, max_length, options->legacy, &tree, &codes, &stored) == FAILURE) {
 		return FAILURE;
 	}
-	size = (ulong)s;
+	end_phase(stats, PHASE_CODES, phase);
 	
-	// Write size of the file to the stream
-	if (put_length(bs, size) == FAILURE) {
-		bs_destroy(bs);
+	// Open new stream for writing
+	bs = bs_create(file_out, WRITE);
+	if (bs == NULL) {
 		return FAILURE;
 	}
-
-	// Go to the beginning of the source file and build Huffmann tree based on
-	// its contents
-	rewind(file_in);	
-	tree = build_tree(file_in);
-	if (tree == NULL) {
+	
+	// Write size of the file and the codes to the stream (empty and stored
+	// files have no codes)
+	phase = start_phase(stats);
+	if ((put_header(bs, size, stored, options) == FAILURE) ||
+		((size > 0) && !stored && (put_description(bs, max_length > 0, &tree, &codes) == FAILURE))) {
 		bs_destroy(bs);
 		return FAILURE;
 	}
+	end_phase(stats, PHASE_HEADER, phase);
+	
+	// Sync points are counted from the first code
+	synced = is_synced(size, stored, options);
+	init_sync(&sync, options->sync_interval);
+	sync.start = bs_tell(bs);
 	
-	// Write the tree structure to the file
-	if (put_tree(bs, tree->root) == FAILURE) {
+	// Allocate memory for the characters read from the file
+	buffer = (uchar*)malloc(ENCODE_CHUNK_SIZE);
+	if (buffer == NULL) {
+		perror("Could not allocate memory for input buffer (out of memory)");
 		bs_destroy(bs);
-		release_tree(tree);
 		return FAILURE;
 	}
 	
 	// Encode the contents of the input file and write them to the target file
-	rewind(file_in);
-	while (!feof(file_in)) {
-		// Read next character
-		int ch = fgetc(file_in);
-		if ((ch == EOF) && ferror(file_in)) {
-			perror("Error occured when reading the file");
-			return FAILURE;
-		}
-		// Encode starting from the character node to the top of the tree
-		if (put_node(bs, tree->node_list[ch]) == FAILURE) {
-			release_tree(tree);
+	if (fseek(file_in, start, SEEK_SET)) {
+		perror("Could not seek the input file");
+		free(buffer);
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	phase = start_phase(stats);
+	while ((count = fread(buffer, 1, ENCODE_CHUNK_SIZE, file_in)) > 0) {
+		end_phase(stats, PHASE_IO, phase);
+		phase = start_phase(stats);
+		if ((synced ? put_synced(bs, &codes, buffer, count, &sync) : put_chars(bs, stored ? NULL : &codes, buffer, count)) == FAILURE) {
+			free(buffer);
+			release_sync(&sync);
 			bs_destroy(bs);
 			return FAILURE;
 		}
+		end_phase(stats, PHASE_CODING, phase);
+		phase = start_phase(stats);
+	}
+	end_phase(stats, PHASE_IO, phase);
+	if (ferror(file_in)) {
+		perror("Error occured when reading the file");
+		free(buffer);
+		release_sync(&sync);
+		bs_destroy(bs);
+		return FAILURE;
 	}
 	
-	// Release resources allocated by the tree and stream
-	release_tree(tree);
-	bs_destroy(bs);
+	// Table of the sync points follows the codes
+	if (synced && (put_sync(bs, &sync) == FAILURE)) {
+		free(buffer);
+		release_sync(&sync);
+		bs_destroy(bs);
+		return FAILURE;
+	}
 	
-	return SUCCESS;
+	// Release resources allocated by the buffer and stream
+	free(buffer);
+	release_sync(&sync);
+	result = finish_output(bs, stats);
+	if ((result == SUCCESS) && (stats != NULL)) {
+		stats->input_bytes += size;
+		stats->blocks++;
+		add_symbols(stats, freq_table, stored ? size * UCHAR_WIDTH : count_code_bits(freq_table, &codes));
+		end_total(stats, total);
+	}
+	return result;
 }
 
-// Decodes the contents of the source file and writes result to the output file
-int decode(FILE* file_in, FILE* file_out)
+// Decodes the contents of the source file and writes result to the output
+// file, format of the archive is found from its header
+int decode(FILE* file_in, FILE* file_out, CODINGOPTIONS* options)
 {
-	ulong size;
-	TREE* tree;
-	ulong i;
+	CONTAINER container;
+	CODINGSTATS* stats = options->stats;
+	double total = start_phase(stats);
+	double phase;
+	int result;
 
 	// Opens the bitstream for the input file
 	BITSTREAM* bs = bs_create(file_in, READ);
@@ -141,230 +555,2589 @@ int decode(FILE* file_in, FILE* file_out)
 		return FAILURE;
 	}
 	
-	// Tries to extract original file size from the stream
-	if (get_length(bs, &size) == FAILURE) {
+	// Tries to extract original file size and the kind of codes from the
+	// stream, then decodes the rest of the file
+	phase = start_phase(stats);
+	if (get_header(bs, &container) == FAILURE) {
 		bs_destroy(bs);
 		return FAILURE;
 	}
+	end_phase(stats, PHASE_HEADER, phase);
+	result = decode_container(bs, file_out, options->threads, options->pipeline, &container, stats);
+	if ((result == SUCCESS) && (stats != NULL)) {
+		stats->input_bytes += bs->file_bytes;
+		end_total(stats, total);
+	}
+	bs_destroy(bs);
+	return result;
+}
+
+// Encodes the mapped input straight from the memory, output has exact size
+// of the archive, so it is mapped too
+int encode_file(const char* path_in, const char* path_out, CODINGOPTIONS* options)
+{
+	MAPPING input;
+	MAPPING output;
+	FREQTABLE freq_table;
+	TREE tree;
+	CODETABLE codes;
+	SYNCTABLE sync;
+	BITSTREAM* bs;
+	FILE* file_out = NULL;
+	uint max_length = options->legacy ? 0 : options->max_length;
+	CODINGSTATS* stats = options->stats;
+	double total = start_phase(stats);
+	double phase;
+	uint64 bits;
+	int stored;
+	int synced;
+	int result;
+
+	// Pipes and other files which cannot be mapped are read with stdio
+	if (map_input(path_in, &input) == FAILURE) {
+		return code_paths(path_in, path_out, options, encode_unmapped);
+	}
 	
-	// Tries to extract encoding tree from the stream
-	if (get_tree(bs, &tree) == FAILURE) {
-		bs_destroy(bs);
+	// Build the codes of the whole file and find out the size of the archive
+	phase = start_phase(stats);
+	histogram_block(input.data, input.size, freq_table);
+	end_phase(stats, PHASE_HISTOGRAM, phase);
+	phase = start_phase(stats);
+	if (choose_codes(freq_table, input.size, max_length, options->legacy, &tree, &codes, &stored) == FAILURE) {
+		unmap_file(&input);
 		return FAILURE;
 	}
+	end_phase(stats, PHASE_CODES, phase);
+	bits = options->legacy ? ULONG_WIDTH : CONTAINER_HEADER_SIZE * UCHAR_WIDTH;
+	if (stored) {
+		bits += (uint64)input.size * UCHAR_WIDTH;
+	} else if (input.size > 0) {
+		bits += count_bits(freq_table, max_length, &codes);
+	}
+	// Table of the sync points starts from the byte boundary
+	synced = is_synced(input.size, stored, options);
+	init_sync(&sync, options->sync_interval);
+	if (synced) {
+		bits = (bits + UCHAR_WIDTH - 1) / UCHAR_WIDTH * UCHAR_WIDTH;
+		bits += sync_count(input.size, options->sync_interval) * SYNC_ENTRY_SIZE * UCHAR_WIDTH;
+	}
 	
-	// Tries to decode rest of the file and writes to the target file
-	for (i = 0; i < size; i++) {
-		uchar ch;
-		if (get_char(bs, tree->root, &ch) == FAILURE) {
-			bs_destroy(bs);
-			return FAILURE;
-		}
-		if ((fputc(ch, file_out) == EOF) && ferror(file_out)) {
-			perror("Error occured when writing the file");
-			bs_destroy(bs);
-			return FAILURE;
+	// Write to the mapped output if possible
+	if (map_output(path_out, (size_t)((bits + UCHAR_WIDTH - 1) / UCHAR_WIDTH), &output) == SUCCESS) {
+		bs = bs_create_memory(output.data, output.size, WRITE);
+	} else {
+		bs = open_output(path_out, &file_out);
+		output.fd = -1;
+	}
+	if (bs == NULL) {
+		if (output.fd != -1) {
+			unmap_file(&output);
 		}
-		fprintf(stderr, "%c", ch);
+		unmap_file(&input);
+		return FAILURE;
 	}
 	
-	// Releases allocated resources
-	release_tree(tree);
-	bs_destroy(bs);
-	
-	return SUCCESS;
-}
-
-/**
- * Private methods of the library
- */
-
-// Get the length of the original file
-int get_length(BITSTREAM* bs, ulong* size)
-{
-	enum BIT bit;
-	// Read the size of the file bit-by-bit
-	int i;
-	for (i = 0; i < ULONG_WIDTH; i++) {
-		// Move cursor and read next bit
-		(*size) <<= 1;
-		if (bs_read_bit(bs, &bit) == FAILURE) {
-			return FAILURE;
-		}
-		if (bit == HIGH) {
-			(*size) |= ULONG_SET_MASK;
+	// Write the size, code description and codes of the file
+	phase = start_phase(stats);
+	result = put_header(bs, input.size, stored, options);
+	if ((result == SUCCESS) && (input.size > 0) && !stored && (put_description(bs, max_length > 0, &tree, &codes) == FAILURE)) {
+		result = FAILURE;
+	}
+	end_phase(stats, PHASE_HEADER, phase);
+	phase = start_phase(stats);
+	sync.start = bs_tell(bs);
+	if (result == SUCCESS) {
+		if (synced) {
+			result = ((put_synced(bs, &codes, input.data, input.size, &sync) == FAILURE) ||
+				(put_sync(bs, &sync) == FAILURE)) ? FAILURE : SUCCESS;
+		} else if (put_chars(bs, stored ? NULL : &codes, input.data, input.size) == FAILURE) {
+			result = FAILURE;
 		}
 	}
-	fprintf(stderr, "%d\n", *size);
-	return SUCCESS;
-}
-
-// Get the tree structure from the file
-int get_tree(BITSTREAM* bs, TREE** tree)
-{
-	// Allocate memory
-	*tree = (TREE*)malloc(sizeof(TREE));
-	if (*tree == NULL) {
-		perror("Could not allocate memory for tree structure (out of memory)");
-		return FAILURE;
+	release_sync(&sync);
+	end_phase(stats, PHASE_CODING, phase);
+	
+	// Release the files
+	phase = start_phase(stats);
+	if (bs_destroy(bs) == FAILURE) {
+		result = FAILURE;
 	}
-	// Reset node list
-	memset((*tree)->node_list, 0, MAX_CHAR * sizeof(NODE*));
-	// Read node relations from the stream
-	if (get_node(bs, *tree, &((*tree)->root)) == FAILURE) {
-		free(*tree);
-		return FAILURE;
+	if (((output.fd != -1) && (unmap_file(&output) == FAILURE)) || (close_output(file_out) == FAILURE)) {
+		result = FAILURE;
 	}
-	return SUCCESS;
+	end_phase(stats, PHASE_IO, phase);
+	if ((result == SUCCESS) && (stats != NULL)) {
+		stats->input_bytes += input.size;
+		stats->output_bytes += (bits + UCHAR_WIDTH - 1) / UCHAR_WIDTH;
+		stats->blocks++;
+		add_symbols(stats, freq_table, stored ? (uint64)input.size * UCHAR_WIDTH : count_code_bits(freq_table, &codes));
+		end_total(stats, total);
+	}
+	unmap_file(&input);
+	return result;
 }
 
-// Read next node from the current position at the stream
-int get_node(BITSTREAM* bs, TREE* tree, NODE** node)
+// Decodes the mapped input straight to the mapped output, which has the size
+// written at the beginning of the archive
+int decode_file(const char* path_in, const char* path_out, CODINGOPTIONS* options)
 {
-	enum BIT bit;
+	MAPPING input;
+	MAPPING output;
+	CONTAINER container;
+	BITSTREAM* bs;
+	DECODETABLE* table = NULL;
+	FILE* file_out = NULL;
+	uchar* buffer;
+	CODINGSTATS* stats = options->stats;
+	double total = start_phase(stats);
+	double phase;
+	int result = FAILURE;
 
-	// Allocate memory for the node
-	(*node) = (NODE*)malloc(sizeof(NODE));
-	if (*node == NULL) {
-		perror("Could not allocate memory for node (out of memory)");
+	// Pipes are decoded the usual way
+	if (map_input(path_in, &input) == FAILURE) {
+		return code_paths(path_in, path_out, options, decode);
+	}
+	bs = bs_create_memory(input.data, input.size, READ);
+	if (bs == NULL) {
+		unmap_file(&input);
 		return FAILURE;
 	}
-	// Reset the structure
-	memset(*node, 0, sizeof(NODE));
 	
-	// Read next bit from the stream
-	if (bs_read_bit(bs, &bit) == FAILURE) {
-		free(*node);
+	// Read the size of the original file and its codes, archive of blocks
+	// is decoded the usual way (and measured there)
+	phase = start_phase(stats);
+	if (get_header(bs, &container) == FAILURE) {
+		bs_destroy(bs);
+		unmap_file(&input);
+		return FAILURE;
+	}
+	if (container.flags & (CONTAINER_BLOCKS | CONTAINER_ADAPTIVE)) {
+		bs_destroy(bs);
+		unmap_file(&input);
+		return code_paths(path_in, path_out, options, decode);
+	}
+	end_phase(stats, PHASE_HEADER, phase);
+	phase = start_phase(stats);
+	if ((container.length > 0) && !(container.flags & CONTAINER_STORED) &&
+		(get_description(bs, container.max_length > 0, &table) == FAILURE)) {
+		bs_destroy(bs);
+		unmap_file(&input);
 		return FAILURE;
 	}
+	end_phase(stats, PHASE_CODES, phase);
 	
-	// If it is high bit then we're at the branch node, so read the leafs also
-	if (bit == HIGH) {
-		if ((get_node(bs, tree, &((*node)->left)) == FAILURE) || (get_node(bs, tree, &((*node)->right)) == FAILURE)) {
-			free(*node);
-			return FAILURE;
+	// Decode all characters at once to the mapped output, if it cannot be
+	// mapped then write them chunk by chunk
+	if (map_output(path_out, (size_t)container.length, &output) == SUCCESS) {
+		phase = start_phase(stats);
+		if (is_parallel(&container, table, options)) {
+			result = decode_synced(input.data, input.size, bs_tell(bs), &container, table, output.data, options->threads);
+		} else {
+			result = (container.length > 0) ? get_chars(bs, table, output.data, (ulong)container.length) : SUCCESS;
+		}
+		if (result == SUCCESS) {
+			result = check_legacy_end(bs, &container);
 		}
+		end_phase(stats, PHASE_CODING, phase);
+		if ((result == SUCCESS) && (stats != NULL)) {
+			count_symbols(stats, output.data, (ulong)container.length);
+			stats->output_bytes += container.length;
+		}
+		phase = start_phase(stats);
+		if (unmap_file(&output) == FAILURE) {
+			result = FAILURE;
+		}
+		end_phase(stats, PHASE_IO, phase);
 	} else {
-		// This must be leaf node, so read the character it represents
-		int i;
-		for (i = 0; i < UCHAR_WIDTH; i++) {
-			(*node)->ch <<= 1;
-			if (bs_read_bit(bs, &bit) == FAILURE) {
-				free(*node);
-				return FAILURE;
-			}
-			if (bit == HIGH) {
-				(*node)->ch |= UCHAR_SET_MASK;
-			}
+		file_out = (path_out != NULL) ? fopen(path_out, "wb") : stdout;
+		buffer = (uchar*)malloc(DECODE_CHUNK_SIZE);
+		if (file_out == NULL) {
+			perror("Could not open output file");
+		} else if (buffer == NULL) {
+			perror("Could not allocate memory for output buffer (out of memory)");
+		} else if (is_parallel(&container, table, options)) {
+			result = write_synced(input.data, input.size, bs_tell(bs), &container, table, file_out, options->threads, stats);
+		} else if ((result = write_chars(bs, table, container.length, buffer, file_out, stats)) == SUCCESS) {
+			result = check_legacy_end(bs, &container);
 		}
-		// Check if this character is already loaded
-		if (tree->node_list[(*node)->ch] != NULL) {
-			// Cannot read same character twice
-			fprintf(stderr, "Archive is corrupted!\n");
-			free(*node);
-			return FAILURE;
-		} else {
-			// Bind character to the node
-			tree->node_list[(*node)->ch] = *node;
+		if (close_output(file_out) == FAILURE) {
+			result = FAILURE;
 		}
+		free(buffer);
 	}
-	return SUCCESS;	
+	if ((result == SUCCESS) && (stats != NULL)) {
+		stats->input_bytes += input.size;
+		stats->blocks++;
+		end_total(stats, total);
+	}
+	
+	// Releases allocated resources
+	if (table != NULL) {
+		release_decode_table(table);
+	}
+	bs_destroy(bs);
+	unmap_file(&input);
+	return result;
 }
 
-// Decodes the character by climbing on the huffmann tree
-int get_char(BITSTREAM* bs, NODE* node, uchar* ch)
+// Encodes the input file block by block, reading it only once
+int encode_stream(FILE* file_in, FILE* file_out, CODINGOPTIONS* options)
 {
-	enum BIT bit;
-	NODE* next;
+	ulong block_size = options->block_size;
+	uint threads = options->threads;
+	CONTAINER container;
+	BLOCKINDEX index;
+	BLOCKSTAGE reader;
+	BLOCKSTAGE writer;
+	uint64 position = 0;
+	POOL* pool;
+	PIPELINE* pipeline;
+	BLOCKJOB* jobs;
+	BLOCKJOB* batch;
+	uint batch_size;
+	uint job_count;
+	uint count;
+	uint i;
+	CODINGSTATS* stats = options->stats;
+	double total = start_phase(stats);
+	int result;
+	BITSTREAM* bs;
 
-	if (bs_read_bit(bs, &bit) == FAILURE) {
+	// Start the threads and prepare the jobs for them, pipelined coding has
+	// a batch for each stage
+	pool = pool_create(threads);
+	if (pool == NULL) {
 		return FAILURE;
 	}
-
-	// Get the next node for decoding
-	next = (bit == HIGH) ? node->right : node->left;
-	if (next == NULL) {
-		// Should not reach here unless ...
-		fprintf(stderr, "Archive is corrupted!\n");
+	batch_size = (threads > 1) ? threads * BLOCKS_PER_THREAD : 1;
+	job_count = options->pipeline ? batch_size * PIPELINE_DEPTH : batch_size;
+	jobs = (BLOCKJOB*)calloc(job_count, sizeof(BLOCKJOB));
+	if (jobs == NULL) {
+		perror("Could not allocate memory for block jobs (out of memory)");
+		pool_destroy(pool);
 		return FAILURE;
 	}
-
-	// If child nodes are empty then we are on the leaf, so return the character
-	if (next->left == NULL) {
-		*ch = next->ch;
-		return SUCCESS;
+	if (measure_jobs(jobs, job_count, stats) == FAILURE) {
+		release_jobs(jobs, job_count);
+		pool_destroy(pool);
+		return FAILURE;
 	}
-	
-	// We have to search the character from child node
-	return get_char(bs, next, ch);
-}
-
-// Encodes current node and all of its parent nodes info to the target file_in
-// as encoded character
-int put_node(BITSTREAM* bs, NODE* node)
-{
-	// First write parent bit
-	// Encoding writes from bottom to the top
-	// Decoding reads from top to the bottom
-	if (node->parent != NULL) {
-		if (node->parent->parent != NULL) {
-			if (put_node(bs, node->parent) == FAILURE) {
-				return FAILURE;
-			}
+	for (i = 0; i < job_count; i++) {
+		jobs[i].max_length = options->max_length;
+		jobs[i].interleave = options->interleave;
+		jobs[i].order = options->order;
+		jobs[i].transform = options->transform;
+		jobs[i].checksum = options->checksum && !options->legacy;
+		if (reserve_buffer(&jobs[i].input, &jobs[i].input_capacity, block_size) == FAILURE) {
+			release_jobs(jobs, job_count);
+			pool_destroy(pool);
+			return FAILURE;
 		}
-		return bs_write_bit(bs, (node->parent->left == node) ? LOW : HIGH);
 	}
-	return SUCCESS;
-}
 
-// Writes concrete character to the file
-int put_char(BITSTREAM* bs, uchar ch)
-{
-	int i;
-	for (i = 0; i < UCHAR_WIDTH; i++) {
-		// Write the highest bit to the file 
-		if (bs_write_bit(bs, (ch & UCHAR_GET_MASK) ? HIGH : LOW) == FAILURE) {
+	// Open new stream for writing
+	bs = bs_create(file_out, WRITE);
+	if (bs == NULL) {
+		release_jobs(jobs, job_count);
+		pool_destroy(pool);
+		return FAILURE;
+	}
+	
+	// Legacy stream has no header, otherwise the length is written when the
+	// input is a file and the blocks are indexed
+	init_index(&index);
+	if (!options->legacy) {
+		memset(&container, 0, sizeof(CONTAINER));
+		container.version = CONTAINER_VERSION;
+		container.flags = CONTAINER_BLOCKS | CONTAINER_INDEX;
+		if (options->checksum) {
+			container.flags |= CONTAINER_CHECKSUM;
+		}
+		container.block_size = block_size;
+		container.max_length = options->max_length;
+		if (get_remaining(file_in, &container.length) == SUCCESS) {
+			container.flags |= CONTAINER_LENGTH;
+		}
+		if (put_container(bs, &container) == FAILURE) {
+			release_jobs(jobs, job_count);
+			pool_destroy(pool);
+			bs_destroy(bs);
 			return FAILURE;
 		}
-		// Move cursor to the next bit
-		ch <<= 1;
+		position = CONTAINER_HEADER_SIZE;
 	}
-	return SUCCESS;
+	
+	// Next blocks are read for each job of the batch, encoded all in
+	// parallel and written in order, output starts as soon as the first
+	// blocks are coded (pipeline reads the next batch and writes the last
+	// one while this one is coded)
+	init_stage(&reader, stats);
+	reader.file = file_in;
+	reader.block_size = block_size;
+	init_stage(&writer, stats);
+	writer.bs = bs;
+	writer.index = options->legacy ? NULL : &index;
+	writer.position = position;
+	pipeline = pipeline_create(jobs, sizeof(BLOCKJOB), job_count, read_input, &reader, write_output, &writer, options->pipeline);
+	if (pipeline == NULL) {
+		release_index(&index);
+		release_jobs(jobs, job_count);
+		pool_destroy(pool);
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	while ((batch = (BLOCKJOB*)pipeline_take(pipeline, batch_size, &count)) != NULL) {
+		pool_run(pool, encode_job, batch, sizeof(BLOCKJOB), count);
+		collect_jobs(batch, count, stats);
+		pipeline_give(pipeline, count);
+	}
+	result = pipeline_finish(pipeline);
+	collect_stage(&reader, stats);
+	collect_stage(&writer, stats);
+	release_jobs(jobs, job_count);
+	pool_destroy(pool);
+	if (result == FAILURE) {
+		release_index(&index);
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	
+	// Empty block marks the end of the stream, index follows it
+	position = writer.position;
+	if ((bs_write_bits(bs, 0, BLOCK_SIZE_WIDTH) == FAILURE) ||
+		(!options->legacy && (put_index(bs, &index, position + BLOCK_SIZE_WIDTH / UCHAR_WIDTH) == FAILURE))) {
+		release_index(&index);
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	release_index(&index);
+	result = finish_output(bs, stats);
+	if (result == SUCCESS) {
+		end_total(stats, total);
+	}
+	return result;
 }
 
-// Writes the size of the original file to the stream
-int put_length(BITSTREAM* bs, ulong size)
+// Container is followed by the adaptive codes of all characters and the end
+// mark, stream is flushed after every chunk of the input
+int encode_adaptive(FILE* file_in, FILE* file_out, CODINGOPTIONS* options)
 {
-	int i;
-	for (i = 0; i < ULONG_WIDTH; i++) {
-		// Write the highest bit of the long variable
-		if (bs_write_bit(bs, (size & ULONG_GET_MASK) ? HIGH : LOW) == FAILURE) {
-			return FAILURE;
-		}
-		// Shift the cursor to the next bit
-		size <<= 1;
+	CONTAINER container;
+	ADAPTIVETREE* tree;
+	uchar* buffer;
+	size_t count;
+	CODINGSTATS* stats = options->stats;
+	double total = start_phase(stats);
+	double phase;
+	int result;
+	BITSTREAM* bs;
+
+	// Tree is too large for the stack
+	tree = (ADAPTIVETREE*)malloc(sizeof(ADAPTIVETREE));
+	buffer = (uchar*)malloc(ENCODE_CHUNK_SIZE);
+	if ((tree == NULL) || (buffer == NULL)) {
+		perror("Could not allocate memory for adaptive tree (out of memory)");
+		free(tree);
+		free(buffer);
+		return FAILURE;
+	}
+	init_adaptive_tree(tree);
+	bs = bs_create(file_out, WRITE);
+	if (bs == NULL) {
+		free(tree);
+		free(buffer);
+		return FAILURE;
+	}
+
+	memset(&container, 0, sizeof(CONTAINER));
+	container.version = CONTAINER_VERSION;
+	container.flags = CONTAINER_ADAPTIVE;
+	if (put_container(bs, &container) == FAILURE) {
+		free(tree);
+		free(buffer);
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	phase = start_phase(stats);
+	while ((count = fread(buffer, 1, ENCODE_CHUNK_SIZE, file_in)) > 0) {
+		end_phase(stats, PHASE_IO, phase);
+		phase = start_phase(stats);
+		if ((encode_adaptive_chars(bs, tree, buffer, count) == FAILURE) || (bs_flush(bs) == FAILURE)) {
+			free(tree);
+			free(buffer);
+			bs_destroy(bs);
+			return FAILURE;
+		}
+		end_phase(stats, PHASE_CODING, phase);
+		count_symbols(stats, buffer, (ulong)count);
+		if (stats != NULL) {
+			stats->input_bytes += count;
+		}
+		phase = start_phase(stats);
+	}
+	end_phase(stats, PHASE_IO, phase);
+	free(buffer);
+	if (ferror(file_in)) {
+		perror("Error occured when reading the file");
+		free(tree);
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	if (encode_adaptive_end(bs, tree) == FAILURE) {
+		free(tree);
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	free(tree);
+	result = finish_output(bs, stats);
+	if ((result == SUCCESS) && (stats != NULL)) {
+		stats->blocks++;
+		end_total(stats, total);
+	}
+	return result;
+}
+
+// Decodes the blocks of the input file until the end of stream, input
+// without container header is the legacy stream
+int decode_stream(FILE* file_in, FILE* file_out, CODINGOPTIONS* options)
+{
+	CONTAINER container;
+	CODINGSTATS* stats = options->stats;
+	double total = start_phase(stats);
+	int result;
+
+	// Opens the bitstream for the input file
+	BITSTREAM* bs = bs_create(file_in, READ);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	if (!is_container(bs)) {
+		result = decode_blocks(bs, file_out, options->threads, options->pipeline, NULL, stats);
+	} else if (get_container(bs, &container) == FAILURE) {
+		result = FAILURE;
+	} else {
+		result = decode_container(bs, file_out, options->threads, options->pipeline, &container, stats);
+	}
+	if ((result == SUCCESS) && (stats != NULL)) {
+		stats->input_bytes += bs->file_bytes;
+		end_total(stats, total);
+	}
+	bs_destroy(bs);
+	return result;
+}
+
+// Decodes only the characters in the range, archive of blocks with the index
+// is decoded from the first block of the range, other archives are decoded
+// from the beginning
+int decode_range(FILE* file_in, FILE* file_out, uint64 start, uint64 length)
+{
+	CONTAINER container;
+	DECODETABLE* table = NULL;
+	uchar* buffer;
+	int result;
+
+	// Read the header to find out the format of the archive
+	BITSTREAM* bs = bs_create(file_in, READ);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	if (get_header(bs, &container) == FAILURE) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	if (container.flags & CONTAINER_BLOCKS) {
+		bs_destroy(bs);
+		if (!(container.flags & CONTAINER_INDEX)) {
+			fprintf(stderr, "Archive has no block index!\n");
+			return FAILURE;
+		}
+		return decode_indexed(file_in, file_out, &container, start, length);
+	}
+	if (container.flags & CONTAINER_ADAPTIVE) {
+		result = decode_adaptive(bs, file_out, start, length, NULL);
+		bs_destroy(bs);
+		return result;
+	}
+	
+	// Whole file is decoded, but only the range is written
+	if (container.length == 0) {
+		result = check_legacy_end(bs, &container);
+		bs_destroy(bs);
+		return result;
+	}
+	if (!(container.flags & CONTAINER_STORED) && (get_description(bs, container.max_length > 0, &table) == FAILURE)) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	buffer = (uchar*)malloc(DECODE_CHUNK_SIZE);
+	if (buffer == NULL) {
+		perror("Could not allocate memory for output buffer (out of memory)");
+		if (table != NULL) {
+			release_decode_table(table);
+		}
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	result = write_range(bs, table, container.length, start, length, buffer, file_out, NULL);
+	// Rest of the legacy archive is decoded without writing it, as only its
+	// end tells it apart from the legacy stream of blocks
+	if ((result == SUCCESS) && (container.version == 0)) {
+		uint64 end = ((start < container.length) && (length < container.length - start)) ? start + length : container.length;
+		if (start >= end) {
+			end = 0;
+		}
+		result = write_range(bs, table, container.length - end, 0, ~0ULL, buffer, NULL, NULL);
+		if (result == SUCCESS) {
+			result = check_legacy_end(bs, &container);
+		}
+	}
+	free(buffer);
+	if (table != NULL) {
+		release_decode_table(table);
+	}
+	bs_destroy(bs);
+	return result;
+}
+
+// Context is allocated once with all its tables
+CONTEXT* create_context(CODINGOPTIONS* options)
+{
+	CONTEXT* context = (CONTEXT*)malloc(sizeof(CONTEXT));
+	if (context == NULL) {
+		perror("Could not allocate memory for coding context (out of memory)");
+		return NULL;
+	}
+	memset(context, 0, sizeof(CONTEXT));
+	context->options = *options;
+	if (context->options.legacy) {
+		context->options.max_length = 0;
+	}
+	// Buffers have no room for the sync points
+	context->options.sync_interval = 0;
+	return context;
+}
+
+// Releases the entries of the decoding table too
+void release_context(CONTEXT* context)
+{
+	free(context->table.entries);
+	free(context);
+}
+
+// No code is longer on average than 8 bits (fixed codes of all characters
+// are never better than the optimal codes), so archive has the header and
+// at most one byte per character
+ulong compress_bound(ulong size)
+{
+	return size + BUFFER_HEADER_BOUND;
+}
+
+// Size of the archive is known before writing it, so the output is checked
+// only once
+int encode_buffer(CONTEXT* context, uchar* in, ulong in_size, uchar* out, ulong out_capacity, ulong* out_size)
+{
+	uint max_length = context->options.max_length;
+	CODINGSTATS* stats = context->options.stats;
+	double total = start_phase(stats);
+	uint64 bits;
+	int stored;
+
+	// Build the codes for the whole buffer
+	if (choose_buffer_codes(context, in, in_size, &stored) == FAILURE) {
+		return FAILURE;
+	}
+	bits = context->options.legacy ? ULONG_WIDTH : CONTAINER_HEADER_SIZE * UCHAR_WIDTH;
+	if (stored) {
+		bits += (uint64)in_size * UCHAR_WIDTH;
+	} else if (in_size > 0) {
+		bits += count_bits(context->freq_table, max_length, &context->codes);
+	}
+	*out_size = (ulong)((bits + UCHAR_WIDTH - 1) / UCHAR_WIDTH);
+	if (*out_size > out_capacity) {
+		fprintf(stderr, "Output buffer is too small!\n");
+		return FAILURE;
+	}
+
+	// Write the header, codes and the characters
+	bs_init_memory(&context->bs, out, out_capacity, WRITE);
+	if ((put_buffer(context, &context->bs, in, in_size, stored) == FAILURE) || (bs_close(&context->bs) == FAILURE)) {
+		return FAILURE;
+	}
+	if (stats != NULL) {
+		stats->input_bytes += in_size;
+		stats->output_bytes += *out_size;
+		stats->blocks++;
+		add_symbols(stats, context->freq_table, stored ? (uint64)in_size * UCHAR_WIDTH : count_code_bits(context->freq_table, &context->codes));
+		end_total(stats, total);
+	}
+	return SUCCESS;
+}
+
+// Codes are read to the tables of the context, so nothing is allocated
+// unless the decoding table needs more subtables than before
+int decode_buffer(CONTEXT* context, uchar* in, ulong in_size, uchar* out, ulong out_capacity, ulong* out_size)
+{
+	CONTAINER container;
+	DECODETABLE* table = NULL;
+	CODINGSTATS* stats = context->options.stats;
+	double total = start_phase(stats);
+	double phase;
+
+	bs_init_memory(&context->bs, in, in_size, READ);
+	phase = start_phase(stats);
+	if (get_header(&context->bs, &container) == FAILURE) {
+		return FAILURE;
+	}
+	end_phase(stats, PHASE_HEADER, phase);
+	if (container.flags & (CONTAINER_BLOCKS | CONTAINER_ADAPTIVE)) {
+		fprintf(stderr, "Archive of blocks must be decoded as the stream!\n");
+		return FAILURE;
+	}
+	if (container.length > out_capacity) {
+		fprintf(stderr, "Output buffer is too small!\n");
+		return FAILURE;
+	}
+	*out_size = (ulong)container.length;
+	if (container.length == 0) {
+		return SUCCESS;
+	}
+
+	// Read the codes the same way get_description does (stored buffer has
+	// no codes)
+	phase = start_phase(stats);
+	if (!(container.flags & CONTAINER_STORED)) {
+		if (container.max_length > 0) {
+			if ((get_code_lengths(&context->bs, &context->codes) == FAILURE) || (build_canonical_codes(&context->codes) == FAILURE)) {
+				return FAILURE;
+			}
+		} else if (read_tree(&context->bs, &context->tree) == FAILURE) {
+			return FAILURE;
+		} else if (build_code_table(&context->tree, &context->codes) == FAILURE) {
+			fprintf(stderr, "Archive is corrupted!\n");
+			return FAILURE;
+		}
+		if (fill_decode_table(&context->table, &context->codes) == FAILURE) {
+			return FAILURE;
+		}
+		table = &context->table;
+	}
+	end_phase(stats, PHASE_CODES, phase);
+	phase = start_phase(stats);
+	if (get_chars(&context->bs, table, out, *out_size) == FAILURE) {
+		return FAILURE;
+	}
+	end_phase(stats, PHASE_CODING, phase);
+	if (stats != NULL) {
+		count_symbols(stats, out, *out_size);
+		stats->input_bytes += in_size;
+		stats->output_bytes += *out_size;
+		stats->blocks++;
+		end_total(stats, total);
+	}
+	return SUCCESS;
+}
+
+// Output bytes are the ones the stream has grown by
+int encode_buffer_stream(CONTEXT* context, uchar* in, ulong in_size, BITSTREAM* bs)
+{
+	CODINGSTATS* stats = context->options.stats;
+	double total = start_phase(stats);
+	uint64 start = bs_tell(bs);
+	int stored;
+
+	if ((choose_buffer_codes(context, in, in_size, &stored) == FAILURE) ||
+		(put_buffer(context, bs, in, in_size, stored) == FAILURE) || (bs_align(bs) == FAILURE)) {
+		return FAILURE;
+	}
+	if (stats != NULL) {
+		stats->input_bytes += in_size;
+		stats->output_bytes += (bs_tell(bs) - start) / UCHAR_WIDTH;
+		stats->blocks++;
+		add_symbols(stats, context->freq_table, stored ? (uint64)in_size * UCHAR_WIDTH : count_code_bits(context->freq_table, &context->codes));
+		end_total(stats, total);
+	}
+	return SUCCESS;
+}
+
+// Stream may go on after the archive, so the header must be the container
+// and the size is checked once the characters are decoded
+int decode_buffer_stream(BITSTREAM* bs, uint64 in_size, FILE* file_out, uint64 out_size)
+{
+	CONTAINER container;
+	uint64 start = bs_tell(bs);
+
+	if (get_header(bs, &container) == FAILURE) {
+		return FAILURE;
+	}
+	if ((container.version == 0) || (container.flags & (CONTAINER_BLOCKS | CONTAINER_ADAPTIVE)) || (container.length != out_size)) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	if (decode_container(bs, file_out, 1, 0, &container, NULL) == FAILURE) {
+		return FAILURE;
+	}
+	if (bs_tell(bs) - start > in_size * UCHAR_WIDTH) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+/**
+ * Private methods of the library
+ */
+
+// Histogram and the codes are kept in the context for writing the buffer
+int choose_buffer_codes(CONTEXT* context, uchar* in, ulong in_size, int* stored)
+{
+	CODINGSTATS* stats = context->options.stats;
+	double phase;
+
+	phase = start_phase(stats);
+	histogram_block(in, in_size, context->freq_table);
+	end_phase(stats, PHASE_HISTOGRAM, phase);
+	phase = start_phase(stats);
+	if (choose_codes(context->freq_table, in_size, context->options.max_length, context->options.legacy, &context->tree, &context->codes, stored) == FAILURE) {
+		return FAILURE;
+	}
+	end_phase(stats, PHASE_CODES, phase);
+	return SUCCESS;
+}
+
+// Stored buffer has no codes, empty buffer has only the header
+int put_buffer(CONTEXT* context, BITSTREAM* bs, uchar* in, ulong in_size, int stored)
+{
+	uint max_length = context->options.max_length;
+	CODINGSTATS* stats = context->options.stats;
+	double phase;
+
+	phase = start_phase(stats);
+	if ((put_header(bs, in_size, stored, &context->options) == FAILURE) ||
+		((in_size > 0) && !stored && (put_description(bs, max_length > 0, &context->tree, &context->codes) == FAILURE))) {
+		return FAILURE;
+	}
+	end_phase(stats, PHASE_HEADER, phase);
+	phase = start_phase(stats);
+	if (put_chars(bs, stored ? NULL : &context->codes, in, in_size) == FAILURE) {
+		return FAILURE;
+	}
+	end_phase(stats, PHASE_CODING, phase);
+	return SUCCESS;
+}
+
+// Get the length of the original file
+int get_length(BITSTREAM* bs, ulong* size)
+{
+	uint value;
+	// Read the size of the file at once
+	if (bs_read_bits(bs, ULONG_WIDTH, &value) == FAILURE) {
+		return FAILURE;
+	}
+	*size = value;
+	return SUCCESS;
+}
+
+// Get the tree structure from the file
+int get_tree(BITSTREAM* bs, TREE** tree)
+{
+	// Allocate memory for the tree and all of its nodes
+	*tree = (TREE*)malloc(sizeof(TREE));
+	if (*tree == NULL) {
+		perror("Could not allocate memory for tree structure (out of memory)");
+		return FAILURE;
+	}
+	if (read_tree(bs, *tree) == FAILURE) {
+		free(*tree);
+		return FAILURE;
 	}
 	return SUCCESS;
 }
 
+// Read the tree to the structure which may be reused
+int read_tree(BITSTREAM* bs, TREE* tree)
+{
+	// Reset node list
+	clear_tree(tree);
+	// Read node relations from the stream
+	return get_node(bs, tree, &tree->root);
+}
+
+// Read next node from the current position at the stream
+int get_node(BITSTREAM* bs, TREE* tree, NODE** node)
+{
+	uint value;
+
+	// Take the node from the tree, valid tree never has more nodes than the
+	// tree can hold
+	(*node) = new_node(tree);
+	if (*node == NULL) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	
+	// Look at the next bit from the stream together with the character which
+	// follows it in case of leaf node
+	if (bs_peek_bits(bs, 1 + UCHAR_WIDTH, &value) == FAILURE) {
+		return FAILURE;
+	}
+	
+	// If it is high bit then we're at the branch node, so read the leafs also
+	if (value >> UCHAR_WIDTH) {
+		if ((bs_consume_bits(bs, 1) == FAILURE) || (get_node(bs, tree, &((*node)->left)) == FAILURE) || (get_node(bs, tree, &((*node)->right)) == FAILURE)) {
+			return FAILURE;
+		}
+	} else {
+		// This must be leaf node, so take the character it represents
+		if (bs_consume_bits(bs, 1 + UCHAR_WIDTH) == FAILURE) {
+			return FAILURE;
+		}
+		(*node)->ch = (uchar)value;
+		// Check if this character is already loaded
+		if (tree->node_list[(*node)->ch] != NULL) {
+			// Cannot read same character twice
+			fprintf(stderr, "Archive is corrupted!\n");
+			return FAILURE;
+		} else {
+			// Bind character to the node
+			tree->node_list[(*node)->ch] = *node;
+		}
+	}
+	return SUCCESS;	
+}
+
+// Writes the size of the original file to the stream
+int put_length(BITSTREAM* bs, ulong size)
+{
+	return bs_write_bits(bs, (uint)size, ULONG_WIDTH);
+}
+
 // Writes the tree to the file starting from the root node
 int put_tree(BITSTREAM* bs, NODE* node)
 {
-	static int tab = 0;
-	int i;
-	for (i = 0; i < tab; i++)
-		fprintf(stderr, " ");
 	// If node is leaf, then write starting low bit and corresponding character
+	// (the character takes the lowest bits, so the leading bit stays low)
 	if ((node->left == NULL) && (node->right == NULL)) {
-		fprintf(stderr, "%c\n", node->ch);
-		return (bs_write_bit(bs, LOW) == SUCCESS) ? put_char(bs, node->ch) : FAILURE; 
+		return bs_write_bits(bs, node->ch, 1 + UCHAR_WIDTH);
 	}
-	fprintf(stderr, "@\n");
-	tab++;
 	// If node is branch write high bit and both child nodes
 	if ((bs_write_bit(bs, HIGH) == FAILURE) || (put_tree(bs, node->left) == FAILURE) || (put_tree(bs, node->right) == FAILURE)) {
 		return FAILURE;
 	}
-	tab--;
+	return SUCCESS;
+}
+
+// Container is written unless the legacy format is asked for, which can not
+// hold files of 4 GiB or more
+int put_header(BITSTREAM* bs, uint64 size, int stored, CODINGOPTIONS* options)
+{
+	CONTAINER container;
+
+	if (options->legacy) {
+		if (size > LEGACY_MAX_LENGTH) {
+			fprintf(stderr, "File is too large for the legacy format!\n");
+			return FAILURE;
+		}
+		return put_length(bs, (ulong)size);
+	}
+	memset(&container, 0, sizeof(CONTAINER));
+	container.version = CONTAINER_VERSION;
+	container.flags = stored ? CONTAINER_LENGTH | CONTAINER_STORED : CONTAINER_LENGTH;
+	container.length = size;
+	if (is_synced(size, stored, options)) {
+		container.flags |= CONTAINER_SYNC;
+		container.block_size = options->sync_interval;
+	}
+	container.max_length = options->max_length;
+	return put_container(bs, &container);
+}
+
+// Legacy archive starts with the 32-bit length and uses the tree, it is
+// described with the container of the same meaning
+int get_header(BITSTREAM* bs, CONTAINER* container)
+{
+	ulong size;
+
+	if (is_container(bs)) {
+		return get_container(bs, container);
+	}
+	memset(container, 0, sizeof(CONTAINER));
+	container->flags = CONTAINER_LENGTH;
+	if (get_length(bs, &size) == FAILURE) {
+		return FAILURE;
+	}
+	container->length = size;
+	return SUCCESS;
+}
+
+// Stored file can be read from any offset anyway, so only the codes of the
+// container get the sync points
+int is_synced(uint64 size, int stored, CODINGOPTIONS* options)
+{
+	return (options->sync_interval > 0) && !options->legacy && !stored && (size > 0);
+}
+
+// Stored and empty files have no table and no sync points
+int is_parallel(CONTAINER* container, DECODETABLE* table, CODINGOPTIONS* options)
+{
+	return (container->flags & CONTAINER_SYNC) && (table != NULL) && (options->threads > 1);
+}
+
+// Characters are coded up to the next interval at once, the point is added
+// right before the first character of the interval
+int put_synced(BITSTREAM* bs, CODETABLE* codes, uchar* block, ulong size, SYNCTABLE* sync)
+{
+	ulong count;
+
+	while (size > 0) {
+		count = sync->interval - (ulong)(sync->position % sync->interval);
+		if (count > size) {
+			count = size;
+		}
+		if ((sync->position > 0) && (sync->position % sync->interval == 0) &&
+			(add_sync(sync, bs_tell(bs) - sync->start) == FAILURE)) {
+			return FAILURE;
+		}
+		if (put_chars(bs, codes, block, count) == FAILURE) {
+			return FAILURE;
+		}
+		block += count;
+		size -= count;
+		sync->position += count;
+	}
+	return SUCCESS;
+}
+
+// Parts are split evenly between the jobs, every thread gets a few of them
+// so the threads finish at about the same time
+int decode_synced(uchar* data, size_t size, uint64 start, CONTAINER* container, DECODETABLE* table, uchar* out, uint threads)
+{
+	SYNCTABLE sync;
+	SYNCJOB* jobs;
+	POOL* pool;
+	uint64 interval = container->block_size;
+	uint64 parts;
+	uint64 first;
+	uint64 next;
+	size_t limit;
+	uint count;
+	uint i;
+	int result = SUCCESS;
+
+	if (get_sync(data, size, start, container->length, container->block_size, &sync) == FAILURE) {
+		return FAILURE;
+	}
+	parts = (uint64)sync.count + 1;
+	count = (parts < (uint64)threads * BLOCKS_PER_THREAD) ? (uint)parts : threads * BLOCKS_PER_THREAD;
+	limit = size - (size_t)sync.count * SYNC_ENTRY_SIZE;
+	jobs = (SYNCJOB*)calloc(count, sizeof(SYNCJOB));
+	if (jobs == NULL) {
+		perror("Could not allocate memory for decoding jobs (out of memory)");
+		release_sync(&sync);
+		return FAILURE;
+	}
+	pool = pool_create(threads);
+	if (pool == NULL) {
+		free(jobs);
+		release_sync(&sync);
+		return FAILURE;
+	}
+	
+	// Every job decodes its share of the parts straight to the output
+	for (i = 0; i < count; i++) {
+		first = parts * i / count;
+		next = parts * (i + 1) / count;
+		plan_synced(&jobs[i], data, start, limit, &sync, first, next);
+		jobs[i].table = table;
+		jobs[i].output = &out[first * interval];
+		jobs[i].output_size = (ulong)((jobs[i].last ? container->length : next * interval) - first * interval);
+		jobs[i].fd = -1;
+	}
+	pool_run(pool, sync_job, jobs, sizeof(SYNCJOB), count);
+	for (i = 0; i < count; i++) {
+		if (jobs[i].result == FAILURE) {
+			result = FAILURE;
+		}
+	}
+	pool_destroy(pool);
+	free(jobs);
+	release_sync(&sync);
+	return result;
+}
+
+// Jobs decode single part each, so the buffers take one interval per job,
+// and the file gets the batch of the parts before the next batch is decoded
+int write_synced(uchar* data, size_t size, uint64 start, CONTAINER* container, DECODETABLE* table, FILE* file_out, uint threads, CODINGSTATS* stats)
+{
+	SYNCTABLE sync;
+	SYNCJOB* jobs;
+	POOL* pool;
+	uint64 interval = container->block_size;
+	uint64 parts;
+	uint64 part;
+	uint64 base = 0;
+	size_t limit;
+	size_t buffer_size = (size_t)((container->length < interval) ? container->length : interval);
+	uint count;
+	uint batch;
+	uint i;
+	int fd = -1;
+	int result = SUCCESS;
+	double phase;
+
+	// Output written so far goes to the file before the positioned writes
+	if (fflush(file_out) == EOF) {
+		perror("Error occured when writing the file");
+		return FAILURE;
+	}
+	if (is_positioned(fileno(file_out), &base)) {
+		fd = fileno(file_out);
+	}
+	if (get_sync(data, size, start, container->length, container->block_size, &sync) == FAILURE) {
+		return FAILURE;
+	}
+	parts = (uint64)sync.count + 1;
+	count = (parts < (uint64)threads * BLOCKS_PER_THREAD) ? (uint)parts : threads * BLOCKS_PER_THREAD;
+	limit = size - (size_t)sync.count * SYNC_ENTRY_SIZE;
+	jobs = (SYNCJOB*)calloc(count, sizeof(SYNCJOB));
+	if (jobs == NULL) {
+		perror("Could not allocate memory for decoding jobs (out of memory)");
+		release_sync(&sync);
+		return FAILURE;
+	}
+	for (i = 0; (i < count) && (result == SUCCESS); i++) {
+		jobs[i].output = (uchar*)malloc(buffer_size);
+		if (jobs[i].output == NULL) {
+			perror("Could not allocate memory for output buffer (out of memory)");
+			result = FAILURE;
+		}
+	}
+	pool = (result == SUCCESS) ? pool_create(threads) : NULL;
+	if (pool == NULL) {
+		result = FAILURE;
+	}
+	
+	// Parts of the batch are written by the jobs (at their offsets) or in
+	// their order after the batch
+	for (part = 0; (part < parts) && (result == SUCCESS); part += batch) {
+		batch = (parts - part < count) ? (uint)(parts - part) : count;
+		for (i = 0; i < batch; i++) {
+			plan_synced(&jobs[i], data, start, limit, &sync, part + i, part + i + 1);
+			jobs[i].table = table;
+			jobs[i].output_size = (ulong)((jobs[i].last ? container->length : (part + i + 1) * interval) - (part + i) * interval);
+			jobs[i].fd = fd;
+			jobs[i].offset = base + (part + i) * interval;
+		}
+		phase = start_phase(stats);
+		pool_run(pool, sync_job, jobs, sizeof(SYNCJOB), batch);
+		end_phase(stats, PHASE_CODING, phase);
+		for (i = 0; (i < batch) && (result == SUCCESS); i++) {
+			if (jobs[i].result == FAILURE) {
+				result = FAILURE;
+				break;
+			}
+			count_symbols(stats, jobs[i].output, jobs[i].output_size);
+			phase = start_phase(stats);
+			if ((fd == -1) && (fwrite(jobs[i].output, 1, jobs[i].output_size, file_out) != jobs[i].output_size)) {
+				perror("Error occured when writing the file");
+				result = FAILURE;
+			}
+			end_phase(stats, PHASE_IO, phase);
+			if (stats != NULL) {
+				stats->output_bytes += jobs[i].output_size;
+			}
+		}
+	}
+	if (pool != NULL) {
+		pool_destroy(pool);
+	}
+	for (i = 0; i < count; i++) {
+		free(jobs[i].output);
+	}
+	free(jobs);
+	release_sync(&sync);
+	return result;
+}
+
+// Positions are counted from the byte of the first code, the job skips the
+// bits of its first byte before its first code
+void plan_synced(SYNCJOB* job, uchar* data, uint64 start, size_t limit, SYNCTABLE* sync, uint64 first, uint64 next)
+{
+	uint64 begin = start + ((first > 0) ? sync->offsets[first - 1] : 0);
+
+	job->input = &data[begin / UCHAR_WIDTH];
+	job->input_size = limit - (size_t)(begin / UCHAR_WIDTH);
+	job->skip = (uint)(begin % UCHAR_WIDTH);
+	job->last = (next == (uint64)sync->count + 1);
+	job->end = (job->last ? (uint64)limit * UCHAR_WIDTH : start + sync->offsets[next - 1]) - begin + job->skip;
+}
+
+// Codes which do not end at the next point mean that the offsets are wrong
+void sync_job(void* arg)
+{
+	SYNCJOB* job = (SYNCJOB*)arg;
+	BITSTREAM bs;
+	uint64 position;
+	uint bits;
+
+	job->result = FAILURE;
+	bs_init_memory(&bs, job->input, job->input_size, READ);
+	if (((job->skip > 0) && (bs_read_bits(&bs, job->skip, &bits) == FAILURE)) ||
+		(decode_chars(&bs, job->table, job->output, job->output_size) == FAILURE)) {
+		return;
+	}
+	position = bs_tell(&bs);
+	if (job->last ? (position > job->end) : (position != job->end)) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return;
+	}
+	if ((job->fd != -1) && (write_at(job->fd, job->output, job->output_size, job->offset) == FAILURE)) {
+		return;
+	}
+	job->result = SUCCESS;
+}
+
+// Canonical codes are found from the limited code lengths, tree codes by
+// walking the tree
+int find_codes(FREQTABLE freq_table, uint max_length, TREE* tree, CODETABLE* codes)
+{
+	uint i = 0;
+
+	if (max_length == 0) {
+		init_freq_tree(tree, freq_table);
+		if (build_code_table(tree, codes) == FAILURE) {
+			fprintf(stderr, "Codes of the tree would be longer than %d bits, limit the code length!\n", MAX_CODE_LENGTH - 1);
+			return FAILURE;
+		}
+		return SUCCESS;
+	}
+	if (limit_code_lengths(freq_table, max_length, codes) == FAILURE) {
+		return FAILURE;
+	}
+	// Empty input has no codes
+	while ((i < MAX_CHAR) && (freq_table[i] == 0)) {
+		i++;
+	}
+	return (i < MAX_CHAR) ? build_canonical_codes(codes) : SUCCESS;
+}
+
+// Tree takes 1 bit for each branch and 9 bits for each leaf, code lengths
+// take 4 bits for each used character and 12 bits for each run of unused
+// ones, single character takes no bits for the codes
+uint64 count_bits(FREQTABLE freq_table, uint max_length, CODETABLE* codes)
+{
+	uint64 bits = count_code_bits(freq_table, codes);
+	uint leaf_count = 0;
+	uint i;
+
+	for (i = 0; i < MAX_CHAR; i++) {
+		if (freq_table[i] > 0) {
+			leaf_count++;
+		}
+	}
+	if (max_length > 0) {
+		return bits + code_lengths_bits(codes);
+	}
+	return (leaf_count > 0) ? bits + (leaf_count - 1) + leaf_count * (1 + UCHAR_WIDTH) : bits;
+}
+
+// Single character has no bits in the uniform code
+uint64 count_code_bits(FREQTABLE freq_table, CODETABLE* codes)
+{
+	uint64 bits = 0;
+	uint i;
+
+	if (codes->uniform) {
+		return 0;
+	}
+	for (i = 0; i < MAX_CHAR; i++) {
+		bits += (uint64)freq_table[i] * codes->length[i];
+	}
+	return bits;
+}
+
+// Entropy is the lower limit of the average code length and every used
+// character takes at least its code length in the code description, so the
+// codes do not need to be built to tell that they would not help
+int is_incompressible(FREQTABLE freq_table, uint64 size)
+{
+	uint64 total;
+	uint used = 0;
+	uint i;
+	double entropy;
+
+	if (size == 0) {
+		return 0;
+	}
+	for (i = 0; i < MAX_CHAR; i++) {
+		if (freq_table[i] > 0) {
+			used++;
+		}
+	}
+	entropy = histogram_entropy(freq_table, &total);
+	return entropy * size + used * CODE_LENGTH_WIDTH >= (double)size * UCHAR_WIDTH;
+}
+
+// Entropy rules out most of the random files before the codes are built,
+// the rest are compared with their exact size
+int choose_codes(FREQTABLE freq_table, uint64 size, uint max_length, int legacy, TREE* tree, CODETABLE* codes, int* stored)
+{
+	*stored = !legacy && is_incompressible(freq_table, size);
+	if (*stored) {
+		return SUCCESS;
+	}
+	if (find_codes(freq_table, max_length, tree, codes) == FAILURE) {
+		return FAILURE;
+	}
+	*stored = !legacy && (size > 0) && (count_bits(freq_table, max_length, codes) >= size * UCHAR_WIDTH);
+	return SUCCESS;
+}
+
+// Stored characters start from the byte boundary
+int put_chars(BITSTREAM* bs, CODETABLE* codes, uchar* block, ulong size)
+{
+	return (codes == NULL) ? bs_write_bytes(bs, block, size) : encode_chars(bs, codes, block, size);
+}
+
+// Stored characters are copied straight from the stream
+int get_chars(BITSTREAM* bs, DECODETABLE* table, uchar* block, ulong size)
+{
+	return (table == NULL) ? bs_read_bytes(bs, block, size) : decode_chars(bs, table, block, size);
+}
+
+// Writes either the code lengths or the tree
+int put_description(BITSTREAM* bs, int canonical, TREE* tree, CODETABLE* codes)
+{
+	return canonical ? put_code_lengths(bs, codes) : put_tree(bs, tree->root);
+}
+
+// Reads either the code lengths or the tree
+int get_description(BITSTREAM* bs, int canonical, DECODETABLE** table)
+{
+	return canonical ? get_canonical_table(bs, table) : get_decode_table(bs, table);
+}
+
+// Writes the block header and the block contents, coded with the codes built
+// for this block only (tree of the block is on the stack, so nothing is
+// allocated for it)
+int put_block(BLOCKJOB* job)
+{
+	FREQTABLE freq_table;
+	TREE tree;
+	CODETABLE codes;
+	double phase;
+
+	// Find the codes of this block, the block with single character or
+	// without anything to gain from the codes is not coded
+	phase = start_phase(job->stats);
+	histogram_block(job->input, job->input_size, freq_table);
+	end_phase(job->stats, PHASE_HISTOGRAM, phase);
+	if (is_uncoded(freq_table, job->input_size)) {
+		return put_uncoded(job, freq_table);
+	}
+	phase = start_phase(job->stats);
+	if (find_codes(freq_table, job->max_length, &tree, &codes) == FAILURE) {
+		return FAILURE;
+	}
+	end_phase(job->stats, PHASE_CODES, phase);
+	return put_coded(job, freq_table, &tree, &codes);
+}
+
+// Size of the payload is known from the histogram, so the output is
+// prepared for the whole block at once
+int put_coded(BLOCKJOB* job, FREQTABLE freq_table, TREE* tree, CODETABLE* codes)
+{
+	BITSTREAM* bs;
+	ulong payload_size;
+	double phase;
+
+	payload_size = (ulong)((count_bits(freq_table, job->max_length, codes) + UCHAR_WIDTH - 1) / UCHAR_WIDTH);
+	if (payload_size >= job->input_size) {
+		return put_stored(job, freq_table);
+	}
+	phase = start_phase(job->stats);
+	bs = open_block(job, (job->max_length > 0) ? BLOCK_CANONICAL : BLOCK_TREE, payload_size);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	
+	// Write the code description and the codes
+	if (put_description(bs, job->max_length > 0, tree, codes) == FAILURE) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	end_phase(job->stats, PHASE_HEADER, phase);
+	phase = start_phase(job->stats);
+	if (encode_chars(bs, codes, job->input, job->input_size) == FAILURE) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	end_phase(job->stats, PHASE_CODING, phase);
+	add_symbols(job->stats, freq_table, count_code_bits(freq_table, codes));
+	
+	// Stream pads the last byte when it is released
+	return bs_destroy(bs);
+}
+
+// Characters go to the streams in turns, every stream starts from the
+// byte boundary so the decoder can read them all at the same time
+int put_interleaved(BLOCKJOB* job)
+{
+	FREQTABLE freq_table;
+	CODETABLE codes;
+	BITSTREAM* bs;
+	uint64 bits[INTERLEAVE_STREAMS];
+	ulong sizes[INTERLEAVE_STREAMS];
+	ulong payload_size;
+	ulong i;
+	uint s;
+	double phase;
+
+	// Streams can be read side by side only with canonical codes
+	phase = start_phase(job->stats);
+	histogram_block(job->input, job->input_size, freq_table);
+	end_phase(job->stats, PHASE_HISTOGRAM, phase);
+	if (is_uncoded(freq_table, job->input_size)) {
+		return put_uncoded(job, freq_table);
+	}
+	phase = start_phase(job->stats);
+	if ((limit_code_lengths(freq_table, (job->max_length > 0) ? job->max_length : DEFAULT_CANONICAL_LENGTH, &codes) == FAILURE) ||
+		(build_canonical_codes(&codes) == FAILURE)) {
+		return FAILURE;
+	}
+
+	// Find the size of each stream
+	memset(bits, 0, sizeof(bits));
+	if (!codes.uniform) {
+		for (i = 0; i < job->input_size; i++) {
+			bits[i % INTERLEAVE_STREAMS] += codes.length[job->input[i]];
+		}
+	}
+	payload_size = (code_lengths_bits(&codes) + UCHAR_WIDTH - 1) / UCHAR_WIDTH + STREAM_SIZES_SIZE;
+	for (s = 0; s < INTERLEAVE_STREAMS; s++) {
+		sizes[s] = (ulong)((bits[s] + UCHAR_WIDTH - 1) / UCHAR_WIDTH);
+		payload_size += sizes[s];
+	}
+	end_phase(job->stats, PHASE_CODES, phase);
+	if (payload_size >= job->input_size) {
+		return put_stored(job, freq_table);
+	}
+
+	phase = start_phase(job->stats);
+	bs = open_block(job, BLOCK_INTERLEAVED, payload_size);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	if ((put_code_lengths(bs, &codes) == FAILURE) || (bs_align(bs) == FAILURE)) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	for (s = 0; s < INTERLEAVE_STREAMS - 1; s++) {
+		if (bs_write_bits(bs, (uint)sizes[s], BLOCK_SIZE_WIDTH) == FAILURE) {
+			bs_destroy(bs);
+			return FAILURE;
+		}
+	}
+	end_phase(job->stats, PHASE_HEADER, phase);
+	phase = start_phase(job->stats);
+	for (s = 0; (s < INTERLEAVE_STREAMS) && (s < job->input_size); s++) {
+		ulong count = (job->input_size - s + INTERLEAVE_STREAMS - 1) / INTERLEAVE_STREAMS;
+		if ((encode_strided(bs, &codes, job->input + s, count, INTERLEAVE_STREAMS) == FAILURE) ||
+			(bs_align(bs) == FAILURE)) {
+			bs_destroy(bs);
+			return FAILURE;
+		}
+	}
+	end_phase(job->stats, PHASE_CODING, phase);
+	add_symbols(job->stats, freq_table, count_code_bits(freq_table, &codes));
+	return bs_destroy(bs);
+}
+
+// Code lengths are followed by the sizes of the streams, the streams are
+// taken straight from the payload
+int get_interleaved(BLOCKJOB* job)
+{
+	CODETABLE codes;
+	DECODETABLE* table;
+	BITSTREAM* bs;
+	uchar* streams[INTERLEAVE_STREAMS];
+	ulong sizes[INTERLEAVE_STREAMS];
+	ulong offset;
+	uint s;
+	double phase = start_phase(job->stats);
+	int result;
+
+	bs = bs_create_memory(job->input, job->input_size, READ);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	result = get_code_lengths(bs, &codes);
+	bs_destroy(bs);
+	if ((result == FAILURE) || (build_canonical_codes(&codes) == FAILURE)) {
+		return FAILURE;
+	}
+
+	// Sizes of the first streams must leave the last stream inside the payload
+	offset = (code_lengths_bits(&codes) + UCHAR_WIDTH - 1) / UCHAR_WIDTH;
+	if (offset + STREAM_SIZES_SIZE > job->input_size) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	sizes[INTERLEAVE_STREAMS - 1] = job->input_size - offset - STREAM_SIZES_SIZE;
+	for (s = 0; s < INTERLEAVE_STREAMS - 1; s++) {
+		uchar* size = job->input + offset + s * BLOCK_SIZE_WIDTH / UCHAR_WIDTH;
+		sizes[s] = ((ulong)size[0] << 24) | ((ulong)size[1] << 16) | ((ulong)size[2] << 8) | (ulong)size[3];
+		if (sizes[s] > sizes[INTERLEAVE_STREAMS - 1]) {
+			fprintf(stderr, "Archive is corrupted!\n");
+			return FAILURE;
+		}
+		sizes[INTERLEAVE_STREAMS - 1] -= sizes[s];
+	}
+	streams[0] = job->input + offset + STREAM_SIZES_SIZE;
+	for (s = 1; s < INTERLEAVE_STREAMS; s++) {
+		streams[s] = streams[s - 1] + sizes[s - 1];
+	}
+
+	table = build_decode_table(&codes);
+	if (table == NULL) {
+		return FAILURE;
+	}
+	end_phase(job->stats, PHASE_CODES, phase);
+	phase = start_phase(job->stats);
+	result = decode_interleaved(streams, sizes, table, job->output, job->output_size);
+	end_phase(job->stats, PHASE_CODING, phase);
+	release_decode_table(table);
+	return result;
+}
+
+// Context model is aligned to the byte boundary, so the codes can be
+// decoded straight from the payload
+int put_context(BLOCKJOB* job)
+{
+	CONTEXTMODEL model;
+	FREQTABLE freq_table;
+	TREE tree;
+	CODETABLE codes;
+	BITSTREAM* bs;
+	uint max_length = (job->max_length > 0) ? job->max_length : DEFAULT_CANONICAL_LENGTH;
+	uint64 model_bits;
+	uint64 bits;
+	ulong payload_size;
+	double phase;
+
+	// Run of single character needs no model (order-0 histogram does not
+	// tell if the contexts would make the block smaller)
+	phase = start_phase(job->stats);
+	histogram_block(job->input, job->input_size, freq_table);
+	end_phase(job->stats, PHASE_HISTOGRAM, phase);
+	if (freq_table[job->input[0]] == job->input_size) {
+		return put_uncoded(job, freq_table);
+	}
+
+	phase = start_phase(job->stats);
+	if (build_context_model(job->input, job->input_size, max_length, &model, &bits) == FAILURE) {
+		return FAILURE;
+	}
+	model_bits = context_model_bits(&model);
+	payload_size = (ulong)((model_bits + UCHAR_WIDTH - 1) / UCHAR_WIDTH + (bits - model_bits + UCHAR_WIDTH - 1) / UCHAR_WIDTH);
+
+	// Single table of the whole block wins when the block has no structure
+	// or is too small to pay for the tables
+	if (find_codes(freq_table, job->max_length, &tree, &codes) == FAILURE) {
+		return FAILURE;
+	}
+	end_phase(job->stats, PHASE_CODES, phase);
+	if ((count_bits(freq_table, job->max_length, &codes) + UCHAR_WIDTH - 1) / UCHAR_WIDTH <= payload_size) {
+		return is_uncoded(freq_table, job->input_size) ? put_uncoded(job, freq_table) : put_coded(job, freq_table, &tree, &codes);
+	}
+	if (payload_size >= job->input_size) {
+		return put_stored(job, freq_table);
+	}
+
+	phase = start_phase(job->stats);
+	bs = open_block(job, BLOCK_CONTEXT, payload_size);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	if ((put_context_model(bs, &model) == FAILURE) || (bs_align(bs) == FAILURE)) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	end_phase(job->stats, PHASE_HEADER, phase);
+	phase = start_phase(job->stats);
+	if (encode_contexts(bs, model.codes, model.map, job->input, job->input_size) == FAILURE) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	end_phase(job->stats, PHASE_CODING, phase);
+	add_symbols(job->stats, freq_table, bits - model_bits);
+	return bs_destroy(bs);
+}
+
+// Decoding tables of the model are filled on the stack and only their
+// entries are allocated
+int get_context(BLOCKJOB* job)
+{
+	CONTEXTMODEL model;
+	DECODETABLE tables[CONTEXT_MAX_TABLES];
+	BITSTREAM* bs;
+	ulong offset;
+	uint k;
+	double phase = start_phase(job->stats);
+	int result;
+
+	bs = bs_create_memory(job->input, job->input_size, READ);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	result = get_context_model(bs, &model);
+	bs_destroy(bs);
+	if (result == FAILURE) {
+		return FAILURE;
+	}
+	offset = (ulong)((context_model_bits(&model) + UCHAR_WIDTH - 1) / UCHAR_WIDTH);
+	if (offset > job->input_size) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+
+	memset(tables, 0, sizeof(tables));
+	for (k = 0; (k < model.table_count) && (result == SUCCESS); k++) {
+		result = fill_decode_table(&tables[k], &model.codes[k]);
+	}
+	end_phase(job->stats, PHASE_CODES, phase);
+	phase = start_phase(job->stats);
+	if (result == SUCCESS) {
+		result = decode_contexts(job->input + offset, job->input_size - offset, tables, model.table_count, model.map, job->output, job->output_size);
+	}
+	end_phase(job->stats, PHASE_CODING, phase);
+	for (k = 0; k < model.table_count; k++) {
+		free(tables[k].entries);
+	}
+	return result;
+}
+
+// Block is transformed in its own buffer, the ranks of the characters take
+// the start of the buffer and their zero runs the rest
+int put_transform(BLOCKJOB* job)
+{
+	FREQTABLE freq_table;
+	FREQTABLE run_table;
+	TREE tree;
+	CODETABLE codes;
+	TREE run_tree;
+	CODETABLE run_codes;
+	BITSTREAM* bs;
+	uchar* ranks;
+	uchar* runs;
+	ulong run_size;
+	ulong block_size;
+	ulong payload_size;
+	uint primary;
+	uint max_length = (job->max_length > 0) ? job->max_length : DEFAULT_CANONICAL_LENGTH;
+	double phase;
+
+	// Blocks which are not coded and the blocks too large to sort are left
+	// to the order-0 codes
+	phase = start_phase(job->stats);
+	histogram_block(job->input, job->input_size, freq_table);
+	end_phase(job->stats, PHASE_HISTOGRAM, phase);
+	if (is_uncoded(freq_table, job->input_size)) {
+		return put_uncoded(job, freq_table);
+	}
+	phase = start_phase(job->stats);
+	if (find_codes(freq_table, job->max_length, &tree, &codes) == FAILURE) {
+		return FAILURE;
+	}
+	block_size = (ulong)((count_bits(freq_table, job->max_length, &codes) + UCHAR_WIDTH - 1) / UCHAR_WIDTH);
+	end_phase(job->stats, PHASE_CODES, phase);
+	if (job->input_size > TRANSFORM_MAX_SIZE) {
+		return put_coded(job, freq_table, &tree, &codes);
+	}
+
+	phase = start_phase(job->stats);
+	ranks = (uchar*)malloc(job->input_size + zero_run_bound(job->input_size));
+	if (ranks == NULL) {
+		perror("Could not allocate memory for the transform (out of memory)");
+		return FAILURE;
+	}
+	runs = ranks + job->input_size;
+	if (bwt_encode(job->input, job->input_size, ranks, &primary) == FAILURE) {
+		free(ranks);
+		return FAILURE;
+	}
+	mtf_encode(ranks, job->input_size);
+	zero_run_encode(ranks, job->input_size, runs, &run_size);
+	end_phase(job->stats, PHASE_TRANSFORM, phase);
+	phase = start_phase(job->stats);
+	histogram_block(runs, run_size, run_table);
+	end_phase(job->stats, PHASE_HISTOGRAM, phase);
+	phase = start_phase(job->stats);
+	if (find_codes(run_table, max_length, &run_tree, &run_codes) == FAILURE) {
+		free(ranks);
+		return FAILURE;
+	}
+	payload_size = TRANSFORM_HEADER_SIZE + (ulong)((count_bits(run_table, max_length, &run_codes) + UCHAR_WIDTH - 1) / UCHAR_WIDTH);
+	end_phase(job->stats, PHASE_CODES, phase);
+
+	// Transforms do not help the blocks without the repeated contexts
+	if (block_size <= payload_size) {
+		free(ranks);
+		return put_coded(job, freq_table, &tree, &codes);
+	}
+	if (payload_size >= job->input_size) {
+		free(ranks);
+		return put_stored(job, freq_table);
+	}
+
+	phase = start_phase(job->stats);
+	bs = open_block(job, BLOCK_TRANSFORM, payload_size);
+	if (bs == NULL) {
+		free(ranks);
+		return FAILURE;
+	}
+	if ((bs_write_bits(bs, primary, BLOCK_SIZE_WIDTH) == FAILURE) ||
+		(bs_write_bits(bs, (uint)run_size, BLOCK_SIZE_WIDTH) == FAILURE) ||
+		(put_description(bs, 1, &run_tree, &run_codes) == FAILURE)) {
+		free(ranks);
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	end_phase(job->stats, PHASE_HEADER, phase);
+	phase = start_phase(job->stats);
+	if (encode_chars(bs, &run_codes, runs, run_size) == FAILURE) {
+		free(ranks);
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	end_phase(job->stats, PHASE_CODING, phase);
+	add_symbols(job->stats, freq_table, count_code_bits(run_table, &run_codes));
+	free(ranks);
+	return bs_destroy(bs);
+}
+
+// Zero runs are decoded to the start of the buffer and their ranks follow
+// them, the transform is undone from the ranks to the job output
+int get_transform(BLOCKJOB* job)
+{
+	DECODETABLE* table;
+	BITSTREAM* bs;
+	uchar* runs;
+	uchar* ranks;
+	uint primary;
+	uint run_size;
+	double phase = start_phase(job->stats);
+	int result;
+
+	bs = bs_create_memory(job->input, job->input_size, READ);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	if ((bs_read_bits(bs, BLOCK_SIZE_WIDTH, &primary) == FAILURE) ||
+		(bs_read_bits(bs, BLOCK_SIZE_WIDTH, &run_size) == FAILURE)) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	if ((run_size == 0) || (run_size > zero_run_bound(job->output_size))) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	if (get_description(bs, 1, &table) == FAILURE) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	end_phase(job->stats, PHASE_CODES, phase);
+	runs = (uchar*)malloc(run_size + job->output_size);
+	if (runs == NULL) {
+		perror("Could not allocate memory for the transform (out of memory)");
+		release_decode_table(table);
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	ranks = runs + run_size;
+	phase = start_phase(job->stats);
+	result = decode_chars(bs, table, runs, run_size);
+	end_phase(job->stats, PHASE_CODING, phase);
+	release_decode_table(table);
+	bs_destroy(bs);
+
+	phase = start_phase(job->stats);
+	if (result == SUCCESS) {
+		result = zero_run_decode(runs, run_size, ranks, job->output_size);
+	}
+	if (result == SUCCESS) {
+		mtf_decode(ranks, job->output_size);
+		result = bwt_decode(ranks, job->output_size, primary, job->output);
+	}
+	end_phase(job->stats, PHASE_TRANSFORM, phase);
+	free(runs);
+	return result;
+}
+
+// Run is found from the frequency of the first character
+int is_uncoded(FREQTABLE freq_table, ulong size)
+{
+	uint used = 0;
+	uint i;
+
+	for (i = 0; i < MAX_CHAR; i++) {
+		if (freq_table[i] > 0) {
+			used++;
+		}
+	}
+	return (used == 1) || is_incompressible(freq_table, size);
+}
+
+// Payload of the run block is the character
+int put_uncoded(BLOCKJOB* job, FREQTABLE freq_table)
+{
+	BITSTREAM* bs;
+	double phase;
+
+	if (freq_table[job->input[0]] != job->input_size) {
+		return put_stored(job, freq_table);
+	}
+	phase = start_phase(job->stats);
+	bs = open_block(job, BLOCK_RUN, 1);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	if (bs_write_bits(bs, job->input[0], UCHAR_WIDTH) == FAILURE) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	end_phase(job->stats, PHASE_HEADER, phase);
+	add_symbols(job->stats, freq_table, 0);
+	return bs_destroy(bs);
+}
+
+// Header is flushed before the characters are copied after it
+int put_stored(BLOCKJOB* job, FREQTABLE freq_table)
+{
+	BITSTREAM* bs;
+	double phase = start_phase(job->stats);
+
+	bs = open_block(job, BLOCK_STORED, job->input_size);
+	if ((bs == NULL) || (bs_destroy(bs) == FAILURE)) {
+		return FAILURE;
+	}
+	memcpy(job->output + BLOCK_HEADER_SIZE, job->input, job->input_size);
+	end_phase(job->stats, PHASE_CODING, phase);
+	add_symbols(job->stats, freq_table, (uint64)job->input_size * UCHAR_WIDTH);
+	return SUCCESS;
+}
+
+// Payload must have exactly the characters of the stored block or the
+// single character of the run
+int get_uncoded(BLOCKJOB* job)
+{
+	double phase = start_phase(job->stats);
+
+	if (job->input_size != ((job->type == BLOCK_STORED) ? job->output_size : 1)) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	if (job->type == BLOCK_STORED) {
+		memcpy(job->output, job->input, job->output_size);
+	} else {
+		memset(job->output, job->input[0], job->output_size);
+	}
+	end_phase(job->stats, PHASE_CODING, phase);
+	return SUCCESS;
+}
+
+// Reserves room for the header and the payload and writes the header
+BITSTREAM* open_block(BLOCKJOB* job, uint type, ulong payload_size)
+{
+	BITSTREAM* bs;
+
+	job->output_size = BLOCK_HEADER_SIZE + payload_size + (job->checksum ? CHECKSUM_SIZE : 0);
+	if (reserve_buffer(&job->output, &job->output_capacity, job->output_size) == FAILURE) {
+		return NULL;
+	}
+	bs = bs_create_memory(job->output, BLOCK_HEADER_SIZE + payload_size, WRITE);
+	if (bs == NULL) {
+		return NULL;
+	}
+	if ((bs_write_bits(bs, (uint)job->input_size, BLOCK_SIZE_WIDTH) == FAILURE) ||
+		(bs_write_bits(bs, (uint)payload_size, BLOCK_SIZE_WIDTH) == FAILURE) ||
+		(bs_write_bits(bs, type, BLOCK_TYPE_WIDTH) == FAILURE)) {
+		bs_destroy(bs);
+		return NULL;
+	}
+	return bs;
+}
+
+// Encodes single block
+void encode_job(void* arg)
+{
+	BLOCKJOB* job = (BLOCKJOB*)arg;
+	if (job->transform) {
+		job->result = put_transform(job);
+	} else if (job->order > 0) {
+		job->result = put_context(job);
+	} else {
+		job->result = job->interleave ? put_interleaved(job) : put_block(job);
+	}
+	if ((job->result == SUCCESS) && job->checksum) {
+		put_checksum(job);
+	}
+	if ((job->result == SUCCESS) && (job->stats != NULL)) {
+		job->stats->blocks++;
+	}
+}
+
+// Decodes single block into the output buffer which already has room for it
+void decode_job(void* arg)
+{
+	BLOCKJOB* job = (BLOCKJOB*)arg;
+	DECODETABLE* table;
+	BITSTREAM* bs;
+	double phase;
+
+	if (job->type == BLOCK_INTERLEAVED) {
+		job->result = get_interleaved(job);
+	} else if (job->type == BLOCK_CONTEXT) {
+		job->result = get_context(job);
+	} else if (job->type == BLOCK_TRANSFORM) {
+		job->result = get_transform(job);
+	} else if ((job->type == BLOCK_STORED) || (job->type == BLOCK_RUN)) {
+		job->result = get_uncoded(job);
+	} else {
+		job->result = FAILURE;
+		bs = bs_create_memory(job->input, job->input_size, READ);
+		if (bs == NULL) {
+			return;
+		}
+		phase = start_phase(job->stats);
+		if (get_description(bs, job->type == BLOCK_CANONICAL, &table) == FAILURE) {
+			bs_destroy(bs);
+			return;
+		}
+		end_phase(job->stats, PHASE_CODES, phase);
+		phase = start_phase(job->stats);
+		job->result = decode_chars(bs, table, job->output, job->output_size);
+		end_phase(job->stats, PHASE_CODING, phase);
+		release_decode_table(table);
+		bs_destroy(bs);
+	}
+	if ((job->result == SUCCESS) && job->checksum) {
+		job->result = check_checksum(job);
+	}
+	if ((job->result == SUCCESS) && (job->stats != NULL)) {
+		count_symbols(job->stats, job->output, job->output_size);
+		job->stats->blocks++;
+	}
+}
+
+// Block header has the size of the block and its payload and the type of
+// the block, payload is copied to the job input (checksum follows the
+// payload if the container has them)
+int read_block(BITSTREAM* bs, BLOCKJOB* job, CONTAINER* container, int* done)
+{
+	uint size;
+	uint payload_size;
+	uint type;
+
+	if (bs_read_bits(bs, BLOCK_SIZE_WIDTH, &size) == FAILURE) {
+		return FAILURE;
+	}
+	if (size == 0) {
+		*done = 1;
+		return SUCCESS;
+	}
+	if ((bs_read_bits(bs, BLOCK_SIZE_WIDTH, &payload_size) == FAILURE) || (bs_read_bits(bs, BLOCK_TYPE_WIDTH, &type) == FAILURE)) {
+		return FAILURE;
+	}
+	// Payload is checked before its buffer is allocated, legacy streams
+	// have no container but the same bound
+	if ((type > BLOCK_TRANSFORM) ||
+		((container != NULL) && (size > container->block_size)) ||
+		((payload_size > size) && (payload_size - size > PAYLOAD_OVERHEAD_BOUND))) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	if ((reserve_buffer(&job->input, &job->input_capacity, payload_size) == FAILURE) ||
+		(reserve_buffer(&job->output, &job->output_capacity, size) == FAILURE) ||
+		(bs_read_bytes(bs, job->input, payload_size) == FAILURE)) {
+		return FAILURE;
+	}
+	job->checksum = (container != NULL) && (container->flags & CONTAINER_CHECKSUM);
+	if (job->checksum && (bs_read_bits(bs, CHECKSUM_WIDTH, &job->crc) == FAILURE)) {
+		return FAILURE;
+	}
+	job->type = type;
+	job->input_size = payload_size;
+	job->output_size = size;
+	return SUCCESS;
+}
+
+// Reads the blocks for each job, decodes them in parallel and writes them
+// in order until the empty block
+int decode_blocks(BITSTREAM* bs, FILE* file_out, uint threads, int pipeline, CONTAINER* container, CODINGSTATS* stats)
+{
+	POOL* pool;
+	PIPELINE* stages;
+	BLOCKSTAGE reader;
+	BLOCKSTAGE writer;
+	BLOCKJOB* jobs;
+	BLOCKJOB* batch;
+	uint batch_size;
+	uint job_count;
+	uint count;
+	int result;
+
+	// Start the threads and prepare the jobs for them, pipelined decoding has
+	// a batch for each stage
+	pool = pool_create(threads);
+	if (pool == NULL) {
+		return FAILURE;
+	}
+	batch_size = (threads > 1) ? threads * BLOCKS_PER_THREAD : 1;
+	job_count = pipeline ? batch_size * PIPELINE_DEPTH : batch_size;
+	jobs = (BLOCKJOB*)calloc(job_count, sizeof(BLOCKJOB));
+	if (jobs == NULL) {
+		perror("Could not allocate memory for block jobs (out of memory)");
+		pool_destroy(pool);
+		return FAILURE;
+	}
+	if (measure_jobs(jobs, job_count, stats) == FAILURE) {
+		release_jobs(jobs, job_count);
+		pool_destroy(pool);
+		return FAILURE;
+	}
+	
+	// Blocks are read until the empty block, decoded in parallel and
+	// written in order
+	init_stage(&reader, stats);
+	reader.bs = bs;
+	reader.container = container;
+	init_stage(&writer, stats);
+	writer.file = file_out;
+	stages = pipeline_create(jobs, sizeof(BLOCKJOB), job_count, read_archive, &reader, write_decoded, &writer, pipeline);
+	if (stages == NULL) {
+		release_jobs(jobs, job_count);
+		pool_destroy(pool);
+		return FAILURE;
+	}
+	while ((batch = (BLOCKJOB*)pipeline_take(stages, batch_size, &count)) != NULL) {
+		pool_run(pool, decode_job, batch, sizeof(BLOCKJOB), count);
+		collect_jobs(batch, count, stats);
+		pipeline_give(stages, count);
+	}
+	result = pipeline_finish(stages);
+	collect_stage(&reader, stats);
+	collect_stage(&writer, stats);
+	if (stats != NULL) {
+		stats->output_bytes += reader.position;
+	}
+	
+	// Blocks must add up to the length of the file if it is known
+	if ((result == SUCCESS) && (container != NULL) && (container->flags & CONTAINER_LENGTH) && (reader.position != container->length)) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		result = FAILURE;
+	}
+	
+	// Releases allocated resources
+	release_jobs(jobs, job_count);
+	pool_destroy(pool);
+	return result;
+}
+
+// Jumps to the first block of the range and decodes the blocks until the end
+// of the range, writing only the characters in the range
+int decode_indexed(FILE* file_in, FILE* file_out, CONTAINER* container, uint64 start, uint64 length)
+{
+	BLOCKINDEX index;
+	BLOCKJOB job;
+	BITSTREAM* bs;
+	uint64 end = (length > ~0ULL - start) ? ~0ULL : start + length;
+	uint i;
+	int done = 0;
+	int result = SUCCESS;
+
+	if (get_index(file_in, &index) == FAILURE) {
+		return FAILURE;
+	}
+	i = find_block(&index, start);
+	if ((i == index.count) || (index.entries[i].start >= end)) {
+		release_index(&index);
+		return SUCCESS;
+	}
+	
+	// Blocks of the range follow each other, so the stream is read from
+	// the first block on
+	if (fseek(file_in, (long)index.entries[i].position, SEEK_SET)) {
+		perror("Could not seek the block");
+		release_index(&index);
+		return FAILURE;
+	}
+	bs = bs_create(file_in, READ);
+	if (bs == NULL) {
+		release_index(&index);
+		return FAILURE;
+	}
+	memset(&job, 0, sizeof(BLOCKJOB));
+	for ( ; (i < index.count) && (index.entries[i].start < end); i++) {
+		INDEXENTRY* entry = &index.entries[i];
+		uint64 from;
+		uint64 to;
+		if (read_block(bs, &job, container, &done) == FAILURE) {
+			result = FAILURE;
+			break;
+		}
+		if (done || (job.output_size != entry->size)) {
+			fprintf(stderr, "Archive is corrupted!\n");
+			result = FAILURE;
+			break;
+		}
+		decode_job(&job);
+		if (job.result == FAILURE) {
+			result = FAILURE;
+			break;
+		}
+		
+		// Write the part of the block which is in the range
+		from = (start > entry->start) ? start - entry->start : 0;
+		to = (end < entry->start + entry->size) ? end - entry->start : entry->size;
+		if (fwrite(job.output + from, 1, (size_t)(to - from), file_out) != (size_t)(to - from)) {
+			perror("Error occured when writing the file");
+			result = FAILURE;
+			break;
+		}
+	}
+	
+	// Releases allocated resources
+	free(job.input);
+	free(job.output);
+	bs_destroy(bs);
+	release_index(&index);
+	return result;
+}
+
+// Archive of blocks is decoded block by block, otherwise the whole file is
+// coded with single code description
+int decode_container(BITSTREAM* bs, FILE* file_out, uint threads, int pipeline, CONTAINER* container, CODINGSTATS* stats)
+{
+	DECODETABLE* table = NULL;
+	uchar* buffer;
+	double phase;
+	int result;
+
+	if (container->flags & CONTAINER_BLOCKS) {
+		return decode_blocks(bs, file_out, threads, pipeline, container, stats);
+	}
+	if (container->flags & CONTAINER_ADAPTIVE) {
+		return decode_adaptive(bs, file_out, 0, ~0ULL, stats);
+	}
+	if (stats != NULL) {
+		stats->blocks++;
+	}
+	
+	// Empty file has no codes
+	if (container->length == 0) {
+		return check_legacy_end(bs, container);
+	}
+	
+	// Tries to extract the codes from the stream (stored file has no codes)
+	phase = start_phase(stats);
+	if (!(container->flags & CONTAINER_STORED) && (get_description(bs, container->max_length > 0, &table) == FAILURE)) {
+		return FAILURE;
+	}
+	end_phase(stats, PHASE_CODES, phase);
+	
+	// Allocate memory for the decoded characters
+	buffer = (uchar*)malloc(DECODE_CHUNK_SIZE);
+	if (buffer == NULL) {
+		perror("Could not allocate memory for output buffer (out of memory)");
+		if (table != NULL) {
+			release_decode_table(table);
+		}
+		return FAILURE;
+	}
+	
+	// Tries to decode rest of the file and writes to the target file
+	result = write_chars(bs, table, container->length, buffer, file_out, stats);
+	if (result == SUCCESS) {
+		result = check_legacy_end(bs, container);
+	}
+	
+	// Releases allocated resources
+	free(buffer);
+	if (table != NULL) {
+		release_decode_table(table);
+	}
+	return result;
+}
+
+// Legacy archive has no magic number, so legacy stream of blocks would be
+// decoded as its first block unless the input is known to end there
+int check_legacy_end(BITSTREAM* bs, CONTAINER* container)
+{
+	if ((container->version == 0) && !bs_at_end(bs)) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// Characters are decoded chunk by chunk until the end mark, the part of each
+// chunk which is in the range is written
+int decode_adaptive(BITSTREAM* bs, FILE* file_out, uint64 start, uint64 length, CODINGSTATS* stats)
+{
+	ADAPTIVETREE* tree;
+	uchar* buffer;
+	uint64 position = 0;
+	uint64 end = (length > ~0ULL - start) ? ~0ULL : start + length;
+	ulong count;
+	double phase;
+	int done = 0;
+	int result = SUCCESS;
+
+	tree = (ADAPTIVETREE*)malloc(sizeof(ADAPTIVETREE));
+	buffer = (uchar*)malloc(DECODE_CHUNK_SIZE);
+	if ((tree == NULL) || (buffer == NULL)) {
+		perror("Could not allocate memory for adaptive tree (out of memory)");
+		free(tree);
+		free(buffer);
+		return FAILURE;
+	}
+	init_adaptive_tree(tree);
+
+	while (!done && (position < end)) {
+		uint64 from;
+		uint64 to;
+		phase = start_phase(stats);
+		if (decode_adaptive_chars(bs, tree, buffer, DECODE_CHUNK_SIZE, &count, &done) == FAILURE) {
+			result = FAILURE;
+			break;
+		}
+		end_phase(stats, PHASE_CODING, phase);
+		count_symbols(stats, buffer, count);
+		from = (start > position) ? start - position : 0;
+		to = (end - position < count) ? end - position : count;
+		phase = start_phase(stats);
+		if ((from < to) && (file_out != NULL) && (fwrite(buffer + from, 1, (size_t)(to - from), file_out) != (size_t)(to - from))) {
+			perror("Error occured when writing the file");
+			result = FAILURE;
+			break;
+		}
+		end_phase(stats, PHASE_IO, phase);
+		if ((stats != NULL) && (from < to)) {
+			stats->output_bytes += to - from;
+		}
+		position += count;
+	}
+	if ((result == SUCCESS) && (stats != NULL)) {
+		stats->blocks++;
+	}
+	free(tree);
+	free(buffer);
+	return result;
+}
+
+// Checksum is written most significant byte first, like the other fields
+// of the block
+void put_checksum(BLOCKJOB* job)
+{
+	uchar* end = job->output + job->output_size - CHECKSUM_SIZE;
+	double phase = start_phase(job->stats);
+	uint crc = crc32c(job->input, job->input_size);
+
+	end[0] = (uchar)(crc >> 24);
+	end[1] = (uchar)(crc >> 16);
+	end[2] = (uchar)(crc >> 8);
+	end[3] = (uchar)crc;
+	end_phase(job->stats, PHASE_CHECKSUM, phase);
+}
+
+// Mismatch means that either the payload or the checksum is damaged
+int check_checksum(BLOCKJOB* job)
+{
+	double phase = start_phase(job->stats);
+	uint crc = crc32c(job->output, job->output_size);
+
+	end_phase(job->stats, PHASE_CHECKSUM, phase);
+	if (crc != job->crc) {
+		fprintf(stderr, "Archive is corrupted (checksum of the block does not match)!\n");
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// Grows the buffer if it is smaller than requested
+int reserve_buffer(uchar** buffer, ulong* capacity, ulong size)
+{
+	uchar* memory;
+
+	if (size <= *capacity) {
+		return SUCCESS;
+	}
+	memory = (uchar*)realloc(*buffer, size);
+	if (memory == NULL) {
+		perror("Could not allocate memory for block buffer (out of memory)");
+		return FAILURE;
+	}
+	*buffer = memory;
+	*capacity = size;
+	return SUCCESS;
+}
+
+// Releases the buffers of all jobs and the job list itself
+void release_jobs(BLOCKJOB* jobs, uint count)
+{
+	uint i;
+	for (i = 0; i < count; i++) {
+		free(jobs[i].input);
+		free(jobs[i].output);
+		free(jobs[i].stats);
+	}
+	free(jobs);
+}
+
+// Every job has its own stats, so the threads do not share them
+int measure_jobs(BLOCKJOB* jobs, uint count, CODINGSTATS* stats)
+{
+	uint i;
+
+	if (stats == NULL) {
+		return SUCCESS;
+	}
+	for (i = 0; i < count; i++) {
+		jobs[i].stats = (CODINGSTATS*)calloc(1, sizeof(CODINGSTATS));
+		if (jobs[i].stats == NULL) {
+			perror("Could not allocate memory for block stats (out of memory)");
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+// Stats of the jobs are cleared for their next blocks
+void collect_jobs(BLOCKJOB* jobs, uint count, CODINGSTATS* stats)
+{
+	uint i;
+
+	if (stats == NULL) {
+		return;
+	}
+	for (i = 0; i < count; i++) {
+		merge_stats(stats, jobs[i].stats);
+		init_stats(jobs[i].stats);
+	}
+}
+
+// Input is read as it is, error is told apart from the end of the file
+int read_input(void* context, void* slot, int* done)
+{
+	BLOCKSTAGE* stage = (BLOCKSTAGE*)context;
+	BLOCKJOB* job = (BLOCKJOB*)slot;
+	double phase = start_phase(stage->stats);
+
+	job->input_size = fread(job->input, 1, stage->block_size, stage->file);
+	end_phase(stage->stats, PHASE_IO, phase);
+	if (job->input_size == 0) {
+		if (ferror(stage->file)) {
+			perror("Error occured when reading the file");
+			return FAILURE;
+		}
+		*done = 1;
+		return SUCCESS;
+	}
+	if (stage->stats != NULL) {
+		stage->stats->input_bytes += job->input_size;
+	}
+	return SUCCESS;
+}
+
+// Stream is flushed after every block, so the output follows the input
+int write_output(void* context, void* slot)
+{
+	BLOCKSTAGE* stage = (BLOCKSTAGE*)context;
+	BLOCKJOB* job = (BLOCKJOB*)slot;
+	double phase;
+
+	if (job->result == FAILURE) {
+		return FAILURE;
+	}
+	phase = start_phase(stage->stats);
+	if (((stage->index != NULL) && (add_index(stage->index, stage->position, (uint)job->input_size) == FAILURE)) ||
+		(bs_write_bytes(stage->bs, job->output, job->output_size) == FAILURE) ||
+		(bs_flush(stage->bs) == FAILURE)) {
+		return FAILURE;
+	}
+	end_phase(stage->stats, PHASE_IO, phase);
+	stage->position += job->output_size;
+	return SUCCESS;
+}
+
+// Characters of the blocks are counted for checking the length of the file
+int read_archive(void* context, void* slot, int* done)
+{
+	BLOCKSTAGE* stage = (BLOCKSTAGE*)context;
+	BLOCKJOB* job = (BLOCKJOB*)slot;
+	double phase = start_phase(stage->stats);
+
+	if (read_block(stage->bs, job, stage->container, done) == FAILURE) {
+		return FAILURE;
+	}
+	end_phase(stage->stats, PHASE_IO, phase);
+	if (!*done) {
+		stage->position += job->output_size;
+	}
+	return SUCCESS;
+}
+
+// Test of the archive has no file to write
+int write_decoded(void* context, void* slot)
+{
+	BLOCKSTAGE* stage = (BLOCKSTAGE*)context;
+	BLOCKJOB* job = (BLOCKJOB*)slot;
+	double phase;
+
+	if (job->result == FAILURE) {
+		return FAILURE;
+	}
+	phase = start_phase(stage->stats);
+	if ((stage->file != NULL) && (fwrite(job->output, 1, job->output_size, stage->file) != job->output_size)) {
+		perror("Error occured when writing the file");
+		return FAILURE;
+	}
+	end_phase(stage->stats, PHASE_IO, phase);
+	return SUCCESS;
+}
+
+// Stats point to the measurements inside the stage
+void init_stage(BLOCKSTAGE* stage, CODINGSTATS* stats)
+{
+	memset(stage, 0, sizeof(BLOCKSTAGE));
+	if (stats != NULL) {
+		stage->stats = &stage->measured;
+	}
+}
+
+// Stage is measured only when the coding is
+void collect_stage(BLOCKSTAGE* stage, CODINGSTATS* stats)
+{
+	if (stats != NULL) {
+		merge_stats(stats, stage->stats);
+	}
+}
+
+// Flushing the rest of the stream is counted as writing the file
+int finish_output(BITSTREAM* bs, CODINGSTATS* stats)
+{
+	double phase = start_phase(stats);
+	int result = bs_close(bs);
+
+	end_phase(stats, PHASE_IO, phase);
+	if (stats != NULL) {
+		stats->output_bytes += bs->file_bytes;
+	}
+	if (bs_destroy(bs) == FAILURE) {
+		result = FAILURE;
+	}
+	return result;
+}
+
+// Reads the tree which follows in the stream and builds the decoding table
+int get_decode_table(BITSTREAM* bs, DECODETABLE** table)
+{
+	TREE* tree;
+	CODETABLE codes;
+
+	if (get_tree(bs, &tree) == FAILURE) {
+		return FAILURE;
+	}
+	if (build_code_table(tree, &codes) == FAILURE) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		release_tree(tree);
+		return FAILURE;
+	}
+	release_tree(tree);
+	*table = build_decode_table(&codes);
+	return (*table == NULL) ? FAILURE : SUCCESS;
+}
+
+// Reads the code lengths which follow in the stream, gives the canonical
+// codes to the characters and builds the decoding table
+int get_canonical_table(BITSTREAM* bs, DECODETABLE** table)
+{
+	CODETABLE codes;
+
+	if ((get_code_lengths(bs, &codes) == FAILURE) || (build_canonical_codes(&codes) == FAILURE)) {
+		return FAILURE;
+	}
+	*table = build_decode_table(&codes);
+	return (*table == NULL) ? FAILURE : SUCCESS;
+}
+
+// Measures the file from the current position to the end and goes back
+int get_remaining(FILE* file_in, uint64* size)
+{
+	long start = ftell(file_in);
+	long end;
+
+	if ((start == -1L) || fseek(file_in, 0, SEEK_END)) {
+		return FAILURE;
+	}
+	end = ftell(file_in);
+	if ((end == -1L) || fseek(file_in, start, SEEK_SET)) {
+		return FAILURE;
+	}
+	*size = (uint64)(end - start);
+	return SUCCESS;
+}
+
+// Seekable file is coded as the whole file, pipe as the stream of blocks
+// unless the archive has to be the whole file (legacy archive has no
+// blocks and the sync points are only in the whole file)
+int encode_unmapped(FILE* file_in, FILE* file_out, CODINGOPTIONS* options)
+{
+	if ((ftell(file_in) != -1L) && (fseek(file_in, 0, SEEK_CUR) == 0)) {
+		return encode(file_in, file_out, options);
+	}
+	if (options->legacy || (options->sync_interval > 0)) {
+		return encode_spooled(file_in, file_out, options);
+	}
+	return encode_stream(file_in, file_out, options);
+}
+
+// Temporary file is removed when it is closed
+int encode_spooled(FILE* file_in, FILE* file_out, CODINGOPTIONS* options)
+{
+	FILE* spool;
+	uchar* buffer;
+	size_t count;
+	int result = FAILURE;
+
+	spool = tmpfile();
+	if (spool == NULL) {
+		perror("Could not create temporary file for the input");
+		return FAILURE;
+	}
+	buffer = (uchar*)malloc(ENCODE_CHUNK_SIZE);
+	if (buffer == NULL) {
+		perror("Could not allocate memory for input buffer (out of memory)");
+		fclose(spool);
+		return FAILURE;
+	}
+	while ((count = fread(buffer, 1, ENCODE_CHUNK_SIZE, file_in)) > 0) {
+		if (fwrite(buffer, 1, count, spool) != count) {
+			break;
+		}
+	}
+	free(buffer);
+	if (ferror(file_in)) {
+		perror("Error occured when reading the file");
+	} else if (ferror(spool) || fflush(spool)) {
+		perror("Could not write temporary file for the input");
+	} else {
+		rewind(spool);
+		result = encode(spool, file_out, options);
+	}
+	fclose(spool);
+	return result;
+}
+
+// Opens the files with stdio, missing path means the standard stream
+int code_paths(const char* path_in, const char* path_out, CODINGOPTIONS* options, int (*coder)(FILE*, FILE*, CODINGOPTIONS*))
+{
+	FILE* file_in = stdin;
+	FILE* file_out = stdout;
+	int result;
+
+	if ((path_in != NULL) && ((file_in = fopen(path_in, "rb")) == NULL)) {
+		perror("Could not open input file");
+		return FAILURE;
+	}
+	if ((path_out != NULL) && ((file_out = fopen(path_out, "wb")) == NULL)) {
+		perror("Could not open output file");
+		if (file_in != stdin) {
+			fclose(file_in);
+		}
+		return FAILURE;
+	}
+	result = coder(file_in, file_out, options);
+	if (file_in != stdin) {
+		fclose(file_in);
+	}
+	if (close_output(file_out) == FAILURE) {
+		result = FAILURE;
+	}
+	return result;
+}
+
+// Opens the file for writing and creates the stream for it
+BITSTREAM* open_output(const char* path_out, FILE** file_out)
+{
+	BITSTREAM* bs;
+
+	*file_out = stdout;
+	if ((path_out != NULL) && ((*file_out = fopen(path_out, "wb")) == NULL)) {
+		perror("Could not open output file");
+		return NULL;
+	}
+	bs = bs_create(*file_out, WRITE);
+	if (bs == NULL) {
+		close_output(*file_out);
+		*file_out = NULL;
+	}
+	return bs;
+}
+
+// Standard output is only flushed, other files are closed
+int close_output(FILE* file_out)
+{
+	if (file_out == NULL) {
+		return SUCCESS;
+	}
+	if (((file_out == stdout) ? fflush(file_out) : fclose(file_out)) == EOF) {
+		perror("Error occured when writing the file");
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// Decodes the characters chunk by chunk and writes them to the target file
+int write_chars(BITSTREAM* bs, DECODETABLE* table, uint64 size, uchar* buffer, FILE* file_out, CODINGSTATS* stats)
+{
+	return write_range(bs, table, size, 0, size, buffer, file_out, stats);
+}
+
+// Decodes the characters chunk by chunk until the end of the range, chunks
+// before the range are decoded but not written
+int write_range(BITSTREAM* bs, DECODETABLE* table, uint64 size, uint64 start, uint64 length, uchar* buffer, FILE* file_out, CODINGSTATS* stats)
+{
+	uint64 end = (length > ~0ULL - start) ? ~0ULL : start + length;
+	uint64 position = 0;
+	double phase;
+
+	if (end > size) {
+		end = size;
+	}
+	if (start >= end) {
+		return SUCCESS;
+	}
+	while (position < end) {
+		ulong count = (end - position < DECODE_CHUNK_SIZE) ? (ulong)(end - position) : DECODE_CHUNK_SIZE;
+		ulong from = (start > position) ? ((start - position < count) ? (ulong)(start - position) : count) : 0;
+		phase = start_phase(stats);
+		if (get_chars(bs, table, buffer, count) == FAILURE) {
+			return FAILURE;
+		}
+		end_phase(stats, PHASE_CODING, phase);
+		count_symbols(stats, buffer + from, count - from);
+		phase = start_phase(stats);
+		if ((file_out != NULL) && (fwrite(buffer + from, 1, count - from, file_out) != count - from)) {
+			perror("Error occured when writing the file");
+			return FAILURE;
+		}
+		end_phase(stats, PHASE_IO, phase);
+		if (stats != NULL) {
+			stats->output_bytes += count - from;
+		}
+		position += count;
+	}
 	return SUCCESS;
 }
@@ -10,12 +10,141 @@
 #ifndef __INCLUDES_COMPRESSION_H__
 #define __INCLUDES_COMPRESSION_H__
 
-// Encodes entire file_in contents and writes output to the file_out
+#ifndef __UCHAR_DEFINED__
+#define __UCHAR_DEFINED__
+typedef unsigned char uchar;
+#endif
+
+#ifndef __ULONG_DEFINED__
+#define __ULONG_DEFINED__
+typedef unsigned long ulong;
+#endif
+
+#ifndef __UINT_DEFINED__
+#define __UINT_DEFINED__
+typedef unsigned int uint;
+#endif
+
+#ifndef __UINT64_DEFINED__
+#define __UINT64_DEFINED__
+typedef unsigned long long uint64;
+#endif
+
+// Default number of characters in single block of the stream
+#define STREAM_BLOCK_SIZE 1048576
+
+// Largest header of the buffer archive in bytes (container header and the
+// tree, which is longer than the code lengths)
+#define BUFFER_HEADER_BOUND 512
+
+// Settings of the coding
+typedef struct CODINGOPTIONS
+{
+	ulong block_size;			// how many characters are in single block
+	uint threads;				// how many threads code the blocks
+	uint max_length;			// longest canonical code (0 for tree codes)
+	int legacy;					// set to write the format without container
+	int interleave;				// set to split each block to interleaved streams
+	uint order;					// order of the model (1 for code tables selected
+								// by the previous character)
+	int transform;				// set to code each block after Burrows-Wheeler,
+								// move-to-front and zero-run transforms
+	int checksum;				// set to add CRC32C of the characters to each block
+	int pipeline;				// set to read and write the blocks in their own
+								// threads while the blocks are coded
+	ulong sync_interval;		// how many characters are between the sync
+								// points of the whole file (0 for none)
+	struct CODINGSTATS* stats;	// where the coding is measured (NULL for none)
+} CODINGOPTIONS;
+
+// State of the buffer coding which keeps its tables between the calls
+// (single context must not be used by several threads at once)
+typedef struct CONTEXT CONTEXT;
+
+// Stream which the buffers may be coded to and from (see bitstream.h)
+struct BITSTREAM;
+
+// Sets the default coding settings
+void init_coding_options(CODINGOPTIONS* options);
+
+// Encodes entire file_in contents (from the current position, file must be
+// seekable) and writes output to the file_out
+// Returns error code
+int encode(FILE* file_in, FILE* file_out, CODINGOPTIONS* options);
+
+// Decodes contents of file_in and writes output to the file_out, both
+// container and legacy archives are recognized (without file_out the
+// archive is only decoded and the checksums of its blocks verified)
+// Returns error code
+int decode(FILE* file_in, FILE* file_out, CODINGOPTIONS* options);
+
+// Encodes the file at path_in to the file at path_out, files are mapped to
+// memory when possible, otherwise (and for NULL paths meaning stdin/stdout)
+// they are read and written like encode does
+// Returns error code
+int encode_file(const char* path_in, const char* path_out, CODINGOPTIONS* options);
+
+// Decodes the file at path_in to the file at path_out, files are mapped to
+// memory when possible (same as encode_file), parts of the file between its
+// sync points are decoded by several threads
+// Returns error code
+int decode_file(const char* path_in, const char* path_out, CODINGOPTIONS* options);
+
+// Encodes file_in block by block (reading it only once, so it may be a pipe)
+// and writes output to the file_out, blocks are coded as the options say
+// (pipelined coding reads and writes the blocks while others are coded)
+// Returns error code
+int encode_stream(FILE* file_in, FILE* file_out, CODINGOPTIONS* options);
+
+// Encodes file_in with adaptive codes (reading it only once, so it may be a
+// pipe), output is written after every chunk of the input
+// Returns error code
+int encode_adaptive(FILE* file_in, FILE* file_out, CODINGOPTIONS* options);
+
+// Decodes contents of file_in written by encode_stream and writes output to
+// the file_out, blocks are decoded by given number of threads (other
+// settings are read from the stream, input without container is the legacy
+// stream), file_out may be NULL the same way as for decode
+// Returns error code
+int decode_stream(FILE* file_in, FILE* file_out, CODINGOPTIONS* options);
+
+// Decodes only length characters starting from the character at start
+// (range is cut at the end of the file), archive of blocks is decoded from
+// the first block of the range when it has the block index (file_in must be
+// seekable then)
+// Returns error code
+int decode_range(FILE* file_in, FILE* file_out, uint64 start, uint64 length);
+
+// Creates the context for coding the buffers with given settings (only
+// max_length and legacy are used)
+CONTEXT* create_context(CODINGOPTIONS* options);
+
+// Releases the context and its tables
+void release_context(CONTEXT* context);
+
+// Returns the largest archive encode_buffer can write for size characters
+ulong compress_bound(ulong size);
+
+// Encodes in_size characters of the input to the output buffer, archive is
+// the same decode reads, out_size tells its size
+// Returns error code
+int encode_buffer(CONTEXT* context, uchar* in, ulong in_size, uchar* out, ulong out_capacity, ulong* out_size);
+
+// Decodes the archive in the input buffer to the output buffer, archive of
+// blocks is not accepted, out_size tells the size of the decoded data
+// Returns error code
+int decode_buffer(CONTEXT* context, uchar* in, ulong in_size, uchar* out, ulong out_capacity, ulong* out_size);
+
+// Encodes in_size characters the same way as encode_buffer, but writes the
+// archive straight to the stream (padded to the next byte), so no buffer of
+// its size is needed
 // Returns error code
-int encode(FILE* file_in, FILE* file_out);
+int encode_buffer_stream(CONTEXT* context, uchar* in, ulong in_size, struct BITSTREAM* bs);
 
-// Decodes contents of file_in and writes output to the file_out
+// Decodes the archive written by encode_buffer from the stream straight to
+// the file chunk by chunk, archive must take at most in_size bytes and hold
+// exactly out_size characters
 // Returns error code
-int decode(FILE* file_in, FILE* file_out);
+int decode_buffer_stream(struct BITSTREAM* bs, uint64 in_size, FILE* file_out, uint64 out_size);
 
 #endif // __INCLUDES_COMPRESSION_H__
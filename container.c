@@ -0,0 +1,83 @@
+/**
+ * container.c
+ *
+ * Implementation of the container header
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 16:40
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bitstream.h"
+#include "container.h"
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Looks at the first bits of the stream, empty stream is not a container
+int is_container(BITSTREAM* bs)
+{
+	uint value;
+	if (bs_peek_bits(bs, CONTAINER_MAGIC_WIDTH, &value) == FAILURE) {
+		return 0;
+	}
+	return value == CONTAINER_MAGIC;
+}
+
+// Writes the header fields in their order, 64-bit length is written in two
+// halves
+int put_container(BITSTREAM* bs, CONTAINER* container)
+{
+	if ((bs_write_bits(bs, CONTAINER_MAGIC, CONTAINER_MAGIC_WIDTH) == FAILURE) ||
+		(bs_write_bits(bs, container->version, CONTAINER_VERSION_WIDTH) == FAILURE) ||
+		(bs_write_bits(bs, container->flags, CONTAINER_FLAGS_WIDTH) == FAILURE) ||
+		(bs_write_bits(bs, (uint)(container->length >> 32), CONTAINER_LENGTH_WIDTH / 2) == FAILURE) ||
+		(bs_write_bits(bs, (uint)container->length, CONTAINER_LENGTH_WIDTH / 2) == FAILURE) ||
+		(bs_write_bits(bs, (uint)container->block_size, CONTAINER_BLOCK_SIZE_WIDTH) == FAILURE) ||
+		(bs_write_bits(bs, container->max_length, CONTAINER_CODE_LENGTH_WIDTH) == FAILURE)) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// Reads the header fields and refuses the archives of newer versions
+int get_container(BITSTREAM* bs, CONTAINER* container)
+{
+	uint magic;
+	uint high;
+	uint low;
+	uint block_size;
+
+	memset(container, 0, sizeof(CONTAINER));
+	if ((bs_read_bits(bs, CONTAINER_MAGIC_WIDTH, &magic) == FAILURE) ||
+		(bs_read_bits(bs, CONTAINER_VERSION_WIDTH, &container->version) == FAILURE) ||
+		(bs_read_bits(bs, CONTAINER_FLAGS_WIDTH, &container->flags) == FAILURE) ||
+		(bs_read_bits(bs, CONTAINER_LENGTH_WIDTH / 2, &high) == FAILURE) ||
+		(bs_read_bits(bs, CONTAINER_LENGTH_WIDTH / 2, &low) == FAILURE) ||
+		(bs_read_bits(bs, CONTAINER_BLOCK_SIZE_WIDTH, &block_size) == FAILURE) ||
+		(bs_read_bits(bs, CONTAINER_CODE_LENGTH_WIDTH, &container->max_length) == FAILURE)) {
+		return FAILURE;
+	}
+	if (magic != CONTAINER_MAGIC) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	if ((container->version > CONTAINER_VERSION) || (container->flags & ~CONTAINER_KNOWN_FLAGS)) {
+		fprintf(stderr, "Archive was created by newer version of the program!\n");
+		return FAILURE;
+	}
+	container->length = ((uint64)high << 32) | low;
+	container->block_size = block_size;
+	return SUCCESS;
+}
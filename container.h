@@ -0,0 +1,84 @@
+/**
+ * container.h
+ *
+ * Versioned header which starts the archives (legacy archives start with
+ * the 32-bit length of the file instead)
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 16:40
+ */
+
+#ifndef __INCLUDES_CONTAINER_H__
+#define __INCLUDES_CONTAINER_H__
+
+#ifndef __UINT_DEFINED__
+#define __UINT_DEFINED__
+typedef unsigned int uint;
+#endif
+
+#ifndef __ULONG_DEFINED__
+#define __ULONG_DEFINED__
+typedef unsigned long ulong;
+#endif
+
+#ifndef __UINT64_DEFINED__
+#define __UINT64_DEFINED__
+typedef unsigned long long uint64;
+#endif
+
+// First 32 bits of the archive ("HUF" and 0x1A, which stops text viewers)
+#define CONTAINER_MAGIC 0x4855461A
+
+// Latest version of the format which is written and understood
+#define CONTAINER_VERSION 1
+
+// Width of the fields in the container header
+#define CONTAINER_MAGIC_WIDTH 32
+#define CONTAINER_VERSION_WIDTH 8
+#define CONTAINER_FLAGS_WIDTH 8
+#define CONTAINER_LENGTH_WIDTH 64
+#define CONTAINER_BLOCK_SIZE_WIDTH 32
+#define CONTAINER_CODE_LENGTH_WIDTH 8
+
+// Size of the container header in bytes
+#define CONTAINER_HEADER_SIZE 19
+
+// Flags of the container
+enum CONTAINERFLAGS
+{
+	CONTAINER_BLOCKS = 0x01,	// file is coded in independent blocks
+	CONTAINER_LENGTH = 0x02,	// original length is known
+	CONTAINER_INDEX = 0x04,		// block index follows the blocks
+	CONTAINER_ADAPTIVE = 0x08,	// adaptive codes until the end mark
+	CONTAINER_CHECKSUM = 0x10,	// every block ends with CRC32C of its characters
+	CONTAINER_STORED = 0x20,	// characters follow the header as they are
+	CONTAINER_SYNC = 0x40,		// table of sync points follows the codes of the
+								// whole file (block size is their interval)
+};
+
+// All flags which this version understands
+#define CONTAINER_KNOWN_FLAGS (CONTAINER_BLOCKS | CONTAINER_LENGTH | CONTAINER_INDEX | CONTAINER_ADAPTIVE | CONTAINER_CHECKSUM | CONTAINER_STORED | CONTAINER_SYNC)
+
+// Describes how the archive is coded
+typedef struct CONTAINER
+{
+	uint version;				// version of the format
+	uint flags;					// combination of CONTAINERFLAGS
+	uint64 length;				// original length (if CONTAINER_LENGTH is set)
+	ulong block_size;			// maximum characters in block (0 for whole file
+								// without sync points)
+	uint max_length;			// longest canonical code (0 for tree codes)
+} CONTAINER;
+
+// Checks if the stream starts with the container header (nothing is read)
+int is_container(BITSTREAM* bs);
+
+// Writes the container header to the stream
+// Returns error code
+int put_container(BITSTREAM* bs, CONTAINER* container);
+
+// Reads and checks the container header from the stream
+// Returns error code
+int get_container(BITSTREAM* bs, CONTAINER* container);
+
+#endif // __INCLUDES_CONTAINER_H__
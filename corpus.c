@@ -0,0 +1,226 @@
+/**
+ * corpus.c
+ *
+ * Implementation of the test input generator
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 17:20
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "corpus.h"
+
+// Skew of the character distribution in Zipf input
+#define ZIPF_EXPONENT 1.1
+
+// Ratio of the consecutive character frequencies in the input of all
+// characters
+#define ALL_RATIO 0.96
+
+// Letters of the text-like input from the most common one
+#define TEXT_LETTERS "etaoinshrdlcumwfgypbvkjxqz"
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Returns next 64 random bits (xorshift64*)
+uint64 corpus_random(CORPUS* corpus);
+
+// Spreads the values over the sampling table by their weights, every value
+// gets at least one entry
+void corpus_table(CORPUS* corpus, double* weights, uint* values, uint count);
+
+// Makes up the words of the text-like input
+void corpus_words(CORPUS* corpus);
+
+// Puts the next word and the separator after it to the pending characters
+void corpus_next_word(CORPUS* corpus);
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Names are used in the file names and reports
+const char* corpus_name(uint kind)
+{
+	static const char* names[CORPUS_KINDS] = { "random", "zipf", "text", "single", "all256" };
+	return (kind < CORPUS_KINDS) ? names[kind] : "unknown";
+}
+
+// Tables of the generator depend only on the kind and the seed
+void init_corpus(CORPUS* corpus, uint kind, uint64 seed)
+{
+	double weights[CORPUS_WORDS];
+	uint values[CORPUS_WORDS];
+	uint i;
+
+	memset(corpus, 0, sizeof(CORPUS));
+	corpus->kind = kind;
+	corpus->state = (seed ^ ((uint64)kind << 56)) * 0x9E3779B97F4A7C15ULL;
+	if (corpus->state == 0) {
+		corpus->state = 1;
+	}
+
+	switch (kind) {
+		case CORPUS_ZIPF:
+			// Rank of the character is not its value, so the common
+			// characters are spread over the whole range
+			for (i = 0; i < 256; i++) {
+				weights[i] = 1.0 / pow(i + 1, ZIPF_EXPONENT);
+				values[i] = i;
+			}
+			for (i = 255; i > 0; i--) {
+				uint j = (uint)(corpus_random(corpus) % (i + 1));
+				uint value = values[i];
+				values[i] = values[j];
+				values[j] = value;
+			}
+			corpus_table(corpus, weights, values, 256);
+			break;
+		case CORPUS_ALL:
+			for (i = 0; i < 256; i++) {
+				weights[i] = pow(ALL_RATIO, i);
+				values[i] = i;
+			}
+			corpus_table(corpus, weights, values, 256);
+			break;
+		case CORPUS_TEXT:
+			// Words are chosen with Zipf distribution too
+			corpus_words(corpus);
+			for (i = 0; i < CORPUS_WORDS; i++) {
+				weights[i] = 1.0 / (i + 1);
+				values[i] = i;
+			}
+			corpus_table(corpus, weights, values, CORPUS_WORDS);
+			break;
+	}
+}
+
+// Every kind has its own loop, so the generator does not slow down the
+// measurements much when the input is generated on the fly
+void fill_corpus(CORPUS* corpus, uchar* block, ulong size)
+{
+	ulong i = 0;
+
+	switch (corpus->kind) {
+		case CORPUS_RANDOM:
+			for ( ; i + 8 <= size; i += 8) {
+				uint64 value = corpus_random(corpus);
+				memcpy(&block[i], &value, 8);
+			}
+			for ( ; i < size; i++) {
+				block[i] = (uchar)corpus_random(corpus);
+			}
+			break;
+		case CORPUS_ZIPF:
+		case CORPUS_ALL:
+			for ( ; i < size; i++) {
+				block[i] = (uchar)corpus->table[corpus_random(corpus) >> (64 - CORPUS_TABLE_BITS)];
+			}
+			break;
+		case CORPUS_TEXT:
+			while (i < size) {
+				uint count;
+				if (corpus->pending_next == corpus->pending_count) {
+					corpus_next_word(corpus);
+				}
+				count = corpus->pending_count - corpus->pending_next;
+				if (count > size - i) {
+					count = (uint)(size - i);
+				}
+				memcpy(&block[i], &corpus->pending[corpus->pending_next], count);
+				corpus->pending_next += count;
+				i += count;
+			}
+			break;
+		default:
+			memset(block, 'a', size);
+			break;
+	}
+}
+
+/**
+ * Private methods of the library
+ */
+
+// Generator is fast and good enough for the test data
+uint64 corpus_random(CORPUS* corpus)
+{
+	corpus->state ^= corpus->state >> 12;
+	corpus->state ^= corpus->state << 25;
+	corpus->state ^= corpus->state >> 27;
+	return corpus->state * 0x2545F4914F6CDD1DULL;
+}
+
+// Values get their share of the table rounded down and the entries which
+// are left over go to the first (most common) value
+void corpus_table(CORPUS* corpus, double* weights, uint* values, uint count)
+{
+	uint size = 1 << CORPUS_TABLE_BITS;
+	double total = 0;
+	uint next = 0;
+	uint i;
+
+	for (i = 0; i < count; i++) {
+		total += weights[i];
+	}
+	for (i = 0; i < count; i++) {
+		uint entries = 1 + (uint)(weights[i] / total * (size - count));
+		while ((entries-- > 0) && (next < size)) {
+			corpus->table[next++] = values[i];
+		}
+	}
+	while (next < size) {
+		corpus->table[next++] = values[0];
+	}
+}
+
+// Letters of the words follow roughly the frequencies of English, word
+// length is from 1 to CORPUS_MAX_WORD - 1
+void corpus_words(CORPUS* corpus)
+{
+	uint letter_count = (uint)strlen(TEXT_LETTERS);
+	uint i;
+	uint j;
+
+	for (i = 0; i < CORPUS_WORDS; i++) {
+		uint length = 1 + (uint)(corpus_random(corpus) % 4) + (uint)(corpus_random(corpus) % 4) + (uint)(corpus_random(corpus) % 8);
+		for (j = 0; j < length; j++) {
+			// Minimum of two random letters prefers the common ones
+			uint a = (uint)(corpus_random(corpus) % letter_count);
+			uint b = (uint)(corpus_random(corpus) % letter_count);
+			corpus->words[i][j] = (uchar)TEXT_LETTERS[(a < b) ? a : b];
+		}
+		corpus->word_length[i] = (uchar)length;
+	}
+}
+
+// Most words are followed by space, some end the sentence or the line
+void corpus_next_word(CORPUS* corpus)
+{
+	uint64 value = corpus_random(corpus);
+	uint word = corpus->table[value >> (64 - CORPUS_TABLE_BITS)];
+	uint length = corpus->word_length[word];
+
+	memcpy(corpus->pending, corpus->words[word], length);
+	switch (value % 16) {
+		case 0:
+			corpus->pending[length++] = '.';
+			corpus->pending[length++] = '\n';
+			break;
+		case 1:
+			corpus->pending[length++] = ',';
+			corpus->pending[length++] = ' ';
+			break;
+		default:
+			corpus->pending[length++] = ' ';
+			break;
+	}
+	corpus->pending_count = length;
+	corpus->pending_next = 0;
+}
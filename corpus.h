@@ -0,0 +1,80 @@
+/**
+ * corpus.h
+ *
+ * Reproducible test inputs of different shapes for measuring the coder
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 17:20
+ */
+
+#ifndef __INCLUDES_CORPUS_H__
+#define __INCLUDES_CORPUS_H__
+
+#ifndef __UCHAR_DEFINED__
+#define __UCHAR_DEFINED__
+typedef unsigned char uchar;
+#endif
+
+#ifndef __UINT_DEFINED__
+#define __UINT_DEFINED__
+typedef unsigned int uint;
+#endif
+
+#ifndef __ULONG_DEFINED__
+#define __ULONG_DEFINED__
+typedef unsigned long ulong;
+#endif
+
+#ifndef __UINT64_DEFINED__
+#define __UINT64_DEFINED__
+typedef unsigned long long uint64;
+#endif
+
+// Default seed of the generator
+#define CORPUS_SEED 20261016ULL
+
+// Number of entries in the sampling table (random values are looked up by
+// their highest bits)
+#define CORPUS_TABLE_BITS 16
+
+// Number of different words in the text-like input
+#define CORPUS_WORDS 1024
+
+// Longest word of the text-like input
+#define CORPUS_MAX_WORD 16
+
+// Shapes of the generated input
+enum CORPUSKIND
+{
+	CORPUS_RANDOM = 0,		// uniform random characters
+	CORPUS_ZIPF = 1,		// characters with Zipf distribution
+	CORPUS_TEXT = 2,		// words and punctuation resembling the text
+	CORPUS_SINGLE = 3,		// single character repeated
+	CORPUS_ALL = 4,			// every character, rare ones need long codes
+	CORPUS_KINDS = 5,		// number of kinds
+};
+
+// State of the generator, the input is produced piece by piece so it may
+// be larger than the memory
+typedef struct CORPUS
+{
+	uint kind;							// what is generated (CORPUSKIND)
+	uint64 state;						// state of the random generator
+	uint table[1 << CORPUS_TABLE_BITS];	// sampled value for each random prefix
+	uchar words[CORPUS_WORDS][CORPUS_MAX_WORD];	// words of the text-like input
+	uchar word_length[CORPUS_WORDS];	// length of each word
+	uchar pending[CORPUS_MAX_WORD + 2];	// rest of the current word
+	uint pending_count;					// how many characters are pending
+	uint pending_next;					// next pending character
+} CORPUS;
+
+// Returns the name of the kind
+const char* corpus_name(uint kind);
+
+// Prepares the generator of given kind, same seed gives the same input
+void init_corpus(CORPUS* corpus, uint kind, uint64 seed);
+
+// Fills the block with next size characters of the input
+void fill_corpus(CORPUS* corpus, uchar* block, ulong size);
+
+#endif // __INCLUDES_CORPUS_H__
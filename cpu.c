@@ -0,0 +1,81 @@
+/**
+ * cpu.c
+ *
+ * Implementation of the detection of the instruction set extensions
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 21:40
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+// Features the kernels are allowed to use (limited only for measuring)
+static uint allowed_features = CPU_ALL;
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Finds which features the processor has
+uint detect_features(void);
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Processor is checked on every call, the check only reads the flags which
+// are filled when the program starts
+uint cpu_features(void)
+{
+	return detect_features() & allowed_features;
+}
+
+// Limit is set before the coding starts, the threads only read it
+void cpu_allow(uint features)
+{
+	allowed_features = features & CPU_ALL;
+}
+
+// Names are the same as the compiler uses
+const char* cpu_feature_name(uint feature)
+{
+	switch (feature) {
+		case CPU_BMI2: return "bmi2";
+		case CPU_AVX2: return "avx2";
+	}
+	return "scalar";
+}
+
+/**
+ * Private methods of the library
+ */
+
+#if CPU_DISPATCH
+
+// Compiler has the flags of the processor
+uint detect_features(void)
+{
+	uint features = 0;
+
+	if (__builtin_cpu_supports("bmi2")) {
+		features |= CPU_BMI2;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		features |= CPU_AVX2;
+	}
+	return features;
+}
+
+#else
+
+// Other processors use only the scalar kernels
+uint detect_features(void)
+{
+	return 0;
+}
+
+#endif
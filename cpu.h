@@ -0,0 +1,50 @@
+/**
+ * cpu.h
+ *
+ * Detection of the instruction set extensions, so the coding kernels can be
+ * compiled for them and picked at runtime by single binary
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 21:40
+ */
+
+#ifndef __INCLUDES_CPU_H__
+#define __INCLUDES_CPU_H__
+
+#ifndef __UINT_DEFINED__
+#define __UINT_DEFINED__
+typedef unsigned int uint;
+#endif
+
+// Kernels for the extensions are compiled only for x86-64 with GCC or
+// clang, elsewhere every kernel is the scalar one
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CPU_DISPATCH 1
+#define TARGET_BMI2 __attribute__((target("bmi2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CPU_DISPATCH 0
+#define TARGET_BMI2
+#define TARGET_AVX2
+#endif
+
+// Extensions the kernels may use
+enum CPUFEATURE
+{
+	CPU_BMI2 = 0x01,			// shifts without flags (shlx/shrx) and bzhi for
+								// the bit buffers
+	CPU_AVX2 = 0x02,			// 256-bit integer vectors
+	CPU_ALL = 0x03,
+};
+
+// Returns the features of the processor which the kernels are allowed to use
+uint cpu_features(void);
+
+// Allows the kernels to use only the given features (all of them by
+// default), so the scalar kernels can be measured on the same processor
+void cpu_allow(uint features);
+
+// Returns the name of the feature for the reports
+const char* cpu_feature_name(uint feature);
+
+#endif // __INCLUDES_CPU_H__
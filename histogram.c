@@ -0,0 +1,280 @@
+/**
+ * histogram.c
+ *
+ * Implementation of the character frequency counting
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 14:20
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "tree.h"
+#include "pool.h"
+#include "histogram.h"
+#include "cpu.h"
+
+#if CPU_DISPATCH
+#include <immintrin.h>
+#endif
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+// Part of the block which is counted by single thread
+typedef struct HISTOGRAMJOB
+{
+	uchar* block;				// first character of the part
+	ulong size;					// how many characters are in the part
+	FREQTABLE freq_table;		// counts of this part only
+} HISTOGRAMJOB;
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Counts the characters of the job (run by the worker thread)
+void histogram_job(void* arg);
+
+// Counts the characters of the block to the lanes
+void count_lanes(uint lanes[HISTOGRAM_LANES][MAX_CHAR], uchar* block, ulong size);
+
+// Adds the lanes to the table one character at a time
+void merge_lanes_scalar(uint lanes[HISTOGRAM_LANES][MAX_CHAR], FREQTABLE freq_table);
+
+// Adds the lanes to the table four characters at a time
+void merge_lanes_avx2(uint lanes[HISTOGRAM_LANES][MAX_CHAR], FREQTABLE freq_table);
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Counts the characters of the block from scratch
+void histogram_block(uchar* block, ulong size, FREQTABLE freq_table)
+{
+	memset(freq_table, 0, sizeof(FREQTABLE));
+	histogram_add(block, size, freq_table);
+}
+
+// Counts the characters to the separate lanes and adds the lanes together
+// at the end of each slice, lanes are added with AVX2 when the processor
+// has it
+void histogram_add(uchar* block, ulong size, FREQTABLE freq_table)
+{
+	uint lanes[HISTOGRAM_LANES][MAX_CHAR];
+	uint features = cpu_features();
+	ulong slice;
+
+	while (size > 0) {
+		slice = (size < HISTOGRAM_MAX_SLICE) ? size : HISTOGRAM_MAX_SLICE;
+		memset(lanes, 0, sizeof(lanes));
+		count_lanes(lanes, block, slice);
+		if (features & CPU_AVX2) {
+			merge_lanes_avx2(lanes, freq_table);
+		} else {
+			merge_lanes_scalar(lanes, freq_table);
+		}
+		block += slice;
+		size -= slice;
+	}
+}
+
+// Splits the block between the threads and merges their counts
+void histogram_parallel(POOL* pool, uchar* block, ulong size, FREQTABLE freq_table)
+{
+	HISTOGRAMJOB* jobs;
+	uint count = (pool != NULL) ? pool->thread_count : 0;
+	uint i;
+	uint c;
+
+	// Small blocks are not worth splitting
+	if (count > size / HISTOGRAM_MIN_SLICE) {
+		count = (uint)(size / HISTOGRAM_MIN_SLICE);
+	}
+	if (count <= 1) {
+		histogram_add(block, size, freq_table);
+		return;
+	}
+	jobs = (HISTOGRAMJOB*)malloc(count * sizeof(HISTOGRAMJOB));
+	if (jobs == NULL) {
+		histogram_add(block, size, freq_table);
+		return;
+	}
+
+	// Every thread counts its own part of the block
+	for (i = 0; i < count; i++) {
+		jobs[i].block = &block[size / count * i];
+		jobs[i].size = (i == count - 1) ? size - size / count * i : size / count;
+	}
+	pool_run(pool, histogram_job, jobs, sizeof(HISTOGRAMJOB), count);
+
+	// Merge the partial counts
+	for (i = 0; i < count; i++) {
+		for (c = 0; c < MAX_CHAR; c++) {
+			freq_table[c] += jobs[i].freq_table[c];
+		}
+	}
+	free(jobs);
+}
+
+// Reads the file in large pieces and counts their characters
+int histogram_file(FILE* file_in, FREQTABLE freq_table, uint threads)
+{
+	POOL* pool;
+	uchar* buffer;
+	size_t size;
+
+	memset(freq_table, 0, sizeof(FREQTABLE));
+
+	// Allocate memory for the pieces of the file
+	buffer = (uchar*)malloc(HISTOGRAM_READ_SIZE);
+	if (buffer == NULL) {
+		perror("Could not allocate memory for input buffer (out of memory)");
+		return FAILURE;
+	}
+	pool = pool_create(threads);
+	if (pool == NULL) {
+		free(buffer);
+		return FAILURE;
+	}
+
+	while ((size = fread(buffer, 1, HISTOGRAM_READ_SIZE, file_in)) > 0) {
+		histogram_parallel(pool, buffer, size, freq_table);
+	}
+	pool_destroy(pool);
+	free(buffer);
+	if (ferror(file_in)) {
+		perror("Failed to read from input file");
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// Calculates the entropy of the characters (average number of bits needed
+// for each character by the ideal coder)
+double histogram_entropy(FREQTABLE freq_table, uint64* total)
+{
+	double entropy = 0;
+	uint c;
+
+	*total = 0;
+	for (c = 0; c < MAX_CHAR; c++) {
+		*total += freq_table[c];
+	}
+	for (c = 0; c < MAX_CHAR; c++) {
+		if (freq_table[c] > 0) {
+			double p = (double)freq_table[c] / (double)*total;
+			entropy -= p * log2(p);
+		}
+	}
+	return entropy;
+}
+
+// Writes the counts of all characters which occur in the file, followed by
+// the totals
+int print_histogram(FILE* file_in, FILE* file_out, uint threads)
+{
+	FREQTABLE freq_table;
+	uint64 total;
+	double entropy;
+	uint count = 0;
+	uint c;
+
+	if (histogram_file(file_in, freq_table, threads) == FAILURE) {
+		return FAILURE;
+	}
+	entropy = histogram_entropy(freq_table, &total);
+
+	fprintf(file_out, "char           count     share\n");
+	for (c = 0; c < MAX_CHAR; c++) {
+		if (freq_table[c] > 0) {
+			fprintf(file_out, "%3u '%c' %15llu %8.4f%%\n", c, isprint(c) ? c : '.', freq_table[c], 100.0 * freq_table[c] / total);
+			count++;
+		}
+	}
+	fprintf(file_out, "total: %llu characters, %u different\n", total, count);
+	fprintf(file_out, "entropy: %.4f bits per character (ideal size %.0f bytes, %.2f%% of original)\n",
+		entropy, entropy * total / 8, (total > 0) ? 100.0 * entropy / 8 : 0.0);
+	return SUCCESS;
+}
+
+/**
+ * Private methods of the library
+ */
+
+// Counts single part of the block
+void histogram_job(void* arg)
+{
+	HISTOGRAMJOB* job = (HISTOGRAMJOB*)arg;
+	histogram_block(job->block, job->size, job->freq_table);
+}
+
+// Takes 8 characters at once and spreads them over the lanes (loop is
+// unrolled for 4 lanes), byte order does not matter for counting
+void count_lanes(uint lanes[HISTOGRAM_LANES][MAX_CHAR], uchar* block, ulong size)
+{
+	ulong i;
+
+	for (i = 0; i + 8 <= size; i += 8) {
+		uint64 word;
+		memcpy(&word, &block[i], sizeof(word));
+		lanes[0][(uchar)word]++;
+		lanes[1][(uchar)(word >> 8)]++;
+		lanes[2][(uchar)(word >> 16)]++;
+		lanes[3][(uchar)(word >> 24)]++;
+		lanes[0][(uchar)(word >> 32)]++;
+		lanes[1][(uchar)(word >> 40)]++;
+		lanes[2][(uchar)(word >> 48)]++;
+		lanes[3][(uchar)(word >> 56)]++;
+	}
+	for ( ; i < size; i++) {
+		lanes[0][block[i]]++;
+	}
+}
+
+// Counts are added in 64 bits, so the table does not overflow
+void merge_lanes_scalar(uint lanes[HISTOGRAM_LANES][MAX_CHAR], FREQTABLE freq_table)
+{
+	uint c;
+
+	for (c = 0; c < MAX_CHAR; c++) {
+		freq_table[c] += (uint64)lanes[0][c] + lanes[1][c] + lanes[2][c] + lanes[3][c];
+	}
+}
+
+#if CPU_DISPATCH
+
+// Counts of each lane are widened to 64 bits before they are added
+TARGET_AVX2
+void merge_lanes_avx2(uint lanes[HISTOGRAM_LANES][MAX_CHAR], FREQTABLE freq_table)
+{
+	uint c;
+
+	for (c = 0; c < MAX_CHAR; c += 4) {
+		__m256i sum = _mm256_loadu_si256((__m256i*)&freq_table[c]);
+		sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm_loadu_si128((__m128i*)&lanes[0][c])));
+		sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm_loadu_si128((__m128i*)&lanes[1][c])));
+		sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm_loadu_si128((__m128i*)&lanes[2][c])));
+		sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm_loadu_si128((__m128i*)&lanes[3][c])));
+		_mm256_storeu_si256((__m256i*)&freq_table[c], sum);
+	}
+}
+
+#else
+
+// Other processors add the lanes one character at a time
+void merge_lanes_avx2(uint lanes[HISTOGRAM_LANES][MAX_CHAR], FREQTABLE freq_table)
+{
+	merge_lanes_scalar(lanes, freq_table);
+}
+
+#endif
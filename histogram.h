@@ -0,0 +1,50 @@
+/**
+ * histogram.h
+ *
+ * Counting character frequencies of large inputs
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 14:20
+ */
+
+#ifndef __INCLUDES_HISTOGRAM_H__
+#define __INCLUDES_HISTOGRAM_H__
+
+// How many separate counter tables are used while counting (consecutive
+// characters go to different tables, so repeated characters do not wait
+// for each other)
+#define HISTOGRAM_LANES 4
+
+// How many bytes are read from the file at once
+#define HISTOGRAM_READ_SIZE 4194304
+
+// Inputs smaller than this are not split between threads
+#define HISTOGRAM_MIN_SLICE 262144
+
+// How many characters are counted before lane counters are added to the
+// table (so the lane counters never overflow)
+#define HISTOGRAM_MAX_SLICE 1073741824
+
+// Counts the characters of the block (table is cleared first)
+void histogram_block(uchar* block, ulong size, FREQTABLE freq_table);
+
+// Adds the characters of the block to the counts already in the table
+void histogram_add(uchar* block, ulong size, FREQTABLE freq_table);
+
+// Adds the characters of the block to the table, block is split between the
+// threads of the pool
+void histogram_parallel(POOL* pool, uchar* block, ulong size, FREQTABLE freq_table);
+
+// Counts all characters of the file from its current position to the end,
+// using given number of threads
+int histogram_file(FILE* file_in, FREQTABLE freq_table, uint threads);
+
+// Finds the total count of the table and its entropy in bits per character
+double histogram_entropy(FREQTABLE freq_table, uint64* total);
+
+// Counts the characters of file_in and writes the histogram and entropy of
+// the file to file_out
+// Returns error code
+int print_histogram(FILE* file_in, FILE* file_out, uint threads);
+
+#endif // __INCLUDES_HISTOGRAM_H__
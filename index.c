@@ -0,0 +1,208 @@
+/**
+ * index.c
+ *
+ * Implementation of the block index
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 17:20
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitstream.h"
+#include "index.h"
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+// How many entries are allocated at first
+#define INDEX_INITIAL_CAPACITY 64
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Reads 64-bit value in two halves
+int get_position(BITSTREAM* bs, uint64* value);
+
+// Writes 64-bit value in two halves
+int put_position(BITSTREAM* bs, uint64 value);
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Index has no blocks at first
+void init_index(BLOCKINDEX* index)
+{
+	memset(index, 0, sizeof(BLOCKINDEX));
+}
+
+// Appends the block, its characters follow the characters of the previous
+// block
+int add_index(BLOCKINDEX* index, uint64 position, uint size)
+{
+	INDEXENTRY* entry;
+
+	// Double the list when it is full
+	if (index->count == index->capacity) {
+		uint capacity = (index->capacity > 0) ? 2 * index->capacity : INDEX_INITIAL_CAPACITY;
+		INDEXENTRY* entries = (INDEXENTRY*)realloc(index->entries, capacity * sizeof(INDEXENTRY));
+		if (entries == NULL) {
+			perror("Could not allocate memory for block index (out of memory)");
+			return FAILURE;
+		}
+		index->entries = entries;
+		index->capacity = capacity;
+	}
+	entry = &index->entries[index->count];
+	entry->position = position;
+	entry->start = 0;
+	if (index->count > 0) {
+		entry->start = entry[-1].start + entry[-1].size;
+	}
+	entry->size = size;
+	index->count++;
+	return SUCCESS;
+}
+
+// Each entry has the position of the block and its size, footer has the
+// number of entries, position of the index and the magic
+int put_index(BITSTREAM* bs, BLOCKINDEX* index, uint64 position)
+{
+	uint i;
+
+	for (i = 0; i < index->count; i++) {
+		if ((put_position(bs, index->entries[i].position) == FAILURE) ||
+			(bs_write_bits(bs, index->entries[i].size, INDEX_SIZE_WIDTH) == FAILURE)) {
+			return FAILURE;
+		}
+	}
+	if ((bs_write_bits(bs, index->count, INDEX_COUNT_WIDTH) == FAILURE) ||
+		(put_position(bs, position) == FAILURE) ||
+		(bs_write_bits(bs, INDEX_MAGIC, INDEX_MAGIC_WIDTH) == FAILURE)) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// Reads the footer from the end of the file, then jumps to the index and
+// reads the entries, the entries must fill the space before the footer
+int get_index(FILE* file_in, BLOCKINDEX* index)
+{
+	BITSTREAM* bs;
+	long end;
+	uint count;
+	uint64 position;
+	uint magic;
+	uint i;
+
+	init_index(index);
+	if (fseek(file_in, -INDEX_FOOTER_SIZE, SEEK_END) || ((end = ftell(file_in)) == -1L)) {
+		perror("Could not seek the block index");
+		return FAILURE;
+	}
+	bs = bs_create(file_in, READ);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	if ((bs_read_bits(bs, INDEX_COUNT_WIDTH, &count) == FAILURE) ||
+		(get_position(bs, &position) == FAILURE) ||
+		(bs_read_bits(bs, INDEX_MAGIC_WIDTH, &magic) == FAILURE)) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	bs_destroy(bs);
+	if ((magic != INDEX_MAGIC) || (position + (uint64)count * INDEX_ENTRY_SIZE != (uint64)end)) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	
+	// Read the entries of the index
+	if (fseek(file_in, (long)position, SEEK_SET)) {
+		perror("Could not seek the block index");
+		return FAILURE;
+	}
+	bs = bs_create(file_in, READ);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	for (i = 0; i < count; i++) {
+		uint64 block_position;
+		uint size;
+		if ((get_position(bs, &block_position) == FAILURE) ||
+			(bs_read_bits(bs, INDEX_SIZE_WIDTH, &size) == FAILURE) ||
+			(add_index(index, block_position, size) == FAILURE)) {
+			bs_destroy(bs);
+			release_index(index);
+			return FAILURE;
+		}
+		// Blocks follow each other before the index
+		if ((block_position >= position) || ((i > 0) && (block_position <= index->entries[i - 1].position))) {
+			fprintf(stderr, "Archive is corrupted!\n");
+			bs_destroy(bs);
+			release_index(index);
+			return FAILURE;
+		}
+	}
+	bs_destroy(bs);
+	return SUCCESS;
+}
+
+// Binary search for the last block which starts at the offset or before it
+uint find_block(BLOCKINDEX* index, uint64 offset)
+{
+	uint low = 0;
+	uint high = index->count;
+
+	while (low < high) {
+		uint middle = low + (high - low) / 2;
+		if (index->entries[middle].start + index->entries[middle].size <= offset) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+// Frees the entries
+void release_index(BLOCKINDEX* index)
+{
+	free(index->entries);
+	init_index(index);
+}
+
+/**
+ * Private methods of the library
+ */
+
+// High half is read first
+int get_position(BITSTREAM* bs, uint64* value)
+{
+	uint high;
+	uint low;
+	if ((bs_read_bits(bs, INDEX_POSITION_WIDTH / 2, &high) == FAILURE) ||
+		(bs_read_bits(bs, INDEX_POSITION_WIDTH / 2, &low) == FAILURE)) {
+		return FAILURE;
+	}
+	*value = ((uint64)high << 32) | low;
+	return SUCCESS;
+}
+
+// High half is written first
+int put_position(BITSTREAM* bs, uint64 value)
+{
+	if ((bs_write_bits(bs, (uint)(value >> 32), INDEX_POSITION_WIDTH / 2) == FAILURE) ||
+		(bs_write_bits(bs, (uint)value, INDEX_POSITION_WIDTH / 2) == FAILURE)) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
@@ -0,0 +1,76 @@
+/**
+ * index.h
+ *
+ * Index of the blocks which is written after the last block, so parts of
+ * the archive may be decoded without decoding the blocks before them
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 17:20
+ */
+
+#ifndef __INCLUDES_INDEX_H__
+#define __INCLUDES_INDEX_H__
+
+#ifndef __UINT_DEFINED__
+#define __UINT_DEFINED__
+typedef unsigned int uint;
+#endif
+
+#ifndef __UINT64_DEFINED__
+#define __UINT64_DEFINED__
+typedef unsigned long long uint64;
+#endif
+
+// Last 32 bits of the archive which has the index ("IDX" and 0x1A)
+#define INDEX_MAGIC 0x4944581A
+
+// Width of the fields of the index entries and the index footer
+#define INDEX_POSITION_WIDTH 64
+#define INDEX_SIZE_WIDTH 32
+#define INDEX_COUNT_WIDTH 32
+#define INDEX_MAGIC_WIDTH 32
+
+// Size of single entry and the footer in bytes
+#define INDEX_ENTRY_SIZE ((INDEX_POSITION_WIDTH + INDEX_SIZE_WIDTH) / 8)
+#define INDEX_FOOTER_SIZE ((INDEX_COUNT_WIDTH + INDEX_POSITION_WIDTH + INDEX_MAGIC_WIDTH) / 8)
+
+// Describes single block of the archive
+typedef struct INDEXENTRY
+{
+	uint64 position;			// where the block starts in the archive
+	uint64 start;				// where the characters of the block start in the file
+	uint size;					// how many characters are in the block
+} INDEXENTRY;
+
+// List of all blocks in the order of the file
+typedef struct BLOCKINDEX
+{
+	INDEXENTRY* entries;		// blocks of the archive
+	uint count;					// how many blocks are in the list
+	uint capacity;				// how many entries are allocated
+} BLOCKINDEX;
+
+// Prepares empty index
+void init_index(BLOCKINDEX* index);
+
+// Adds the block which starts at given position of the archive
+// Returns error code
+int add_index(BLOCKINDEX* index, uint64 position, uint size);
+
+// Writes the index which starts at given position of the archive, followed
+// by the footer which tells where the index is
+// Returns error code
+int put_index(BITSTREAM* bs, BLOCKINDEX* index, uint64 position);
+
+// Reads the index from the end of the archive (file must be seekable)
+// Returns error code
+int get_index(FILE* file_in, BLOCKINDEX* index);
+
+// Finds the block which contains the character at given position of the
+// file (count of the index if there is none)
+uint find_block(BLOCKINDEX* index, uint64 offset);
+
+// Releases the memory of the index
+void release_index(BLOCKINDEX* index);
+
+#endif // __INCLUDES_INDEX_H__
@@ -8,38 +8,300 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "compression.h"
+#include "bitstream.h"
+#include "tree.h"
+#include "table.h"
+#include "canonical.h"
+#include "pool.h"
+#include "histogram.h"
+#include "shared.h"
+#include "stats.h"
+#include "archive.h"
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
 
 // Possible to add other options later
 enum OPTIONS
 {
 	DECODE = 0x01,
+	STREAM = 0x02,
+	STATS = 0x04,
+	LEGACY = 0x08,
+	RANGE = 0x10,
+	INTERLEAVE = 0x20,
+	TRAIN = 0x40,
+	SHARED = 0x80,
+	ADAPTIVE = 0x100,
+	ORDER1 = 0x200,
+	HISTOGRAM = 0x400,
+	CHECKSUM = 0x800,
+	TEST = 0x1000,
+	PIPELINE = 0x2000,
+	THREADS = 0x4000,
+	SYNC = 0x8000,
+	ARCHIVE = 0x10000,
+	MEMBERS = 0x20000,
+	EXTRACT = 0x40000,
+	UNPACK = 0x80000,
+	TRANSFORM = 0x100000,
 };
 
 // Reads specified options from the command line argument
 int read_options(char* args);
 
+// Reads the whole argument as decimal number from min to max, returns
+// error code if it is something else
+int read_number(const char* arg, ulong min, ulong max, ulong* value);
+
+// Opens the file at the path or returns the standard stream if there is no
+// path
+FILE* open_file(const char* path, const char* mode, FILE* standard);
+
+// Builds the shared code table from the sample and writes it to the file
+int train_table(FILE* file_in, FILE* file_out, uint id, CODINGOPTIONS* options);
+
+// Loads the shared code table and codes the message with it
+int code_shared(FILE* file_in, FILE* file_out, const char* path, int decode);
+
+// Creates the archive of the files at the paths, lists the archive or
+// extracts its files (name is the file or the target directory)
+int code_archive(int options, char** paths, uint path_count, const char* path_in, const char* path_out, const char* name, CODINGOPTIONS* coding_options);
+
 // Main entry point of the application
 int main(int argc, char** argv)
 {
 	// Initialize options to none
 	int options = 0;
+	char* path_in = NULL;
+	char* path_out = NULL;
+	char* range = NULL;
+	char* table_path = NULL;
+	char* member = NULL;
+	uint table_id = 0;
+	uint path_count = 0;
+	uint64 range_start = 0;
+	uint64 range_length = ~0ULL;
+	FILE* file_in;
+	FILE* file_out;
+	int result;
+	int json = 0;
+	ulong number;
+	CODINGSTATS stats;
+	CODINGOPTIONS coding_options;
+	init_coding_options(&coding_options);
 
 	// Go through all extra command line parameters and read options
 	int i;
 	for (i = 1; i < argc; i++) {
+		// Number of threads is given as separate argument (-j N), only
+		// block stream can be coded in parallel so it selects stream too
+		// (unless the whole file is decoded from its sync points)
+		if ((strcmp(argv[i], "-j") == 0) && (i + 1 < argc)) {
+			if (read_number(argv[++i], 1, MAX_THREADS, &number) == FAILURE) {
+				fprintf(stderr, "Number of threads must be from 1 to %d!\n", MAX_THREADS);
+				return FAILURE;
+			}
+			coding_options.threads = (uint)number;
+			options |= THREADS;
+			continue;
+		}
+		// Whole file gets the sync point after every N KiB of characters
+		// (-y N), when decoding the points of the archive are used instead
+		// of the blocks to decode with several threads (interval must fit
+		// to the block size of the container)
+		if ((strcmp(argv[i], "-y") == 0) && (i + 1 < argc)) {
+			if (read_number(argv[++i], 1, 0xFFFFFFFFUL / 1024, &number) == FAILURE) {
+				fprintf(stderr, "Interval of the sync points must be from 1 to %lu KiB!\n", 0xFFFFFFFFUL / 1024);
+				return FAILURE;
+			}
+			coding_options.sync_interval = number * 1024;
+			options |= SYNC;
+			continue;
+		}
+		// Longest canonical code (-l N), zero selects the codes which store
+		// the whole tree
+		if ((strcmp(argv[i], "-l") == 0) && (i + 1 < argc)) {
+			if (read_number(argv[++i], 0, MAX_CANONICAL_LENGTH, &number) == FAILURE) {
+				fprintf(stderr, "Longest code must be from 0 to %d bits!\n", MAX_CANONICAL_LENGTH);
+				return FAILURE;
+			}
+			coding_options.max_length = (uint)number;
+			continue;
+		}
+		// Source and target files may be given instead of stdin/stdout
+		// (-i in -o out), then the files are mapped to memory if possible
+		if ((strcmp(argv[i], "-i") == 0) && (i + 1 < argc)) {
+			path_in = argv[++i];
+			continue;
+		}
+		if ((strcmp(argv[i], "-o") == 0) && (i + 1 < argc)) {
+			path_out = argv[++i];
+			continue;
+		}
+		// Only part of the file is decoded (-r START:LENGTH, without the
+		// length the rest of the file is decoded)
+		if ((strcmp(argv[i], "-r") == 0) && (i + 1 < argc)) {
+			range_start = strtoull(argv[++i], &range, 10);
+			if (*range == ':') {
+				range_length = strtoull(range + 1, NULL, 10);
+			}
+			options |= RANGE | DECODE;
+			continue;
+		}
+		// Code table is trained from the input (--train ID) and then used
+		// for coding small messages (-T table)
+		if ((strcmp(argv[i], "--train") == 0) && (i + 1 < argc)) {
+			table_id = (uint)strtoul(argv[++i], NULL, 10);
+			options |= TRAIN;
+			continue;
+		}
+		if ((strcmp(argv[i], "-T") == 0) && (i + 1 < argc)) {
+			table_path = argv[++i];
+			options |= SHARED;
+			continue;
+		}
+		// Phases of the coding are measured and reported to stderr
+		// (--stats or --stats=json)
+		if ((strcmp(argv[i], "--stats") == 0) || (strcmp(argv[i], "--stats=json") == 0)) {
+			json = (argv[i][7] == '=');
+			options |= STATS;
+			continue;
+		}
+		// Character histogram of the input is printed instead of coding it
+		if (strcmp(argv[i], "--histogram") == 0) {
+			options |= HISTOGRAM;
+			continue;
+		}
+		// Files and directories given without option are coded to single
+		// archive (--archive paths...), which is listed (--list) or decoded
+		// file by file (--extract NAME or --extract-all DIR), paths are
+		// moved to the beginning of argv
+		if (strcmp(argv[i], "--archive") == 0) {
+			options |= ARCHIVE;
+			continue;
+		}
+		if (strcmp(argv[i], "--list") == 0) {
+			options |= MEMBERS;
+			continue;
+		}
+		if ((strcmp(argv[i], "--extract") == 0) && (i + 1 < argc)) {
+			member = argv[++i];
+			options |= EXTRACT;
+			continue;
+		}
+		if ((strcmp(argv[i], "--extract-all") == 0) && (i + 1 < argc)) {
+			member = argv[++i];
+			options |= UNPACK;
+			continue;
+		}
+		if (argv[i][0] != '-') {
+			argv[path_count++] = argv[i];
+			continue;
+		}
 		options |= read_options(argv[i]);
 	}
 	
-	// If decoding option was specified, then decode from source to target
-	if (options & DECODE) {
-		return decode(stdin, stdout);
+	// Legacy format has no container header and codes with the tree, its
+	// stream of blocks could not be told apart from the whole file archive
+	if ((options & LEGACY) && (options & STREAM) && !(options & DECODE)) {
+		fprintf(stderr, "Legacy format can only be written as a whole file!\n");
+		return FAILURE;
+	}
+	if (options & LEGACY) {
+		coding_options.legacy = 1;
+		coding_options.max_length = 0;
+	}
+	// Blocks of several streams, context blocks, transformed blocks and
+	// checksums exist only in the container format
+	if ((options & INTERLEAVE) && !(options & LEGACY)) {
+		coding_options.interleave = 1;
+	}
+	if ((options & ORDER1) && !(options & LEGACY)) {
+		coding_options.order = 1;
+	}
+	if ((options & TRANSFORM) && !(options & LEGACY)) {
+		coding_options.transform = 1;
+	}
+	if ((options & CHECKSUM) && !(options & LEGACY)) {
+		coding_options.checksum = 1;
+	}
+	// Threads of the decoder are used by the whole file archive when it has
+	// the sync points, which only its header tells
+	if ((options & THREADS) && !(options & (SYNC | DECODE | LEGACY))) {
+		options |= STREAM;
+	}
+	// Blocks are read and written by their own threads
+	if (options & PIPELINE) {
+		coding_options.pipeline = 1;
+	}
+	if (options & STATS) {
+		init_stats(&stats);
+		coding_options.stats = &stats;
+	}
+	
+	// Print character histogram and entropy of the source, test the archive,
+	// decode part of it or code it in blocks (stream option reads/writes the
+	// file in independent blocks, so the source may be a pipe)
+	if (options & (ARCHIVE | MEMBERS | EXTRACT | UNPACK)) {
+		result = code_archive(options, argv, path_count, path_in, path_out, member, &coding_options);
+	} else if (options & (HISTOGRAM | STREAM | RANGE | TRAIN | SHARED | ADAPTIVE | TEST)) {
+		file_in = open_file(path_in, "rb", stdin);
+		if (file_in == NULL) {
+			return FAILURE;
+		}
+		// Test writes nothing
+		file_out = (options & TEST) ? NULL : open_file(path_out, "wb", stdout);
+		if (!(options & TEST) && (file_out == NULL)) {
+			fclose(file_in);
+			return FAILURE;
+		}
+		if (options & TEST) {
+			result = (options & STREAM) ? decode_stream(file_in, NULL, &coding_options) : decode(file_in, NULL, &coding_options);
+		} else if (options & HISTOGRAM) {
+			result = print_histogram(file_in, file_out, coding_options.threads);
+		} else if (options & TRAIN) {
+			result = train_table(file_in, file_out, table_id, &coding_options);
+		} else if (options & SHARED) {
+			result = code_shared(file_in, file_out, table_path, options & DECODE);
+		} else if (options & RANGE) {
+			result = decode_range(file_in, file_out, range_start, range_length);
+		} else if (options & DECODE) {
+			result = decode_stream(file_in, file_out, &coding_options);
+		} else if (options & ADAPTIVE) {
+			result = encode_adaptive(file_in, file_out, &coding_options);
+		} else {
+			result = encode_stream(file_in, file_out, &coding_options);
+		}
+		if (file_in != stdin) {
+			fclose(file_in);
+		}
+		if ((file_out != NULL) && (file_out != stdout) && (fclose(file_out) == EOF)) {
+			perror("Error occured when writing the file");
+			result = FAILURE;
+		}
+	} else if (options & DECODE) {
+		// If decoding option was specified, then decode from source to target
+		result = decode_file(path_in, path_out, &coding_options);
+	} else {
+		// Otherwise encode from source to target
+		result = encode_file(path_in, path_out, &coding_options);
 	}
 	
-	// Otherwise encode from source to target
-	return encode(stdin, stdout);
+	// Report goes to stderr, so it does not mix with the coded output
+	if ((options & STATS) && (result == SUCCESS)) {
+		print_stats(stderr, &stats, json);
+	}
+	return result;
 }
 
 // Reads options from the specified string
@@ -56,9 +318,133 @@ int read_options(char* args)
 		for (i = 0; i < length; i++) {
 			switch (args[i]) {
 				case 'd': options |= DECODE; break;
+				case 's': options |= STREAM; break;
+				case 'L': options |= LEGACY; break;
+				case 'x': options |= INTERLEAVE | STREAM; break;
+				case 'a': options |= ADAPTIVE; break;
+				case 'c': options |= ORDER1 | STREAM; break;
+				case 'b': options |= TRANSFORM | STREAM; break;
+				case 'k': options |= CHECKSUM | STREAM; break;
+				case 't': options |= TEST | DECODE; break;
+				case 'p': options |= PIPELINE | STREAM; break;
 			}
 		}
 	}
 	
 	return options;
 }
+
+// Sign and spaces which strtoul would skip are not accepted, too large
+// number is clamped by strtoul to ULONG_MAX
+int read_number(const char* arg, ulong min, ulong max, ulong* value)
+{
+	char* end;
+
+	if ((arg[0] < '0') || (arg[0] > '9')) {
+		return FAILURE;
+	}
+	*value = strtoul(arg, &end, 10);
+	if ((*end != '\0') || (*value < min) || (*value > max)) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// Sample is counted like the statistics
+int train_table(FILE* file_in, FILE* file_out, uint id, CODINGOPTIONS* options)
+{
+	FREQTABLE freq_table;
+	SHAREDTABLE shared;
+	int result;
+
+	if ((histogram_file(file_in, freq_table, options->threads) == FAILURE) ||
+		(train_shared_table(freq_table, id, options->max_length, &shared) == FAILURE)) {
+		return FAILURE;
+	}
+	result = save_shared_table(file_out, &shared);
+	release_shared_table(&shared);
+	return result;
+}
+
+// Table is loaded before the message is read
+int code_shared(FILE* file_in, FILE* file_out, const char* path, int decode)
+{
+	SHAREDTABLE shared;
+	FILE* file;
+	int result;
+
+	file = open_file(path, "rb", NULL);
+	if (file == NULL) {
+		return FAILURE;
+	}
+	result = load_shared_table(file, &shared);
+	fclose(file);
+	if (result == FAILURE) {
+		release_shared_table(&shared);
+		return FAILURE;
+	}
+	if (decode) {
+		result = decode_shared_file(file_in, file_out, &shared);
+	} else {
+		result = encode_shared_file(file_in, file_out, &shared);
+	}
+	release_shared_table(&shared);
+	return result;
+}
+
+// Archive is written to the output, other modes read it from the input
+// (which must be seekable)
+int code_archive(int options, char** paths, uint path_count, const char* path_in, const char* path_out, const char* name, CODINGOPTIONS* coding_options)
+{
+	FILE* file_in = stdin;
+	FILE* file_out = NULL;
+	int result;
+
+	if (!(options & ARCHIVE)) {
+		file_in = open_file(path_in, "rb", stdin);
+		if (file_in == NULL) {
+			return FAILURE;
+		}
+	}
+	if (!(options & UNPACK)) {
+		file_out = open_file(path_out, "wb", stdout);
+		if (file_out == NULL) {
+			if (file_in != stdin) {
+				fclose(file_in);
+			}
+			return FAILURE;
+		}
+	}
+	if (options & ARCHIVE) {
+		result = create_archive(paths, path_count, file_out, coding_options);
+	} else if (options & MEMBERS) {
+		result = list_archive(file_in, file_out);
+	} else if (options & EXTRACT) {
+		result = extract_member(file_in, name, file_out);
+	} else {
+		result = extract_archive(file_in, name);
+	}
+	if (file_in != stdin) {
+		fclose(file_in);
+	}
+	if ((file_out != NULL) && (file_out != stdout) && (fclose(file_out) == EOF)) {
+		perror("Error occured when writing the file");
+		result = FAILURE;
+	}
+	return result;
+}
+
+// Opens the file and reports if it fails
+FILE* open_file(const char* path, const char* mode, FILE* standard)
+{
+	FILE* file;
+
+	if (path == NULL) {
+		return standard;
+	}
+	file = fopen(path, mode);
+	if (file == NULL) {
+		perror("Could not open the file");
+	}
+	return file;
+}
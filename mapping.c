@@ -0,0 +1,154 @@
+/**
+ * mapping.c
+ *
+ * Implementation of the memory mapped files
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 16:00
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mapping.h"
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Maps the input file, pipes and devices cannot be mapped
+int map_input(const char* path, MAPPING* map)
+{
+	struct stat info;
+
+	memset(map, 0, sizeof(MAPPING));
+	if (path == NULL) {
+		return FAILURE;
+	}
+	map->fd = open(path, O_RDONLY);
+	if (map->fd == -1) {
+		return FAILURE;
+	}
+	if ((fstat(map->fd, &info) == -1) || !S_ISREG(info.st_mode)) {
+		close(map->fd);
+		return FAILURE;
+	}
+	map->size = (size_t)info.st_size;
+
+	// Empty file cannot be mapped, but it has nothing to read either
+	if (map->size == 0) {
+		return SUCCESS;
+	}
+	map->data = (uchar*)mmap(NULL, map->size, PROT_READ, MAP_SHARED, map->fd, 0);
+	if (map->data == MAP_FAILED) {
+		map->data = NULL;
+		close(map->fd);
+		return FAILURE;
+	}
+	// File is read from the beginning to the end only once
+	madvise(map->data, map->size, MADV_SEQUENTIAL);
+	return SUCCESS;
+}
+
+// Sets the size of the output file before mapping it
+int map_output(const char* path, size_t size, MAPPING* map)
+{
+	struct stat info;
+
+	memset(map, 0, sizeof(MAPPING));
+	if (path == NULL) {
+		return FAILURE;
+	}
+	map->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (map->fd == -1) {
+		return FAILURE;
+	}
+	if ((fstat(map->fd, &info) == -1) || !S_ISREG(info.st_mode) || (ftruncate(map->fd, (off_t)size) == -1)) {
+		close(map->fd);
+		return FAILURE;
+	}
+	map->size = size;
+	if (map->size == 0) {
+		return SUCCESS;
+	}
+	map->data = (uchar*)mmap(NULL, map->size, PROT_READ | PROT_WRITE, MAP_SHARED, map->fd, 0);
+	if (map->data == MAP_FAILED) {
+		map->data = NULL;
+		close(map->fd);
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// Releases the mapping, changes of the output are written by the system
+int unmap_file(MAPPING* map)
+{
+	int result = SUCCESS;
+
+	if ((map->data != NULL) && (munmap(map->data, map->size) == -1)) {
+		perror("Could not unmap the file");
+		result = FAILURE;
+	}
+	if (close(map->fd) == -1) {
+		perror("Could not close the file");
+		result = FAILURE;
+	}
+	map->data = NULL;
+	return result;
+}
+
+// Appending files ignore the offset of the write, pipes have no offset
+int is_positioned(int fd, uint64* offset)
+{
+	struct stat info;
+	off_t position;
+	int flags;
+
+	if ((fstat(fd, &info) == -1) || !S_ISREG(info.st_mode)) {
+		return 0;
+	}
+	flags = fcntl(fd, F_GETFL);
+	if ((flags == -1) || (flags & O_APPEND)) {
+		return 0;
+	}
+	position = lseek(fd, 0, SEEK_CUR);
+	if (position == -1) {
+		return 0;
+	}
+	*offset = (uint64)position;
+	return 1;
+}
+
+// Short writes are continued from where they stopped
+int write_at(int fd, const uchar* data, size_t size, uint64 offset)
+{
+	ssize_t count;
+
+	while (size > 0) {
+		count = pwrite(fd, data, size, (off_t)offset);
+		if (count == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("Error occured when writing the file");
+			return FAILURE;
+		}
+		data += count;
+		size -= (size_t)count;
+		offset += (uint64)count;
+	}
+	return SUCCESS;
+}
@@ -0,0 +1,56 @@
+/**
+ * mapping.h
+ *
+ * Mapping regular files to memory, so they can be coded without copying
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 16:00
+ */
+
+#ifndef __INCLUDES_MAPPING_H__
+#define __INCLUDES_MAPPING_H__
+
+#include <stddef.h>
+
+#ifndef __UCHAR_DEFINED__
+#define __UCHAR_DEFINED__
+typedef unsigned char uchar;
+#endif
+
+#ifndef __UINT64_DEFINED__
+#define __UINT64_DEFINED__
+typedef unsigned long long uint64;
+#endif
+
+// Describes the file which is mapped to the memory
+typedef struct MAPPING
+{
+	uchar* data;				// contents of the file (NULL for empty file)
+	size_t size;				// size of the file in bytes
+	int fd;						// descriptor of the open file
+} MAPPING;
+
+// Maps the whole file for reading, fails without message if the file is not
+// a regular file (so the caller may read it with stdio instead)
+// Returns error code
+int map_input(const char* path, MAPPING* map);
+
+// Creates the file of given size and maps it for writing, fails without
+// message if the file cannot be mapped
+// Returns error code
+int map_output(const char* path, size_t size, MAPPING* map);
+
+// Unmaps and closes the file
+// Returns error code
+int unmap_file(MAPPING* map);
+
+// Tells if the open file can be written with positioned writes (regular file
+// which is not opened for appending), offset is its current position
+int is_positioned(int fd, uint64* offset);
+
+// Writes all the data at the offset of the file without moving its position
+// (several threads may write their own parts of the file at once)
+// Returns error code
+int write_at(int fd, const uchar* data, size_t size, uint64 offset);
+
+#endif // __INCLUDES_MAPPING_H__
@@ -0,0 +1,313 @@
+/**
+ * model.c
+ *
+ * Implementation of the order-1 context models
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 19:30
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitstream.h"
+#include "tree.h"
+#include "table.h"
+#include "canonical.h"
+#include "model.h"
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Counts the characters which follow each character of the block
+void count_contexts(uchar* block, ulong size, uint (*counts)[MAX_CHAR]);
+
+// Moves every context to the cluster whose codes are the shortest for it,
+// returns 1 if any context was moved
+int assign_contexts(uint (*counts)[MAX_CHAR], uint* contexts, uint context_count, uint max_length, CONTEXTMODEL* model);
+
+// Adds the counts of the contexts to the tables of their clusters, clusters
+// which lost all their contexts are removed
+void sum_clusters(uint (*counts)[MAX_CHAR], uint* contexts, uint context_count, CONTEXTMODEL* model, FREQTABLE* freq_tables);
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Most frequent contexts start the clusters, then the contexts are moved
+// between the clusters until the codes of the clusters settle (k-means
+// where the distance is the length of the coded context)
+int build_context_model(uchar* block, ulong size, uint max_length, CONTEXTMODEL* model, uint64* bits)
+{
+	uint (*counts)[MAX_CHAR];
+	uint64 totals[MAX_CHAR];
+	FREQTABLE freq_tables[CONTEXT_MAX_TABLES];
+	uint contexts[MAX_CHAR];
+	uint context_count = 0;
+	uint iteration;
+	int changed;
+	uint c;
+	uint k;
+	uint s;
+
+	memset(model, 0, sizeof(CONTEXTMODEL));
+	model->table_count = 1;
+	counts = (uint (*)[MAX_CHAR])calloc(MAX_CHAR, sizeof(*counts));
+	if (counts == NULL) {
+		perror("Could not allocate memory for context counts (out of memory)");
+		return FAILURE;
+	}
+	count_contexts(block, size, counts);
+
+	// Collect the contexts which occur, most frequent first
+	for (c = 0; c < MAX_CHAR; c++) {
+		totals[c] = 0;
+		for (s = 0; s < MAX_CHAR; s++) {
+			totals[c] += counts[c][s];
+		}
+		if (totals[c] > 0) {
+			uint i = context_count++;
+			while ((i > 0) && (totals[contexts[i - 1]] < totals[c])) {
+				contexts[i] = contexts[i - 1];
+				i--;
+			}
+			contexts[i] = c;
+		}
+	}
+
+	// Each cluster starts with single context
+	if (context_count > 0) {
+		model->table_count = (context_count < CONTEXT_MAX_TABLES) ? context_count : CONTEXT_MAX_TABLES;
+	}
+	for (k = 0; k < model->table_count; k++) {
+		for (s = 0; s < MAX_CHAR; s++) {
+			freq_tables[k][s] = counts[contexts[k]][s];
+		}
+	}
+	for (iteration = 0; iteration < CONTEXT_ITERATIONS; iteration++) {
+		for (k = 0; k < model->table_count; k++) {
+			if (limit_code_lengths(freq_tables[k], max_length, &model->codes[k]) == FAILURE) {
+				free(counts);
+				return FAILURE;
+			}
+		}
+		changed = assign_contexts(counts, contexts, context_count, max_length, model);
+		sum_clusters(counts, contexts, context_count, model, freq_tables);
+		if (!changed) {
+			break;
+		}
+	}
+
+	// Build the final codes of the clusters
+	for (k = 0; k < model->table_count; k++) {
+		if ((limit_code_lengths(freq_tables[k], max_length, &model->codes[k]) == FAILURE) ||
+			((context_count > 0) && (build_canonical_codes(&model->codes[k]) == FAILURE))) {
+			free(counts);
+			return FAILURE;
+		}
+	}
+
+	// Contexts which do not occur take the table of the previous context, so
+	// they cost single bit in the description
+	for (c = 0; c < MAX_CHAR; c++) {
+		if (totals[c] == 0) {
+			model->map[c] = (c > 0) ? model->map[c - 1] : 0;
+		}
+	}
+
+	// Count the bits of all coded characters
+	*bits = context_model_bits(model);
+	for (c = 0; c < MAX_CHAR; c++) {
+		CODETABLE* codes = &model->codes[model->map[c]];
+		if ((totals[c] == 0) || codes->uniform) {
+			continue;
+		}
+		for (s = 0; s < MAX_CHAR; s++) {
+			*bits += (uint64)counts[c][s] * codes->length[s];
+		}
+	}
+	free(counts);
+	return SUCCESS;
+}
+
+// Table count is followed by the table of each context (single bit if it is
+// the same as for the previous context) and the code lengths of the tables
+uint64 context_model_bits(CONTEXTMODEL* model)
+{
+	uint64 bits = CONTEXT_TABLE_WIDTH;
+	uint previous = 0;
+	uint c;
+	uint k;
+
+	for (c = 0; c < MAX_CHAR; c++) {
+		bits += (model->map[c] == previous) ? 1 : 1 + CONTEXT_TABLE_WIDTH;
+		previous = model->map[c];
+	}
+	for (k = 0; k < model->table_count; k++) {
+		bits += code_lengths_bits(&model->codes[k]);
+	}
+	return bits;
+}
+
+// Writes the model in the order context_model_bits counts it
+int put_context_model(BITSTREAM* bs, CONTEXTMODEL* model)
+{
+	uint previous = 0;
+	uint c;
+	uint k;
+
+	if (bs_write_bits(bs, model->table_count - 1, CONTEXT_TABLE_WIDTH) == FAILURE) {
+		return FAILURE;
+	}
+	for (c = 0; c < MAX_CHAR; c++) {
+		if (model->map[c] == previous) {
+			if (bs_write_bit(bs, LOW) == FAILURE) {
+				return FAILURE;
+			}
+			continue;
+		}
+		if ((bs_write_bit(bs, HIGH) == FAILURE) || (bs_write_bits(bs, model->map[c], CONTEXT_TABLE_WIDTH) == FAILURE)) {
+			return FAILURE;
+		}
+		previous = model->map[c];
+	}
+	for (k = 0; k < model->table_count; k++) {
+		if (put_code_lengths(bs, &model->codes[k]) == FAILURE) {
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+// Every context must refer to one of the tables and every table must
+// describe complete code
+int get_context_model(BITSTREAM* bs, CONTEXTMODEL* model)
+{
+	enum BIT bit;
+	uint value;
+	uint previous = 0;
+	uint c;
+	uint k;
+
+	memset(model, 0, sizeof(CONTEXTMODEL));
+	if (bs_read_bits(bs, CONTEXT_TABLE_WIDTH, &value) == FAILURE) {
+		return FAILURE;
+	}
+	model->table_count = value + 1;
+	for (c = 0; c < MAX_CHAR; c++) {
+		if (bs_read_bit(bs, &bit) == FAILURE) {
+			return FAILURE;
+		}
+		if (bit == HIGH) {
+			if (bs_read_bits(bs, CONTEXT_TABLE_WIDTH, &previous) == FAILURE) {
+				return FAILURE;
+			}
+			if (previous >= model->table_count) {
+				fprintf(stderr, "Archive is corrupted!\n");
+				return FAILURE;
+			}
+		}
+		model->map[c] = (uchar)previous;
+	}
+	for (k = 0; k < model->table_count; k++) {
+		if ((get_code_lengths(bs, &model->codes[k]) == FAILURE) || (build_canonical_codes(&model->codes[k]) == FAILURE)) {
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+/**
+ * Private methods of the library
+ */
+
+// First character of the block follows the character 0
+void count_contexts(uchar* block, ulong size, uint (*counts)[MAX_CHAR])
+{
+	uint previous = 0;
+	ulong i;
+
+	for (i = 0; i < size; i++) {
+		counts[previous][block[i]]++;
+		previous = block[i];
+	}
+}
+
+// Character which has no code in the cluster is counted as the longest code
+// (it would take about that much after the codes are built again)
+int assign_contexts(uint (*counts)[MAX_CHAR], uint* contexts, uint context_count, uint max_length, CONTEXTMODEL* model)
+{
+	uint lengths[CONTEXT_MAX_TABLES][MAX_CHAR];
+	int changed = 0;
+	uint i;
+	uint k;
+	uint s;
+
+	for (k = 0; k < model->table_count; k++) {
+		for (s = 0; s < MAX_CHAR; s++) {
+			lengths[k][s] = (model->codes[k].length[s] > 0) ? model->codes[k].length[s] : max_length;
+		}
+	}
+	for (i = 0; i < context_count; i++) {
+		uint c = contexts[i];
+		uint best = model->map[c];
+		uint64 best_bits = ~0ULL;
+		for (k = 0; k < model->table_count; k++) {
+			uint64 bits = 0;
+			for (s = 0; s < MAX_CHAR; s++) {
+				bits += (uint64)counts[c][s] * lengths[k][s];
+			}
+			if (bits < best_bits) {
+				best_bits = bits;
+				best = k;
+			}
+		}
+		if (best != model->map[c]) {
+			model->map[c] = (uchar)best;
+			changed = 1;
+		}
+	}
+	return changed;
+}
+
+// Clusters which are left are numbered again in their old order
+void sum_clusters(uint (*counts)[MAX_CHAR], uint* contexts, uint context_count, CONTEXTMODEL* model, FREQTABLE* freq_tables)
+{
+	uint members[CONTEXT_MAX_TABLES];
+	uint number[CONTEXT_MAX_TABLES];
+	uint table_count = 0;
+	uint i;
+	uint k;
+	uint s;
+
+	memset(members, 0, sizeof(members));
+	for (i = 0; i < context_count; i++) {
+		members[model->map[contexts[i]]]++;
+	}
+	for (k = 0; k < model->table_count; k++) {
+		number[k] = table_count;
+		if (members[k] > 0) {
+			table_count++;
+		}
+	}
+	model->table_count = table_count;
+
+	memset(freq_tables, 0, CONTEXT_MAX_TABLES * sizeof(FREQTABLE));
+	for (i = 0; i < context_count; i++) {
+		uint c = contexts[i];
+		model->map[c] = (uchar)number[model->map[c]];
+		for (s = 0; s < MAX_CHAR; s++) {
+			freq_tables[model->map[c]][s] += counts[c][s];
+		}
+	}
+}
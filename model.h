@@ -0,0 +1,50 @@
+/**
+ * model.h
+ *
+ * Order-1 context models, every previous character selects one of the few
+ * code tables which are built for the clusters of similar contexts
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 19:30
+ */
+
+#ifndef __INCLUDES_MODEL_H__
+#define __INCLUDES_MODEL_H__
+
+// Maximum number of code tables in the model
+#define CONTEXT_MAX_TABLES 32
+
+// Width of the table number in the model description
+#define CONTEXT_TABLE_WIDTH 5
+
+// How many times the contexts are assigned to the clusters at most
+#define CONTEXT_ITERATIONS 8
+
+// Code table of each previous character (first character of the block
+// follows the character 0)
+typedef struct CONTEXTMODEL
+{
+	uint table_count;					// how many code tables are used
+	uchar map[MAX_CHAR];				// code table of each previous character
+	CODETABLE codes[CONTEXT_MAX_TABLES];	// canonical codes of the tables
+} CONTEXTMODEL;
+
+// Clusters the contexts of the block and builds canonical codes (no longer
+// than max_length) for each cluster, bits tells the size of the model
+// description and the coded characters
+// Returns error code
+int build_context_model(uchar* block, ulong size, uint max_length, CONTEXTMODEL* model, uint64* bits);
+
+// Returns how many bits put_context_model writes for the model
+uint64 context_model_bits(CONTEXTMODEL* model);
+
+// Writes the table count, the table of each context and code lengths of the
+// tables to the stream
+// Returns error code
+int put_context_model(BITSTREAM* bs, CONTEXTMODEL* model);
+
+// Reads the model from the stream and builds the codes of its tables
+// Returns error code
+int get_context_model(BITSTREAM* bs, CONTEXTMODEL* model);
+
+#endif // __INCLUDES_MODEL_H__
@@ -0,0 +1,336 @@
+/**
+ * pipeline.c
+ *
+ * Implementation of the pipeline of reading, coding and writing
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 21:05
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipeline.h"
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Main function of the reader thread
+void* pipeline_reader(void* arg);
+
+// Main function of the writer thread
+void* pipeline_writer(void* arg);
+
+// Fills the slot or marks it as the end
+// Returns non-zero if there is nothing more to read
+int read_slot(PIPELINE* pipeline, uint slot);
+
+// Writes the slot unless the pipeline has failed
+void write_slot(PIPELINE* pipeline, uint slot);
+
+// Marks the pipeline as failed
+void fail_pipeline(PIPELINE* pipeline);
+
+// Returns non-zero if any stage has failed
+int is_failed(PIPELINE* pipeline);
+
+// Prepares the index with no slots passed on
+void init_ring_index(RINGINDEX* index);
+
+// Passes the slots up to count to the next stage, waking it if it sleeps
+void post_ring_index(RINGINDEX* index, uint count);
+
+// Waits until the count of the index is no longer seen
+// Returns the new count
+uint wait_ring_index(RINGINDEX* index, uint seen);
+
+// Releases the lock of the index
+void release_ring_index(RINGINDEX* index);
+
+// Releases the indices and the memory of the pipeline
+void release_pipeline(PIPELINE* pipeline);
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Creates the pipeline and starts its threads
+PIPELINE* pipeline_create(void* slots, size_t slot_size, uint slot_count, READSTAGE read, void* reader, WRITESTAGE write, void* writer, int threaded)
+{
+	// Try to allocate memory for the pipeline
+	PIPELINE* pipeline = (PIPELINE*)malloc(sizeof(PIPELINE));
+	if (pipeline == NULL) {
+		perror("Could not allocate memory for pipeline (out of memory)");
+		return NULL;
+	}
+	memset(pipeline, 0, sizeof(PIPELINE));
+	pipeline->ends = (uchar*)calloc(slot_count, sizeof(uchar));
+	if (pipeline->ends == NULL) {
+		perror("Could not allocate memory for pipeline (out of memory)");
+		free(pipeline);
+		return NULL;
+	}
+	pipeline->slots = (char*)slots;
+	pipeline->slot_size = slot_size;
+	pipeline->slot_count = slot_count;
+	pipeline->read = read;
+	pipeline->reader = reader;
+	pipeline->write = write;
+	pipeline->writer = writer;
+
+	// Coder does all the work itself
+	if (!threaded) {
+		return pipeline;
+	}
+	init_ring_index(&pipeline->filled);
+	init_ring_index(&pipeline->coded);
+	init_ring_index(&pipeline->written);
+	pipeline->threaded = 1;
+
+	// Reader starts filling the ring at once
+	if (pthread_create(&pipeline->reader_thread, NULL, pipeline_reader, pipeline)) {
+		fprintf(stderr, "Could not start reader thread!\n");
+		release_pipeline(pipeline);
+		return NULL;
+	}
+	if (pthread_create(&pipeline->writer_thread, NULL, pipeline_writer, pipeline)) {
+		fprintf(stderr, "Could not start writer thread!\n");
+		// Reader stops at the next slot, the slots it has filled are
+		// returned to it until it marks the end
+		fail_pipeline(pipeline);
+		do {
+			wait_ring_index(&pipeline->filled, pipeline->code_count);
+			post_ring_index(&pipeline->written, ++pipeline->code_count);
+		} while (!pipeline->ends[(pipeline->code_count - 1) % slot_count]);
+		pthread_join(pipeline->reader_thread, NULL);
+		release_pipeline(pipeline);
+		return NULL;
+	}
+
+	return pipeline;
+}
+
+// Slots are taken until the batch is full or the end is reached
+void* pipeline_take(PIPELINE* pipeline, uint count, uint* taken)
+{
+	uint first = pipeline->code_position;
+
+	*taken = 0;
+	if (pipeline->at_end) {
+		return NULL;
+	}
+	// Batch does not wrap around the ring
+	if (count > pipeline->slot_count - first) {
+		count = pipeline->slot_count - first;
+	}
+	while (*taken < count) {
+		if (pipeline->threaded) {
+			// Slots already filled are taken without touching the lock
+			wait_ring_index(&pipeline->filled, pipeline->code_count);
+		} else {
+			read_slot(pipeline, pipeline->code_position);
+		}
+		if (pipeline->ends[pipeline->code_position]) {
+			pipeline->at_end = 1;
+			break;
+		}
+		pipeline->code_position = (pipeline->code_position + 1) % pipeline->slot_count;
+		pipeline->code_count++;
+		(*taken)++;
+	}
+	pipeline->held += *taken;
+
+	return (*taken > 0) ? pipeline->slots + first * pipeline->slot_size : NULL;
+}
+
+// Writer gets the slots in the same order the coder took them, the whole
+// batch is passed with single update of the index
+void pipeline_give(PIPELINE* pipeline, uint count)
+{
+	uint i;
+
+	pipeline->held -= count;
+	if (pipeline->threaded) {
+		post_ring_index(&pipeline->coded, pipeline->code_count - pipeline->held);
+		return;
+	}
+	for (i = 0; i < count; i++) {
+		write_slot(pipeline, pipeline->write_position);
+		pipeline->write_position = (pipeline->write_position + 1) % pipeline->slot_count;
+	}
+}
+
+// Coder which stops early fails the pipeline, the slots still in the ring
+// are passed on until the end so that the threads can quit
+int pipeline_finish(PIPELINE* pipeline)
+{
+	uint taken;
+	int result;
+
+	if (!pipeline->at_end) {
+		fail_pipeline(pipeline);
+	}
+	pipeline_give(pipeline, pipeline->held);
+	if (pipeline->threaded) {
+		while (pipeline_take(pipeline, pipeline->slot_count, &taken) != NULL) {
+			pipeline_give(pipeline, taken);
+		}
+		// End slot tells the writer to quit
+		post_ring_index(&pipeline->coded, pipeline->code_count + 1);
+		pthread_join(pipeline->reader_thread, NULL);
+		pthread_join(pipeline->writer_thread, NULL);
+	}
+	result = is_failed(pipeline) ? FAILURE : SUCCESS;
+	release_pipeline(pipeline);
+	return result;
+}
+
+/**
+ * Private methods of the library
+ */
+
+// Fills the free slots one by one until the end, the ring is full while the
+// writer is a whole ring behind
+void* pipeline_reader(void* arg)
+{
+	PIPELINE* pipeline = (PIPELINE*)arg;
+	uint filled = 0;
+	int done = 0;
+
+	while (!done) {
+		uint written = __atomic_load_n(&pipeline->written.count, __ATOMIC_ACQUIRE);
+		while (filled - written == pipeline->slot_count) {
+			written = wait_ring_index(&pipeline->written, written);
+		}
+		done = read_slot(pipeline, pipeline->read_position);
+		pipeline->read_position = (pipeline->read_position + 1) % pipeline->slot_count;
+		post_ring_index(&pipeline->filled, ++filled);
+	}
+
+	return NULL;
+}
+
+// Writes the coded slots one by one and returns them to the reader
+void* pipeline_writer(void* arg)
+{
+	PIPELINE* pipeline = (PIPELINE*)arg;
+	uint written = 0;
+
+	while (1) {
+		wait_ring_index(&pipeline->coded, written);
+		if (pipeline->ends[pipeline->write_position]) {
+			break;
+		}
+		write_slot(pipeline, pipeline->write_position);
+		pipeline->write_position = (pipeline->write_position + 1) % pipeline->slot_count;
+		post_ring_index(&pipeline->written, ++written);
+	}
+
+	return NULL;
+}
+
+// End mark is stored before the slot is passed on, so the next stage sees it
+int read_slot(PIPELINE* pipeline, uint slot)
+{
+	int done = 0;
+
+	if (is_failed(pipeline) ||
+		(pipeline->read(pipeline->reader, pipeline->slots + slot * pipeline->slot_size, &done) == FAILURE)) {
+		fail_pipeline(pipeline);
+		done = 1;
+	}
+	pipeline->ends[slot] = (uchar)done;
+	return done;
+}
+
+// Slots after the failure are only returned to the ring
+void write_slot(PIPELINE* pipeline, uint slot)
+{
+	if (!is_failed(pipeline) &&
+		(pipeline->write(pipeline->writer, pipeline->slots + slot * pipeline->slot_size) == FAILURE)) {
+		fail_pipeline(pipeline);
+	}
+}
+
+// Flag is shared by all the stages
+void fail_pipeline(PIPELINE* pipeline)
+{
+	__atomic_store_n(&pipeline->failed, 1, __ATOMIC_RELAXED);
+}
+
+// Flag is only a hint for skipping the work, the slots themselves are
+// passed through the indices
+int is_failed(PIPELINE* pipeline)
+{
+	return __atomic_load_n(&pipeline->failed, __ATOMIC_RELAXED);
+}
+
+// Lock and condition are used only by the stage which has to sleep
+void init_ring_index(RINGINDEX* index)
+{
+	index->count = 0;
+	index->sleeping = 0;
+	pthread_mutex_init(&index->lock, NULL);
+	pthread_cond_init(&index->changed, NULL);
+}
+
+// Count is published before the sleeping flag is read, and the sleeper sets
+// the flag before it reads the count, so one of them always sees the other
+// (both need the full fence of the sequentially consistent order)
+void post_ring_index(RINGINDEX* index, uint count)
+{
+	__atomic_store_n(&index->count, count, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&index->sleeping, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&index->lock);
+		pthread_cond_signal(&index->changed);
+		pthread_mutex_unlock(&index->lock);
+	}
+}
+
+// Lock is taken only when the count has not moved, the acquire load makes
+// the slots passed before the count visible to the waiting stage
+uint wait_ring_index(RINGINDEX* index, uint seen)
+{
+	uint count = __atomic_load_n(&index->count, __ATOMIC_ACQUIRE);
+
+	if (count != seen) {
+		return count;
+	}
+	pthread_mutex_lock(&index->lock);
+	__atomic_store_n(&index->sleeping, 1, __ATOMIC_SEQ_CST);
+	while ((count = __atomic_load_n(&index->count, __ATOMIC_SEQ_CST)) == seen) {
+		pthread_cond_wait(&index->changed, &index->lock);
+	}
+	__atomic_store_n(&index->sleeping, 0, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&index->lock);
+	return count;
+}
+
+// Nobody waits on the index any more
+void release_ring_index(RINGINDEX* index)
+{
+	pthread_cond_destroy(&index->changed);
+	pthread_mutex_destroy(&index->lock);
+}
+
+// Indices exist only in the threaded pipeline
+void release_pipeline(PIPELINE* pipeline)
+{
+	if (pipeline->threaded) {
+		release_ring_index(&pipeline->written);
+		release_ring_index(&pipeline->coded);
+		release_ring_index(&pipeline->filled);
+	}
+	free(pipeline->ends);
+	free(pipeline);
+}
@@ -0,0 +1,96 @@
+/**
+ * pipeline.h
+ *
+ * Ring of slots which are read, coded and written in order, reading and
+ * writing may run in their own threads so they overlap with the coding
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 21:05
+ */
+
+#ifndef __INCLUDES_PIPELINE_H__
+#define __INCLUDES_PIPELINE_H__
+
+#include <pthread.h>
+
+#ifndef __UCHAR_DEFINED__
+#define __UCHAR_DEFINED__
+typedef unsigned char uchar;
+#endif
+
+#ifndef __UINT_DEFINED__
+#define __UINT_DEFINED__
+typedef unsigned int uint;
+#endif
+
+// Batches of slots in the ring of the threaded pipeline (one for each stage)
+#define PIPELINE_DEPTH 3
+
+// Function which fills the slot, done is set instead when there is nothing
+// more to read
+// Returns error code
+typedef int (*READSTAGE)(void* context, void* slot, int* done);
+
+// Function which writes the coded slot
+// Returns error code
+typedef int (*WRITESTAGE)(void* context, void* slot);
+
+// Count of the slots which single stage has passed to the next one, only the
+// stage itself grows the count and only the next stage waits on it, so each
+// pair of stages shares a single-producer single-consumer queue
+typedef struct RINGINDEX
+{
+	uint count;					// slots passed on so far (atomic)
+	int sleeping;				// set while the next stage sleeps (atomic)
+	pthread_mutex_t lock;		// guards the sleep of the next stage
+	pthread_cond_t changed;		// wakes the next stage when count grows
+} RINGINDEX;
+
+// Ring of the slots, every slot belongs to single stage at a time and is
+// passed to the next stage by growing the index of the stage, a stage sleeps
+// only when the ring is empty (or full for the reader)
+typedef struct PIPELINE
+{
+	char* slots;				// ring of the slots
+	size_t slot_size;			// size of single slot
+	uint slot_count;			// how many slots are in the ring
+	uchar* ends;				// set for the slot which follows the last one
+	READSTAGE read;				// fills the slots
+	void* reader;				// context of the read function
+	WRITESTAGE write;			// writes the coded slots
+	void* writer;				// context of the write function
+	int threaded;				// set if reading and writing have own threads
+	pthread_t reader_thread;	// thread which reads the slots
+	pthread_t writer_thread;	// thread which writes the slots
+	RINGINDEX filled;			// slots filled by the reader
+	RINGINDEX coded;			// slots given by the coder
+	RINGINDEX written;			// slots written and returned to the reader
+	uint read_position;			// next slot to fill (reader only)
+	uint code_position;			// next slot to code (coder only)
+	uint code_count;			// slots taken so far (coder only)
+	uint write_position;		// next slot to write (writer only)
+	uint held;					// slots taken but not given by the coder
+	int at_end;					// set when the coder has seen the last slot
+	int failed;					// set when any stage fails (atomic)
+} PIPELINE;
+
+// Creates the pipeline for given slots, threaded pipeline starts reading them
+// at once, otherwise the slots are read and written by the coder when it
+// takes and gives them
+PIPELINE* pipeline_create(void* slots, size_t slot_size, uint slot_count, READSTAGE read, void* reader, WRITESTAGE write, void* writer, int threaded);
+
+// Waits for up to count filled slots in a row (they never wrap around the
+// ring), taken tells how many there are
+// Returns the first slot or NULL after the last one
+void* pipeline_take(PIPELINE* pipeline, uint count, uint* taken);
+
+// Passes count oldest taken slots to the writer
+void pipeline_give(PIPELINE* pipeline, uint count);
+
+// Waits until every slot is written, stops the threads and releases the
+// pipeline (failure of any stage makes the other stages skip the rest of the
+// slots)
+// Returns error code of the stages
+int pipeline_finish(PIPELINE* pipeline);
+
+#endif // __INCLUDES_PIPELINE_H__
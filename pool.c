@@ -0,0 +1,155 @@
+/**
+ * pool.c
+ *
+ * Implementation of the worker thread pool
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 13:10
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Main function of the worker thread
+void* pool_worker(void* arg);
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Creates the pool and starts its threads
+POOL* pool_create(uint thread_count)
+{
+	uint i;
+
+	// Try to allocate memory for the pool
+	POOL* pool = (POOL*)malloc(sizeof(POOL));
+	if (pool == NULL) {
+		perror("Could not allocate memory for thread pool (out of memory)");
+		return NULL;
+	}
+	memset(pool, 0, sizeof(POOL));
+
+	// Single thread does all the work itself
+	if (thread_count <= 1) {
+		return pool;
+	}
+	if (thread_count > MAX_THREADS) {
+		thread_count = MAX_THREADS;
+	}
+
+	// Allocate memory for the threads
+	pool->threads = (pthread_t*)malloc(thread_count * sizeof(pthread_t));
+	if (pool->threads == NULL) {
+		perror("Could not allocate memory for thread pool (out of memory)");
+		free(pool);
+		return NULL;
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work_ready, NULL);
+	pthread_cond_init(&pool->work_done, NULL);
+
+	// Start the threads, they wait until tasks are added
+	for (i = 0; i < thread_count; i++) {
+		if (pthread_create(&pool->threads[i], NULL, pool_worker, pool)) {
+			fprintf(stderr, "Could not start worker thread!\n");
+			break;
+		}
+		pool->thread_count++;
+	}
+	if (pool->thread_count == 0) {
+		pool_destroy(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+// Tells all the threads to quit, waits for them and releases the pool
+void pool_destroy(POOL* pool)
+{
+	uint i;
+
+	if (pool->threads != NULL) {
+		pthread_mutex_lock(&pool->lock);
+		pool->stop = 1;
+		pthread_cond_broadcast(&pool->work_ready);
+		pthread_mutex_unlock(&pool->lock);
+		for (i = 0; i < pool->thread_count; i++) {
+			pthread_join(pool->threads[i], NULL);
+		}
+		pthread_cond_destroy(&pool->work_done);
+		pthread_cond_destroy(&pool->work_ready);
+		pthread_mutex_destroy(&pool->lock);
+		free(pool->threads);
+	}
+	free(pool);
+}
+
+// Hands the tasks to the threads and waits until they are done
+void pool_run(POOL* pool, TASK task, void* args, size_t arg_size, uint count)
+{
+	uint i;
+
+	// Pool without threads runs the tasks in order
+	if (pool->threads == NULL) {
+		for (i = 0; i < count; i++) {
+			task((char*)args + i * arg_size);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->task = task;
+	pool->args = (char*)args;
+	pool->arg_size = arg_size;
+	pool->task_count = count;
+	pool->next_task = 0;
+	pool->done_count = 0;
+	pthread_cond_broadcast(&pool->work_ready);
+	while (pool->done_count < pool->task_count) {
+		pthread_cond_wait(&pool->work_done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Private methods of the library
+ */
+
+// Takes tasks one by one until the pool is stopped
+void* pool_worker(void* arg)
+{
+	POOL* pool = (POOL*)arg;
+
+	pthread_mutex_lock(&pool->lock);
+	while (1) {
+		uint task;
+		// Wait until there is something to do
+		while (!pool->stop && (pool->next_task >= pool->task_count)) {
+			pthread_cond_wait(&pool->work_ready, &pool->lock);
+		}
+		if (pool->stop) {
+			break;
+		}
+		// Run the task without holding the lock
+		task = pool->next_task++;
+		pthread_mutex_unlock(&pool->lock);
+		pool->task(pool->args + task * pool->arg_size);
+		pthread_mutex_lock(&pool->lock);
+		// Last finished task wakes up the caller
+		if (++pool->done_count == pool->task_count) {
+			pthread_cond_signal(&pool->work_done);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
@@ -0,0 +1,54 @@
+/**
+ * pool.h
+ *
+ * Pool of worker threads for running independent tasks in parallel
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 13:10
+ */
+
+#ifndef __INCLUDES_POOL_H__
+#define __INCLUDES_POOL_H__
+
+#include <pthread.h>
+
+#ifndef __UINT_DEFINED__
+#define __UINT_DEFINED__
+typedef unsigned int uint;
+#endif
+
+// Maximum number of threads in the pool
+#define MAX_THREADS 256
+
+// Function which does single task, argument points to the task data
+typedef void (*TASK)(void* arg);
+
+// Structure to hold worker threads and the tasks they are working on
+typedef struct POOL
+{
+	pthread_t* threads;			// worker threads (NULL if pool has no threads)
+	uint thread_count;			// how many worker threads are running
+	pthread_mutex_t lock;		// guards all the fields below
+	pthread_cond_t work_ready;	// signaled when new tasks are added
+	pthread_cond_t work_done;	// signaled when all tasks are done
+	TASK task;					// function which is run for every task
+	char* args;					// data of the tasks
+	size_t arg_size;			// size of data of single task
+	uint task_count;			// how many tasks were added
+	uint next_task;				// which task is taken next
+	uint done_count;			// how many tasks are done
+	int stop;					// set when the threads should quit
+} POOL;
+
+// Creates new pool with given number of threads (pool of single thread runs
+// tasks on the calling thread)
+POOL* pool_create(uint thread_count);
+
+// Stops all the threads and releases the pool
+void pool_destroy(POOL* pool);
+
+// Runs the task for each of count elements of the args array and waits until
+// all of them are done
+void pool_run(POOL* pool, TASK task, void* args, size_t arg_size, uint count);
+
+#endif // __INCLUDES_POOL_H__
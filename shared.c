@@ -0,0 +1,336 @@
+/**
+ * shared.c
+ *
+ * Implementation of the shared code tables
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 18:10
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitstream.h"
+#include "tree.h"
+#include "table.h"
+#include "canonical.h"
+#include "shared.h"
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+// How many bytes are read from the file at once
+#define SHARED_READ_SIZE 65536
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Reads the rest of the file to the memory
+int read_whole_file(FILE* file_in, uchar** data, ulong* size);
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Characters missing from the sample count as if they occurred once, so
+// the codes stay complete
+int train_shared_table(FREQTABLE freq_table, uint id, uint max_length, SHAREDTABLE* shared)
+{
+	FREQTABLE smoothed;
+	uint i;
+
+	memset(shared, 0, sizeof(SHAREDTABLE));
+	shared->id = id;
+	for (i = 0; i < MAX_CHAR; i++) {
+		smoothed[i] = freq_table[i] + 1;
+	}
+	if ((max_length == 0) || (max_length > MAX_CANONICAL_LENGTH)) {
+		max_length = MAX_CANONICAL_LENGTH;
+	}
+	if ((limit_code_lengths(smoothed, max_length, &shared->codes) == FAILURE) ||
+		(build_canonical_codes(&shared->codes) == FAILURE)) {
+		return FAILURE;
+	}
+	shared->table = build_decode_table(&shared->codes);
+	return (shared->table == NULL) ? FAILURE : SUCCESS;
+}
+
+// Table file has the magic, version and identifier followed by the code
+// lengths
+int save_shared_table(FILE* file_out, SHAREDTABLE* shared)
+{
+	BITSTREAM* bs = bs_create(file_out, WRITE);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	if ((bs_write_bits(bs, SHARED_MAGIC, SHARED_MAGIC_WIDTH) == FAILURE) ||
+		(bs_write_bits(bs, SHARED_VERSION, SHARED_VERSION_WIDTH) == FAILURE) ||
+		(put_shared_table(bs, shared) == FAILURE)) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	return bs_destroy(bs);
+}
+
+// Magic and version are checked before the table itself
+int load_shared_table(FILE* file_in, SHAREDTABLE* shared)
+{
+	uint magic;
+	uint version;
+	int result;
+	BITSTREAM* bs;
+
+	memset(shared, 0, sizeof(SHAREDTABLE));
+	bs = bs_create(file_in, READ);
+	if (bs == NULL) {
+		return FAILURE;
+	}
+	if ((bs_read_bits(bs, SHARED_MAGIC_WIDTH, &magic) == FAILURE) ||
+		(bs_read_bits(bs, SHARED_VERSION_WIDTH, &version) == FAILURE)) {
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	if (magic != SHARED_MAGIC) {
+		fprintf(stderr, "Code table is corrupted!\n");
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	if (version > SHARED_VERSION) {
+		fprintf(stderr, "Code table was created by newer version of the program!\n");
+		bs_destroy(bs);
+		return FAILURE;
+	}
+	result = get_shared_table(bs, shared);
+	bs_destroy(bs);
+	return result;
+}
+
+// Same fields follow the version in the table file
+int put_shared_table(BITSTREAM* bs, SHAREDTABLE* shared)
+{
+	if ((bs_write_bits(bs, shared->id, SHARED_ID_WIDTH) == FAILURE) ||
+		(put_code_lengths(bs, &shared->codes) == FAILURE)) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// Decoding table is built here once, so decoding the messages only reads it
+int get_shared_table(BITSTREAM* bs, SHAREDTABLE* shared)
+{
+	memset(shared, 0, sizeof(SHAREDTABLE));
+	if ((bs_read_bits(bs, SHARED_ID_WIDTH, &shared->id) == FAILURE) ||
+		(get_code_lengths(bs, &shared->codes) == FAILURE) ||
+		(build_canonical_codes(&shared->codes) == FAILURE)) {
+		return FAILURE;
+	}
+	shared->table = build_decode_table(&shared->codes);
+	return (shared->table == NULL) ? FAILURE : SUCCESS;
+}
+
+// Codes are part of the structure itself
+void release_shared_table(SHAREDTABLE* shared)
+{
+	if (shared->table != NULL) {
+		release_decode_table(shared->table);
+		shared->table = NULL;
+	}
+}
+
+// Every character may have the longest code of the table
+ulong shared_bound(SHAREDTABLE* shared, ulong size)
+{
+	uint longest = 0;
+	uint i;
+
+	for (i = 0; i < MAX_CHAR; i++) {
+		if (shared->codes.length[i] > longest) {
+			longest = shared->codes.length[i];
+		}
+	}
+	return SHARED_HEADER_SIZE + (ulong)(((uint64)size * longest + UCHAR_WIDTH - 1) / UCHAR_WIDTH);
+}
+
+// Codes of the characters are added up without coding them
+ulong shared_size(SHAREDTABLE* shared, FREQTABLE freq_table)
+{
+	uint64 bits = 0;
+	uint i;
+
+	for (i = 0; i < MAX_CHAR; i++) {
+		bits += (uint64)freq_table[i] * shared->codes.length[i];
+	}
+	return SHARED_HEADER_SIZE + (ulong)((bits + UCHAR_WIDTH - 1) / UCHAR_WIDTH);
+}
+
+// Identifier is the first field of the message
+int get_shared_id(uchar* in, ulong in_size, uint* id)
+{
+	if (in_size < SHARED_HEADER_SIZE) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	*id = ((uint)in[0] << 24) | ((uint)in[1] << 16) | ((uint)in[2] << 8) | (uint)in[3];
+	return SUCCESS;
+}
+
+// Message has the identifier of the table and its length followed by the
+// codes
+int encode_shared(SHAREDTABLE* shared, uchar* in, ulong in_size, uchar* out, ulong out_capacity, ulong* out_size)
+{
+	BITSTREAM bs;
+	uint64 bits = 0;
+	ulong i;
+
+	if ((uint64)in_size >> SHARED_LENGTH_WIDTH) {
+		fprintf(stderr, "Message is too large for the shared table!\n");
+		return FAILURE;
+	}
+	for (i = 0; i < in_size; i++) {
+		bits += shared->codes.length[in[i]];
+	}
+	*out_size = SHARED_HEADER_SIZE + (ulong)((bits + UCHAR_WIDTH - 1) / UCHAR_WIDTH);
+	if (*out_size > out_capacity) {
+		fprintf(stderr, "Output buffer is too small!\n");
+		return FAILURE;
+	}
+
+	bs_init_memory(&bs, out, out_capacity, WRITE);
+	if ((bs_write_bits(&bs, shared->id, SHARED_ID_WIDTH) == FAILURE) ||
+		(bs_write_bits(&bs, (uint)in_size, SHARED_LENGTH_WIDTH) == FAILURE) ||
+		(encode_chars(&bs, &shared->codes, in, in_size) == FAILURE)) {
+		return FAILURE;
+	}
+	return bs_close(&bs);
+}
+
+// Table is only read, so the same table may decode in several threads
+int decode_shared(SHAREDTABLE* shared, uchar* in, ulong in_size, uchar* out, ulong out_capacity, ulong* out_size)
+{
+	BITSTREAM bs;
+	uint id;
+	uint length;
+
+	bs_init_memory(&bs, in, in_size, READ);
+	if ((bs_read_bits(&bs, SHARED_ID_WIDTH, &id) == FAILURE) ||
+		(bs_read_bits(&bs, SHARED_LENGTH_WIDTH, &length) == FAILURE)) {
+		return FAILURE;
+	}
+	if (id != shared->id) {
+		fprintf(stderr, "Archive was coded with another code table!\n");
+		return FAILURE;
+	}
+	if (length > out_capacity) {
+		fprintf(stderr, "Output buffer is too small!\n");
+		return FAILURE;
+	}
+	*out_size = length;
+	return decode_chars(&bs, shared->table, out, length);
+}
+
+// Whole input is needed for the length in the header
+int encode_shared_file(FILE* file_in, FILE* file_out, SHAREDTABLE* shared)
+{
+	uchar* input;
+	uchar* output;
+	ulong size;
+	ulong capacity;
+	int result;
+
+	if (read_whole_file(file_in, &input, &size) == FAILURE) {
+		return FAILURE;
+	}
+	capacity = shared_bound(shared, size);
+	output = (uchar*)malloc(capacity);
+	if (output == NULL) {
+		perror("Could not allocate memory for output buffer (out of memory)");
+		free(input);
+		return FAILURE;
+	}
+	result = encode_shared(shared, input, size, output, capacity, &size);
+	if ((result == SUCCESS) && (fwrite(output, 1, size, file_out) != size)) {
+		perror("Error occured when writing the file");
+		result = FAILURE;
+	}
+	free(output);
+	free(input);
+	return result;
+}
+
+// Length of the output is taken from the message header
+int decode_shared_file(FILE* file_in, FILE* file_out, SHAREDTABLE* shared)
+{
+	uchar* input;
+	uchar* output;
+	ulong size;
+	ulong length;
+	int result;
+
+	if (read_whole_file(file_in, &input, &size) == FAILURE) {
+		return FAILURE;
+	}
+	if (size < SHARED_HEADER_SIZE) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		free(input);
+		return FAILURE;
+	}
+	length = ((ulong)input[4] << 24) | ((ulong)input[5] << 16) | ((ulong)input[6] << 8) | (ulong)input[7];
+	output = (uchar*)malloc(length + 1);
+	if (output == NULL) {
+		perror("Could not allocate memory for output buffer (out of memory)");
+		free(input);
+		return FAILURE;
+	}
+	result = decode_shared(shared, input, size, output, length, &length);
+	if ((result == SUCCESS) && (fwrite(output, 1, length, file_out) != length)) {
+		perror("Error occured when writing the file");
+		result = FAILURE;
+	}
+	free(output);
+	free(input);
+	return result;
+}
+
+/**
+ * Private methods of the library
+ */
+
+// Buffer grows twice whenever it gets full
+int read_whole_file(FILE* file_in, uchar** data, ulong* size)
+{
+	ulong capacity = SHARED_READ_SIZE;
+	size_t count;
+
+	*size = 0;
+	*data = (uchar*)malloc(capacity);
+	if (*data == NULL) {
+		perror("Could not allocate memory for input buffer (out of memory)");
+		return FAILURE;
+	}
+	while ((count = fread(*data + *size, 1, capacity - *size, file_in)) > 0) {
+		*size += count;
+		if (*size == capacity) {
+			uchar* memory = (uchar*)realloc(*data, capacity * 2);
+			if (memory == NULL) {
+				perror("Could not allocate memory for input buffer (out of memory)");
+				free(*data);
+				return FAILURE;
+			}
+			*data = memory;
+			capacity *= 2;
+		}
+	}
+	if (ferror(file_in)) {
+		perror("Error occured when reading the file");
+		free(*data);
+		return FAILURE;
+	}
+	return SUCCESS;
+}
@@ -0,0 +1,92 @@
+/**
+ * shared.h
+ *
+ * Code tables trained from sample data and shared by many small messages,
+ * messages store only the identifier of the table instead of the codes
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 18:10
+ */
+
+#ifndef __INCLUDES_SHARED_H__
+#define __INCLUDES_SHARED_H__
+
+// First 32 bits of the table file ("HUT" and 0x1A)
+#define SHARED_MAGIC 0x4855541A
+
+// Latest version of the table file
+#define SHARED_VERSION 1
+
+// Width of the fields in the table file
+#define SHARED_MAGIC_WIDTH 32
+#define SHARED_VERSION_WIDTH 8
+#define SHARED_ID_WIDTH 32
+
+// Width of the length field of the message
+#define SHARED_LENGTH_WIDTH 32
+
+// Size of the message header in bytes (table identifier and length)
+#define SHARED_HEADER_SIZE ((SHARED_ID_WIDTH + SHARED_LENGTH_WIDTH) / 8)
+
+// Code table loaded once and used by any number of threads (nothing in it
+// changes after loading)
+typedef struct SHAREDTABLE
+{
+	uint id;					// identifier written to the messages
+	CODETABLE codes;			// code of every character
+	DECODETABLE* table;			// decoding table built when loaded
+} SHAREDTABLE;
+
+// Builds the table from the character counts of the sample, every character
+// gets a code even if the sample does not have it
+// Returns error code
+int train_shared_table(FREQTABLE freq_table, uint id, uint max_length, SHAREDTABLE* shared);
+
+// Writes the table to the file
+// Returns error code
+int save_shared_table(FILE* file_out, SHAREDTABLE* shared);
+
+// Reads the table from the file and builds its decoding table
+// Returns error code
+int load_shared_table(FILE* file_in, SHAREDTABLE* shared);
+
+// Writes the identifier and the code lengths of the table to the stream
+// Returns error code
+int put_shared_table(BITSTREAM* bs, SHAREDTABLE* shared);
+
+// Reads the table written by put_shared_table and builds its decoding table
+// Returns error code
+int get_shared_table(BITSTREAM* bs, SHAREDTABLE* shared);
+
+// Releases the decoding table
+void release_shared_table(SHAREDTABLE* shared);
+
+// Returns the largest message encode_shared can write for size characters
+ulong shared_bound(SHAREDTABLE* shared, ulong size);
+
+// Returns the size of the message of the characters counted to freq_table
+ulong shared_size(SHAREDTABLE* shared, FREQTABLE freq_table);
+
+// Reads the table identifier of the message, so the right table can be
+// chosen before decoding
+// Returns error code
+int get_shared_id(uchar* in, ulong in_size, uint* id);
+
+// Encodes the buffer with the table (nothing is allocated)
+// Returns error code
+int encode_shared(SHAREDTABLE* shared, uchar* in, ulong in_size, uchar* out, ulong out_capacity, ulong* out_size);
+
+// Decodes the message which was encoded with the same table (nothing is
+// allocated)
+// Returns error code
+int decode_shared(SHAREDTABLE* shared, uchar* in, ulong in_size, uchar* out, ulong out_capacity, ulong* out_size);
+
+// Reads the whole file_in and writes it to file_out as single message
+// Returns error code
+int encode_shared_file(FILE* file_in, FILE* file_out, SHAREDTABLE* shared);
+
+// Reads the message from file_in and writes it decoded to file_out
+// Returns error code
+int decode_shared_file(FILE* file_in, FILE* file_out, SHAREDTABLE* shared);
+
+#endif // __INCLUDES_SHARED_H__
@@ -0,0 +1,163 @@
+/**
+ * stats.c
+ *
+ * Implementation of the coding measurements
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 20:10
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tree.h"
+#include "pool.h"
+#include "histogram.h"
+#include "stats.h"
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Everything is counted from zero
+void init_stats(CODINGSTATS* stats)
+{
+	memset(stats, 0, sizeof(CODINGSTATS));
+}
+
+// Monotonic clock is not affected by the changes of the system time
+double stats_clock(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Clock is not read when nothing is measured
+double start_phase(CODINGSTATS* stats)
+{
+	return (stats != NULL) ? stats_clock() : 0;
+}
+
+// Time is added only when the phase was started with stats
+void end_phase(CODINGSTATS* stats, uint phase, double start)
+{
+	if (stats != NULL) {
+		stats->seconds[phase] += stats_clock() - start;
+	}
+}
+
+// Total time is added the same way as the time of the phase
+void end_total(CODINGSTATS* stats, double start)
+{
+	if (stats != NULL) {
+		stats->total_seconds += stats_clock() - start;
+	}
+}
+
+// Characters are counted from their frequencies
+void add_symbols(CODINGSTATS* stats, FREQTABLE freq_table, uint64 code_bits)
+{
+	uint c;
+
+	if (stats == NULL) {
+		return;
+	}
+	for (c = 0; c < MAX_CHAR; c++) {
+		stats->freq_table[c] += freq_table[c];
+		stats->symbols += freq_table[c];
+	}
+	stats->code_bits += code_bits;
+}
+
+// Decoded characters are counted again, the counting is timed as the
+// histogram phase
+void count_symbols(CODINGSTATS* stats, uchar* block, ulong size)
+{
+	double start;
+
+	if (stats == NULL) {
+		return;
+	}
+	start = stats_clock();
+	histogram_add(block, size, stats->freq_table);
+	stats->symbols += size;
+	end_phase(stats, PHASE_HISTOGRAM, start);
+}
+
+// Every field is added up, including the times
+void merge_stats(CODINGSTATS* stats, CODINGSTATS* part)
+{
+	uint i;
+
+	for (i = 0; i < PHASE_COUNT; i++) {
+		stats->seconds[i] += part->seconds[i];
+	}
+	stats->total_seconds += part->total_seconds;
+	stats->input_bytes += part->input_bytes;
+	stats->output_bytes += part->output_bytes;
+	stats->symbols += part->symbols;
+	stats->blocks += part->blocks;
+	stats->code_bits += part->code_bits;
+	for (i = 0; i < MAX_CHAR; i++) {
+		stats->freq_table[i] += part->freq_table[i];
+	}
+}
+
+// Speeds are counted from the characters, average code length is known only
+// for encoding
+void print_stats(FILE* file_out, CODINGSTATS* stats, int json)
+{
+	static const char* phase_names[PHASE_COUNT] = { "histogram", "codes", "header", "coding", "io", "checksum", "transform" };
+	double speed = (stats->total_seconds > 0) ? stats->symbols / stats->total_seconds / 1e6 : 0.0;
+	double ratio = (stats->input_bytes > 0) ? (double)stats->output_bytes / stats->input_bytes : 0.0;
+	double length = (stats->symbols > 0) ? (double)stats->code_bits / stats->symbols : 0.0;
+	double entropy;
+	uint64 total;
+	uint i;
+
+	entropy = histogram_entropy(stats->freq_table, &total);
+	if (json) {
+		fprintf(file_out, "{\n");
+		fprintf(file_out, "  \"phases\": {");
+		for (i = 0; i < PHASE_COUNT; i++) {
+			fprintf(file_out, "%s\"%s\": %.6f", (i > 0) ? ", " : " ", phase_names[i], stats->seconds[i]);
+		}
+		fprintf(file_out, " },\n");
+		fprintf(file_out, "  \"total_seconds\": %.6f,\n", stats->total_seconds);
+		fprintf(file_out, "  \"mb_per_s\": %.2f,\n", speed);
+		fprintf(file_out, "  \"input_bytes\": %llu,\n", stats->input_bytes);
+		fprintf(file_out, "  \"output_bytes\": %llu,\n", stats->output_bytes);
+		fprintf(file_out, "  \"ratio\": %.6f,\n", ratio);
+		fprintf(file_out, "  \"symbols\": %llu,\n", stats->symbols);
+		fprintf(file_out, "  \"blocks\": %llu,\n", stats->blocks);
+		fprintf(file_out, "  \"code_bits\": %llu,\n", stats->code_bits);
+		fprintf(file_out, "  \"average_code_length\": %.4f,\n", length);
+		fprintf(file_out, "  \"entropy\": %.4f\n", entropy);
+		fprintf(file_out, "}\n");
+		return;
+	}
+
+	fprintf(file_out, "phase          seconds     share\n");
+	for (i = 0; i < PHASE_COUNT; i++) {
+		fprintf(file_out, "%-10s %11.6f %8.2f%%\n", phase_names[i], stats->seconds[i],
+			(stats->total_seconds > 0) ? 100.0 * stats->seconds[i] / stats->total_seconds : 0.0);
+	}
+	fprintf(file_out, "%-10s %11.6f (%.2f MB/s)\n", "total", stats->total_seconds, speed);
+	fprintf(file_out, "input: %llu bytes, output: %llu bytes (%.2f%%)\n", stats->input_bytes, stats->output_bytes, 100.0 * ratio);
+	fprintf(file_out, "characters: %llu in %llu blocks\n", stats->symbols, stats->blocks);
+	if (stats->code_bits > 0) {
+		fprintf(file_out, "average code length: %.4f bits per character\n", length);
+	}
+	fprintf(file_out, "entropy: %.4f bits per character\n", entropy);
+}
@@ -0,0 +1,71 @@
+/**
+ * stats.h
+ *
+ * Measurements of the coding, phases are timed and the characters counted
+ * only when the caller asks for it
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 20:10
+ */
+
+#ifndef __INCLUDES_STATS_H__
+#define __INCLUDES_STATS_H__
+
+// Phases of the coding which are timed separately
+enum CODINGPHASE
+{
+	PHASE_HISTOGRAM = 0,		// counting the characters
+	PHASE_CODES = 1,			// building the tree, codes and decoding tables
+	PHASE_HEADER = 2,			// writing or reading the headers and code
+								// descriptions
+	PHASE_CODING = 3,			// encoding or decoding the characters
+	PHASE_IO = 4,				// reading and writing the files
+	PHASE_CHECKSUM = 5,			// computing and checking the block checksums
+	PHASE_TRANSFORM = 6,		// transforming the blocks before the coding and
+								// restoring them after the decoding
+	PHASE_COUNT = 7,
+};
+
+// Measurements of the coding, blocks coded by several threads add up their
+// times, so the phases may take longer than the whole coding
+typedef struct CODINGSTATS
+{
+	double seconds[PHASE_COUNT];	// time spent in each phase
+	double total_seconds;			// wall time of the whole coding
+	uint64 input_bytes;				// bytes read from the input
+	uint64 output_bytes;			// bytes written to the output
+	uint64 symbols;					// characters encoded or decoded
+	uint64 blocks;					// blocks coded (whole file is single block)
+	uint64 code_bits;				// bits of the coded characters (encoding only)
+	FREQTABLE freq_table;			// counts of the coded characters
+} CODINGSTATS;
+
+// Clears all the measurements
+void init_stats(CODINGSTATS* stats);
+
+// Returns the time in seconds from some fixed moment
+double stats_clock(void);
+
+// Returns the start time of the phase (nothing is measured without stats)
+double start_phase(CODINGSTATS* stats);
+
+// Adds the time from start to the phase
+void end_phase(CODINGSTATS* stats, uint phase, double start);
+
+// Adds the time from start to the total time of the coding
+void end_total(CODINGSTATS* stats, double start);
+
+// Adds the counts of the coded characters and the bits of their codes
+void add_symbols(CODINGSTATS* stats, FREQTABLE freq_table, uint64 code_bits);
+
+// Counts the characters of the block (used when the frequencies are not
+// known, like for decoding)
+void count_symbols(CODINGSTATS* stats, uchar* block, ulong size);
+
+// Adds the measurements of the part (block) to the stats
+void merge_stats(CODINGSTATS* stats, CODINGSTATS* part);
+
+// Writes the measurements as text or JSON
+void print_stats(FILE* file_out, CODINGSTATS* stats, int json);
+
+#endif // __INCLUDES_STATS_H__
@@ -0,0 +1,130 @@
+/**
+ * sync.c
+ *
+ * Implementation of the sync points
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 21:40
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "bitstream.h"
+#include "sync.h"
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+// How many offsets are allocated at first
+#define SYNC_INITIAL_CAPACITY 64
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Table has no points at first
+void init_sync(SYNCTABLE* sync, ulong interval)
+{
+	memset(sync, 0, sizeof(SYNCTABLE));
+	sync->interval = interval;
+}
+
+// Every interval except the first starts with the point
+uint64 sync_count(uint64 length, ulong interval)
+{
+	return (length > 0) ? (length - 1) / interval : 0;
+}
+
+// Table grows the same way as the block index
+int add_sync(SYNCTABLE* sync, uint64 offset)
+{
+	if (sync->count == sync->capacity) {
+		uint capacity = (sync->capacity > 0) ? 2 * sync->capacity : SYNC_INITIAL_CAPACITY;
+		uint64* offsets = (uint64*)realloc(sync->offsets, capacity * sizeof(uint64));
+		if (offsets == NULL) {
+			perror("Could not allocate memory for sync points (out of memory)");
+			return FAILURE;
+		}
+		sync->offsets = offsets;
+		sync->capacity = capacity;
+	}
+	sync->offsets[sync->count++] = offset;
+	return SUCCESS;
+}
+
+// Offsets are written in two halves like the positions of the index
+int put_sync(BITSTREAM* bs, SYNCTABLE* sync)
+{
+	uint i;
+
+	if (bs_align(bs) == FAILURE) {
+		return FAILURE;
+	}
+	for (i = 0; i < sync->count; i++) {
+		if ((bs_write_bits(bs, (uint)(sync->offsets[i] >> 32), SYNC_OFFSET_WIDTH / 2) == FAILURE) ||
+			(bs_write_bits(bs, (uint)sync->offsets[i], SYNC_OFFSET_WIDTH / 2) == FAILURE)) {
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+// Size of the table is known from the length of the file, so it has no
+// footer of its own
+int get_sync(uchar* data, size_t size, uint64 start, uint64 length, ulong interval, SYNCTABLE* sync)
+{
+	BITSTREAM bs;
+	uint64 count = sync_count(length, interval);
+	uint64 position;
+	uint high;
+	uint low;
+	uint i;
+
+	init_sync(sync, interval);
+	if ((interval == 0) || (count > UINT_MAX) || (count * SYNC_ENTRY_SIZE > size) ||
+		((size - count * SYNC_ENTRY_SIZE) * UCHAR_WIDTH < start)) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	position = size - count * SYNC_ENTRY_SIZE;
+	sync->offsets = (uint64*)malloc((size_t)(count > 0 ? count : 1) * sizeof(uint64));
+	if (sync->offsets == NULL) {
+		perror("Could not allocate memory for sync points (out of memory)");
+		return FAILURE;
+	}
+	sync->capacity = (uint)count;
+	sync->start = start;
+	
+	// Points follow each other and the codes end before the table
+	bs_init_memory(&bs, &data[position], (size_t)(size - position), READ);
+	for (i = 0; i < count; i++) {
+		if ((bs_read_bits(&bs, SYNC_OFFSET_WIDTH / 2, &high) == FAILURE) ||
+			(bs_read_bits(&bs, SYNC_OFFSET_WIDTH / 2, &low) == FAILURE)) {
+			release_sync(sync);
+			return FAILURE;
+		}
+		sync->offsets[i] = ((uint64)high << 32) | low;
+		if ((sync->offsets[i] > position * UCHAR_WIDTH - start) || ((i > 0) && (sync->offsets[i] < sync->offsets[i - 1]))) {
+			fprintf(stderr, "Archive is corrupted!\n");
+			release_sync(sync);
+			return FAILURE;
+		}
+		sync->count++;
+	}
+	return SUCCESS;
+}
+
+// Interval is kept, so the table may be filled again
+void release_sync(SYNCTABLE* sync)
+{
+	free(sync->offsets);
+	init_sync(sync, sync->interval);
+}
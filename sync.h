@@ -0,0 +1,75 @@
+/**
+ * sync.h
+ *
+ * Sync points of the archive coded as single block, the table of the bit
+ * offsets follows the codes, so the parts of the block between the points
+ * may be decoded at the same time
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 21:40
+ */
+
+#ifndef __INCLUDES_SYNC_H__
+#define __INCLUDES_SYNC_H__
+
+#ifndef __UCHAR_DEFINED__
+#define __UCHAR_DEFINED__
+typedef unsigned char uchar;
+#endif
+
+#ifndef __UINT_DEFINED__
+#define __UINT_DEFINED__
+typedef unsigned int uint;
+#endif
+
+#ifndef __ULONG_DEFINED__
+#define __ULONG_DEFINED__
+typedef unsigned long ulong;
+#endif
+
+#ifndef __UINT64_DEFINED__
+#define __UINT64_DEFINED__
+typedef unsigned long long uint64;
+#endif
+
+// Width of single offset in the table
+#define SYNC_OFFSET_WIDTH 64
+
+// Size of single offset in bytes
+#define SYNC_ENTRY_SIZE (SYNC_OFFSET_WIDTH / 8)
+
+// Bit offsets of the characters at every interval of the file (first
+// character has no entry, its codes start the block)
+typedef struct SYNCTABLE
+{
+	uint64* offsets;			// offset of each point from the first code
+	uint count;					// how many points are in the table
+	uint capacity;				// how many offsets are allocated
+	ulong interval;				// how many characters are between the points
+	uint64 start;				// position of the first code in the stream
+	uint64 position;			// how many characters are coded so far
+} SYNCTABLE;
+
+// Prepares empty table for points after every interval characters
+void init_sync(SYNCTABLE* sync, ulong interval);
+
+// Returns how many points the file of given length has
+uint64 sync_count(uint64 length, ulong interval);
+
+// Adds the point which starts at given bit offset
+// Returns error code
+int add_sync(SYNCTABLE* sync, uint64 offset);
+
+// Writes the table from the next byte boundary of the stream
+// Returns error code
+int put_sync(BITSTREAM* bs, SYNCTABLE* sync);
+
+// Reads the table from the end of the archive in memory and checks that the
+// offsets stay between the first code (start bit) and the table
+// Returns error code
+int get_sync(uchar* data, size_t size, uint64 start, uint64 length, ulong interval, SYNCTABLE* sync);
+
+// Releases the memory of the table
+void release_sync(SYNCTABLE* sync);
+
+#endif // __INCLUDES_SYNC_H__
@@ -0,0 +1,1033 @@
+/**
+ * table.c
+ *
+ * Implementation of the encoding and decoding lookup tables
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 16:40
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "bitstream.h"
+#include "tree.h"
+#include "table.h"
+#include "cpu.h"
+
+#if CPU_DISPATCH
+#include <immintrin.h>
+
+// GCC has _bzhi_u64 but not the intrinsics of the shifts, the count is
+// masked the same way the instructions mask it, so in the BMI2 kernels
+// these are single shlx and shrx
+#ifndef _shlx_u64
+#define _shlx_u64(value, count) ((uint64)(value) << ((count) & 63))
+#define _shrx_u64(value, count) ((uint64)(value) >> ((count) & 63))
+#endif
+#endif
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+// Number of bytes in the bit buffer
+#define BIT_BUFFER_BYTES (BIT_BUFFER_WIDTH / UCHAR_WIDTH)
+
+// Bytes which single code can complete when less than a byte is waiting
+#define CODE_STORE_BYTES ((UCHAR_WIDTH - 1 + MAX_CODE_LENGTH - 1) / UCHAR_WIDTH)
+
+// Characters decoded by the plain kernel where the block of the stream is
+// not long enough for the whole words (stream reads the next block)
+#define DECODE_SLOW_CHARS 16
+
+// Reads bits of single stream in memory, the reader keeps its bits in local
+// variables so several readers can work side by side
+typedef struct BITREADER
+{
+	uint64 bits;				// next bits of the stream (highest bits first)
+	uint count;					// how many bits are valid
+	uint padding;				// how many zero bits were added after the end
+	uchar* next;				// next byte which is not in the bits
+	uchar* end;					// end of the stream
+} BITREADER;
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Collects the codes of the node and all its subnodes
+int put_codes(NODE* node, CODETABLE* table, uint64 code, uint length);
+
+// Reserves count entries at the end of the decoding table
+int add_entries(DECODETABLE* table, uint count, uint* position);
+
+// Fills the table level for the codes which start with the given prefix
+int fill_level(DECODETABLE* table, CODETABLE* codes, uint position, uint64 prefix, uint consumed, uint bits);
+
+// Joins second character to the first level entries where possible
+void pair_entries(DECODETABLE* table);
+
+// Fills the reader with at least 56 bits (zero bits after the end)
+void fill_reader(BITREADER* reader);
+
+// Decodes single character whose code continues in the subtables
+int decode_linked(BITREADER* reader, DECODETABLE* table, uchar* out);
+
+// Kernel of encode_strided with plain instructions
+int encode_strided_scalar(BITSTREAM* bs, CODETABLE* table, uchar* in, ulong count, uint stride);
+
+// Kernel of encode_strided which stores the bytes straight to the block
+// with BMI2 shifts (same output as encode_strided_scalar)
+int encode_strided_bmi2(BITSTREAM* bs, CODETABLE* table, uchar* in, ulong count, uint stride);
+
+// Kernel of decode_chars with plain instructions
+int decode_chars_scalar(BITSTREAM* bs, DECODETABLE* table, uchar* out, ulong count);
+
+// Kernel of decode_chars which reads the block of the stream directly with
+// BMI2 shifts
+int decode_chars_bmi2(BITSTREAM* bs, DECODETABLE* table, uchar* out, ulong count);
+
+// Kernel of decode_interleaved with plain instructions
+int decode_interleaved_scalar(uchar** streams, ulong* sizes, DECODETABLE* table, uchar* out, ulong count);
+
+// Kernel of decode_interleaved with BMI2 shifts
+int decode_interleaved_bmi2(uchar** streams, ulong* sizes, DECODETABLE* table, uchar* out, ulong count);
+
+// Copies the first level of the table to the compact lookup one entry at a
+// time, returns zero if some code is longer than the first level
+int fill_lookup_scalar(DECODETABLE* table, ushort* lookup);
+
+// Copies the first level of the table to the compact lookup eight entries at
+// a time (same result as fill_lookup_scalar)
+int fill_lookup_avx2(DECODETABLE* table, ushort* lookup);
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Finds codes for all characters by walking the tree from the root
+int build_code_table(TREE* tree, CODETABLE* table)
+{
+	// Characters which are not in the tree have no code
+	memset(table, 0, sizeof(CODETABLE));
+	if (tree->root == NULL) {
+		return SUCCESS;
+	}
+	// Single character is the root itself, so it takes no bits to code it
+	if (tree->root->left == NULL) {
+		table->uniform = 1;
+		table->uniform_ch = tree->root->ch;
+		return SUCCESS;
+	}
+	return put_codes(tree->root, table, 0, 0);
+}
+
+// Builds the decoding table from the character codes
+DECODETABLE* build_decode_table(CODETABLE* codes)
+{
+	// Allocate memory for the table
+	DECODETABLE* table = (DECODETABLE*)malloc(sizeof(DECODETABLE));
+	if (table == NULL) {
+		perror("Could not allocate memory for decoding table (out of memory)");
+		return NULL;
+	}
+	memset(table, 0, sizeof(DECODETABLE));
+
+	if (fill_decode_table(table, codes) == FAILURE) {
+		release_decode_table(table);
+		return NULL;
+	}
+	return table;
+}
+
+// Old entries are dropped but their memory is kept
+int fill_decode_table(DECODETABLE* table, CODETABLE* codes)
+{
+	uint position;
+
+	table->entry_count = 0;
+	table->uniform = 0;
+
+	// Uniform table has nothing to look up
+	if (codes->uniform) {
+		table->uniform = 1;
+		table->uniform_ch = codes->uniform_ch;
+		return SUCCESS;
+	}
+
+	// Fill the first level (and all the subtables it links to)
+	if ((add_entries(table, 1 << DECODE_TABLE_BITS, &position) == FAILURE) || (fill_level(table, codes, position, 0, 0, DECODE_TABLE_BITS) == FAILURE)) {
+		return FAILURE;
+	}
+	pair_entries(table);
+	return SUCCESS;
+}
+
+// Releases memory allocated by the decoding table
+void release_decode_table(DECODETABLE* table)
+{
+	free(table->entries);
+	free(table);
+}
+
+// Encodes all characters of the input
+int encode_chars(BITSTREAM* bs, CODETABLE* table, uchar* in, ulong count)
+{
+	return encode_strided(bs, table, in, count, 1);
+}
+
+// Encodes with the kernel which the processor supports
+int encode_strided(BITSTREAM* bs, CODETABLE* table, uchar* in, ulong count, uint stride)
+{
+	if (cpu_features() & CPU_BMI2) {
+		return encode_strided_bmi2(bs, table, in, count, stride);
+	}
+	return encode_strided_scalar(bs, table, in, count, stride);
+}
+
+// Decodes with the kernel which the processor supports
+int decode_chars(BITSTREAM* bs, DECODETABLE* table, uchar* out, ulong count)
+{
+	if (cpu_features() & CPU_BMI2) {
+		return decode_chars_bmi2(bs, table, out, count);
+	}
+	return decode_chars_scalar(bs, table, out, count);
+}
+
+// Decodes with the kernel which the processor supports
+int decode_interleaved(uchar** streams, ulong* sizes, DECODETABLE* table, uchar* out, ulong count)
+{
+	if (cpu_features() & CPU_BMI2) {
+		return decode_interleaved_bmi2(streams, sizes, table, out, count);
+	}
+	return decode_interleaved_scalar(streams, sizes, table, out, count);
+}
+
+// Codes are collected to the bit buffer the same way encode_strided does,
+// only the table changes with every character
+int encode_contexts(BITSTREAM* bs, CODETABLE* tables, uchar* map, uchar* in, ulong count)
+{
+	uint64 buffer = 0;
+	uint buffer_count = 0;
+	uint previous = 0;
+	ulong i;
+
+	for (i = 0; i < count; i++) {
+		CODETABLE* table = &tables[map[previous]];
+		uint64 code = table->code[in[i]];
+		uint length = table->length[in[i]];
+		previous = in[i];
+		// Uniform table codes its only character with zero bits
+		if (table->uniform) {
+			continue;
+		}
+		if (length > 32) {
+			buffer = (buffer << (length - 32)) | (code >> 32);
+			buffer_count += length - 32;
+			if (buffer_count >= 32) {
+				buffer_count -= 32;
+				if (bs_write_bits(bs, (uint)(buffer >> buffer_count), 32) == FAILURE) {
+					return FAILURE;
+				}
+			}
+			code &= 0xFFFFFFFF;
+			length = 32;
+		}
+		buffer = (buffer << length) | code;
+		buffer_count += length;
+		if (buffer_count >= 32) {
+			buffer_count -= 32;
+			if (bs_write_bits(bs, (uint)(buffer >> buffer_count), 32) == FAILURE) {
+				return FAILURE;
+			}
+		}
+	}
+	if (buffer_count > 0) {
+		return bs_write_bits(bs, (uint)(buffer & ((1ULL << buffer_count) - 1)), buffer_count);
+	}
+	return SUCCESS;
+}
+
+// Characters are decoded one at a time, because the table of the next
+// character is known only after the lookup (paired entries are not used).
+// When no code is longer than the first level, the first levels are copied
+// to compact lookups of the character and its length, which stay in the
+// cache together and need no refill for five lookups
+int decode_contexts(uchar* stream, ulong size, DECODETABLE* tables, uint table_count, uchar* map, uchar* out, ulong count)
+{
+	BITREADER reader;
+	ushort (*lookups)[1 << DECODE_TABLE_BITS];
+	ushort* context_lookups[MAX_CHAR];
+	uint features = cpu_features();
+	uint previous = 0;
+	ulong i = 0;
+	uint k;
+	uint c;
+
+	memset(&reader, 0, sizeof(BITREADER));
+	reader.next = stream;
+	reader.end = stream + size;
+
+	lookups = (ushort (*)[1 << DECODE_TABLE_BITS])malloc(table_count * sizeof(*lookups));
+	if (lookups == NULL) {
+		perror("Could not allocate memory for decoding table (out of memory)");
+		return FAILURE;
+	}
+	for (k = 0; k < table_count; k++) {
+		if (tables[k].uniform) {
+			for (c = 0; c < (1 << DECODE_TABLE_BITS); c++) {
+				lookups[k][c] = tables[k].uniform_ch;
+			}
+			continue;
+		}
+		if (!((features & CPU_AVX2) ? fill_lookup_avx2(&tables[k], lookups[k]) : fill_lookup_scalar(&tables[k], lookups[k]))) {
+			break;
+		}
+	}
+
+	if (k == table_count) {
+		for (c = 0; c < MAX_CHAR; c++) {
+			context_lookups[c] = lookups[map[c]];
+		}
+		// Every lookup takes at most DECODE_TABLE_BITS bits of at least 56
+		// bits of the filled reader
+		while (i + 5 <= count) {
+			uint round;
+			fill_reader(&reader);
+			for (round = 0; round < 5; round++) {
+				uint entry = context_lookups[previous][reader.bits >> (BIT_BUFFER_WIDTH - DECODE_TABLE_BITS)];
+				previous = entry & 0xFF;
+				out[i++] = (uchar)previous;
+				reader.bits <<= entry >> UCHAR_WIDTH;
+				reader.count -= entry >> UCHAR_WIDTH;
+			}
+		}
+		fill_reader(&reader);
+		while (i < count) {
+			uint entry = context_lookups[previous][reader.bits >> (BIT_BUFFER_WIDTH - DECODE_TABLE_BITS)];
+			previous = entry & 0xFF;
+			out[i++] = (uchar)previous;
+			reader.bits <<= entry >> UCHAR_WIDTH;
+			reader.count -= entry >> UCHAR_WIDTH;
+		}
+	}
+	free(lookups);
+
+	// Long codes continue in the subtables, the reader is filled when it
+	// can not resolve the first level lookup
+	while (i < count) {
+		fill_reader(&reader);
+		while ((reader.count >= DECODE_TABLE_BITS) && (i < count)) {
+			DECODETABLE* table = &tables[map[previous]];
+			DECODEENTRY* entry;
+			if (table->uniform) {
+				out[i] = table->uniform_ch;
+				previous = out[i++];
+				continue;
+			}
+			entry = &table->entries[reader.bits >> (BIT_BUFFER_WIDTH - DECODE_TABLE_BITS)];
+			if (entry->count == 0) {
+				if (decode_linked(&reader, table, &out[i]) == FAILURE) {
+					return FAILURE;
+				}
+			} else {
+				out[i] = entry->ch[0];
+				reader.bits <<= entry->first_length;
+				reader.count -= entry->first_length;
+			}
+			previous = out[i++];
+		}
+	}
+
+	// Codes must not run over the end of the stream
+	if (reader.padding > reader.count) {
+		fprintf(stderr, "Unexpected end of file!\n");
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+/**
+ * Private methods of the library
+ */
+
+// Loads 8 bytes at once while they are available (bits of the partly
+// loaded byte are loaded again next time, so they are simply overwritten
+// with the same value), near the end of the stream bytes are loaded one by
+// one
+void fill_reader(BITREADER* reader)
+{
+	if (reader->end - reader->next >= 8) {
+		uint64 word = ((uint64)reader->next[0] << 56) | ((uint64)reader->next[1] << 48) |
+			((uint64)reader->next[2] << 40) | ((uint64)reader->next[3] << 32) |
+			((uint64)reader->next[4] << 24) | ((uint64)reader->next[5] << 16) |
+			((uint64)reader->next[6] << 8) | (uint64)reader->next[7];
+		uint bytes = (BIT_BUFFER_WIDTH - 1 - reader->count) >> 3;
+		reader->bits |= word >> reader->count;
+		reader->next += bytes;
+		reader->count += bytes << 3;
+		return;
+	}
+	while (reader->count <= BIT_BUFFER_WIDTH - UCHAR_WIDTH) {
+		uint64 byte = 0;
+		if (reader->next < reader->end) {
+			byte = *reader->next++;
+		} else {
+			reader->padding += UCHAR_WIDTH;
+		}
+		reader->bits |= byte << (BIT_BUFFER_WIDTH - UCHAR_WIDTH - reader->count);
+		reader->count += UCHAR_WIDTH;
+	}
+}
+
+// Follows the links to the subtables until the character is found
+int decode_linked(BITREADER* reader, DECODETABLE* table, uchar* out)
+{
+	DECODEENTRY* entry;
+
+	fill_reader(reader);
+	entry = &table->entries[reader->bits >> (BIT_BUFFER_WIDTH - DECODE_TABLE_BITS)];
+	while (entry->count == 0) {
+		if (entry->link_bits == 0) {
+			// Should not reach here unless the codes are incomplete
+			fprintf(stderr, "Archive is corrupted!\n");
+			return FAILURE;
+		}
+		reader->bits <<= entry->length;
+		reader->count -= entry->length;
+		entry = &table->entries[entry->link + (uint)(reader->bits >> (BIT_BUFFER_WIDTH - entry->link_bits))];
+	}
+	*out = entry->ch[0];
+	reader->bits <<= entry->length;
+	reader->count -= entry->length;
+	return SUCCESS;
+}
+
+// Walks the tree and records the path to each leaf as code of its character
+int put_codes(NODE* node, CODETABLE* table, uint64 code, uint length)
+{
+	// Leaf node ends the code
+	if (node->left == NULL) {
+		table->code[node->ch] = code;
+		table->length[node->ch] = (uchar)length;
+		return SUCCESS;
+	}
+	// Tree is too deep to hold the code in the table, callers tell if the
+	// tree came from the archive or from the counts of the characters
+	if (length >= MAX_CODE_LENGTH) {
+		return FAILURE;
+	}
+	// Left branch adds low bit and right branch adds high bit to the code
+	if ((put_codes(node->left, table, code << 1, length + 1) == FAILURE) || (put_codes(node->right, table, (code << 1) | 1, length + 1) == FAILURE)) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+// Adds count cleared entries to the end of the decoding table
+int add_entries(DECODETABLE* table, uint count, uint* position)
+{
+	// Grow the entry list if there is no room for the new entries
+	if (table->entry_count + count > table->entry_capacity) {
+		uint capacity = (table->entry_capacity) ? table->entry_capacity : count;
+		DECODEENTRY* entries;
+		while (capacity < table->entry_count + count) {
+			capacity *= 2;
+		}
+		entries = (DECODEENTRY*)realloc(table->entries, capacity * sizeof(DECODEENTRY));
+		if (entries == NULL) {
+			perror("Could not allocate memory for decoding table (out of memory)");
+			return FAILURE;
+		}
+		table->entries = entries;
+		table->entry_capacity = capacity;
+	}
+	// Reset the new entries
+	memset(&table->entries[table->entry_count], 0, count * sizeof(DECODEENTRY));
+	*position = table->entry_count;
+	table->entry_count += count;
+	return SUCCESS;
+}
+
+// Fills the entries at the given position for all the codes which begin with
+// the prefix of consumed bits, longer codes are linked to the subtables
+int fill_level(DECODETABLE* table, CODETABLE* codes, uint position, uint64 prefix, uint consumed, uint bits)
+{
+	uint i;
+	uint j;
+
+	for (i = 0; i < MAX_CHAR; i++) {
+		uint length = codes->length[i];
+		uint rest;
+		// Skip characters which do not belong under this prefix
+		if ((length <= consumed) || ((codes->code[i] >> (length - consumed)) != prefix)) {
+			continue;
+		}
+		rest = length - consumed;
+		if (rest <= bits) {
+			// Code fits to this level, so fill all entries which begin with it
+			uint first = (uint)(codes->code[i] & ((1 << rest) - 1)) << (bits - rest);
+			for (j = first; j < first + (1 << (bits - rest)); j++) {
+				DECODEENTRY* entry = &table->entries[position + j];
+				entry->ch[0] = (uchar)i;
+				entry->count = 1;
+				entry->length = (uchar)rest;
+				entry->first_length = (uchar)rest;
+			}
+		} else {
+			// Code continues in the subtable, remember the longest remainder
+			DECODEENTRY* entry = &table->entries[position + (uint)((codes->code[i] >> (rest - bits)) & ((1 << bits) - 1))];
+			entry->length = (uchar)bits;
+			if (rest - bits > entry->link_bits) {
+				entry->link_bits = (uchar)(rest - bits);
+			}
+		}
+	}
+
+	// Create the subtables for the linked entries (entry list may move while
+	// adding the subtables, so entries are always accessed by position)
+	for (j = 0; j < (1U << bits); j++) {
+		uint link;
+		uint link_bits = table->entries[position + j].link_bits;
+		if ((table->entries[position + j].count > 0) || (link_bits == 0)) {
+			continue;
+		}
+		if (link_bits > DECODE_SUBTABLE_BITS) {
+			link_bits = DECODE_SUBTABLE_BITS;
+		}
+		if (add_entries(table, 1 << link_bits, &link) == FAILURE) {
+			return FAILURE;
+		}
+		table->entries[position + j].link = link;
+		table->entries[position + j].link_bits = (uchar)link_bits;
+		if (fill_level(table, codes, link, (prefix << bits) | j, consumed + bits, link_bits) == FAILURE) {
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+// Adds the following character to the first level entries, when the rest of
+// the looked up bits are enough to resolve it
+void pair_entries(DECODETABLE* table)
+{
+	uint i;
+	uint mask = (1 << DECODE_TABLE_BITS) - 1;
+
+	for (i = 0; i <= mask; i++) {
+		DECODEENTRY* entry = &table->entries[i];
+		DECODEENTRY* next;
+		if ((entry->count != 1) || (entry->length >= DECODE_TABLE_BITS)) {
+			continue;
+		}
+		// Remaining bits of the index are the beginning of the next code
+		next = &table->entries[(i << entry->length) & mask];
+		if ((next->count > 0) && (next->first_length <= DECODE_TABLE_BITS - entry->length)) {
+			entry->ch[1] = next->ch[0];
+			entry->count = 2;
+			entry->length += next->first_length;
+		}
+	}
+}
+
+// Encodes characters by collecting their codes to the bit buffer and writing
+// the buffer to the stream in 32-bit pieces
+int encode_strided_scalar(BITSTREAM* bs, CODETABLE* table, uchar* in, ulong count, uint stride)
+{
+	uint64 buffer = 0;
+	uint buffer_count = 0;
+	ulong i;
+
+	// Uniform table codes its only character with zero bits
+	if (table->uniform) {
+		return SUCCESS;
+	}
+
+	for (i = 0; i < count; i++) {
+		uint64 code = table->code[in[i * stride]];
+		uint length = table->length[in[i * stride]];
+		// Codes longer than 32 bits are added in two pieces, so the buffer
+		// never holds more than 63 bits
+		if (length > 32) {
+			buffer = (buffer << (length - 32)) | (code >> 32);
+			buffer_count += length - 32;
+			if (buffer_count >= 32) {
+				buffer_count -= 32;
+				if (bs_write_bits(bs, (uint)(buffer >> buffer_count), 32) == FAILURE) {
+					return FAILURE;
+				}
+			}
+			code &= 0xFFFFFFFF;
+			length = 32;
+		}
+		buffer = (buffer << length) | code;
+		buffer_count += length;
+		if (buffer_count >= 32) {
+			buffer_count -= 32;
+			if (bs_write_bits(bs, (uint)(buffer >> buffer_count), 32) == FAILURE) {
+				return FAILURE;
+			}
+		}
+	}
+	// Write the bits left in the buffer
+	if (buffer_count > 0) {
+		return bs_write_bits(bs, (uint)(buffer & ((1ULL << buffer_count) - 1)), buffer_count);
+	}
+	return SUCCESS;
+}
+
+// Decodes characters by looking up several bits at once from the table
+int decode_chars_scalar(BITSTREAM* bs, DECODETABLE* table, uchar* out, ulong count)
+{
+	DECODEENTRY* entry;
+	uint value;
+	ulong i = 0;
+
+	// Uniform table takes no bits from the stream
+	if (table->uniform) {
+		memset(out, table->uniform_ch, count);
+		return SUCCESS;
+	}
+
+	while (i < count) {
+		// Look up the first level using next bits of the stream
+		if (bs_peek_bits(bs, DECODE_TABLE_BITS, &value) == FAILURE) {
+			return FAILURE;
+		}
+		entry = &table->entries[value];
+
+		// Long codes continue in the subtables
+		while (entry->count == 0) {
+			if (entry->link_bits == 0) {
+				// Should not reach here unless the codes are incomplete
+				fprintf(stderr, "Archive is corrupted!\n");
+				return FAILURE;
+			}
+			if ((bs_consume_bits(bs, entry->length) == FAILURE) || (bs_peek_bits(bs, entry->link_bits, &value) == FAILURE)) {
+				return FAILURE;
+			}
+			entry = &table->entries[entry->link + value];
+		}
+
+		// Write the characters and skip their bits (second character may not
+		// be part of the requested output)
+		out[i++] = entry->ch[0];
+		if ((entry->count > 1) && (i < count)) {
+			out[i++] = entry->ch[1];
+			if (bs_consume_bits(bs, entry->length) == FAILURE) {
+				return FAILURE;
+			}
+		} else if (bs_consume_bits(bs, entry->first_length) == FAILURE) {
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+// Every reader decodes up to two characters per lookup and makes two lookups
+// between the refills, the readers do not depend on each other so their
+// lookups overlap
+int decode_interleaved_scalar(uchar** streams, ulong* sizes, DECODETABLE* table, uchar* out, ulong count)
+{
+	BITREADER readers[INTERLEAVE_STREAMS];
+	ulong positions[INTERLEAVE_STREAMS];
+	DECODEENTRY* entries = table->entries;
+	uint round;
+	uint s;
+
+	// Uniform table takes no bits from the streams
+	if (table->uniform) {
+		memset(out, table->uniform_ch, count);
+		return SUCCESS;
+	}
+	for (s = 0; s < INTERLEAVE_STREAMS; s++) {
+		memset(&readers[s], 0, sizeof(BITREADER));
+		readers[s].next = streams[s];
+		readers[s].end = streams[s] + sizes[s];
+		positions[s] = s;
+	}
+
+	// Main loop runs while every stream has room for four more characters
+	// (two rounds of lookups which may resolve two characters each)
+	while ((positions[0] + 3 * INTERLEAVE_STREAMS < count) && (positions[1] + 3 * INTERLEAVE_STREAMS < count) &&
+		(positions[2] + 3 * INTERLEAVE_STREAMS < count) && (positions[3] + 3 * INTERLEAVE_STREAMS < count)) {
+		for (s = 0; s < INTERLEAVE_STREAMS; s++) {
+			fill_reader(&readers[s]);
+		}
+		for (round = 0; round < 2; round++) {
+			for (s = 0; s < INTERLEAVE_STREAMS; s++) {
+				BITREADER* reader = &readers[s];
+				DECODEENTRY* entry = &entries[reader->bits >> (BIT_BUFFER_WIDTH - DECODE_TABLE_BITS)];
+				if (entry->count == 0) {
+					if (decode_linked(reader, table, &out[positions[s]]) == FAILURE) {
+						return FAILURE;
+					}
+					positions[s] += INTERLEAVE_STREAMS;
+					continue;
+				}
+				// Second character is written even if entry has only one,
+				// next character overwrites it
+				out[positions[s]] = entry->ch[0];
+				out[positions[s] + INTERLEAVE_STREAMS] = entry->ch[1];
+				positions[s] += entry->count * INTERLEAVE_STREAMS;
+				reader->bits <<= entry->length;
+				reader->count -= entry->length;
+			}
+		}
+	}
+
+	// Finish each stream one character at a time
+	for (s = 0; s < INTERLEAVE_STREAMS; s++) {
+		BITREADER* reader = &readers[s];
+		while (positions[s] < count) {
+			DECODEENTRY* entry;
+			fill_reader(reader);
+			entry = &entries[reader->bits >> (BIT_BUFFER_WIDTH - DECODE_TABLE_BITS)];
+			if (entry->count == 0) {
+				if (decode_linked(reader, table, &out[positions[s]]) == FAILURE) {
+					return FAILURE;
+				}
+				positions[s] += INTERLEAVE_STREAMS;
+				continue;
+			}
+			out[positions[s]] = entry->ch[0];
+			positions[s] += INTERLEAVE_STREAMS;
+			if ((entry->count > 1) && (positions[s] < count)) {
+				out[positions[s]] = entry->ch[1];
+				positions[s] += INTERLEAVE_STREAMS;
+				reader->bits <<= entry->length;
+				reader->count -= entry->length;
+			} else {
+				reader->bits <<= entry->first_length;
+				reader->count -= entry->first_length;
+			}
+		}
+		// Codes must not run over the end of the stream
+		if (reader->padding > reader->count) {
+			fprintf(stderr, "Unexpected end of file!\n");
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+// Entry of the lookup has the character in its low byte and the length of
+// its code in the high byte
+int fill_lookup_scalar(DECODETABLE* table, ushort* lookup)
+{
+	uint c;
+
+	for (c = 0; c < (1 << DECODE_TABLE_BITS); c++) {
+		DECODEENTRY* entry = &table->entries[c];
+		if (entry->count == 0) {
+			return 0;
+		}
+		lookup[c] = (ushort)(entry->ch[0] | (entry->first_length << UCHAR_WIDTH));
+	}
+	return 1;
+}
+
+#if CPU_DISPATCH
+
+// Entries are gathered as two 32-bit words each (first has the characters,
+// count and length, second begins with the length of the first code), so
+// this works only while the entry is three words
+TARGET_AVX2
+int fill_lookup_avx2(DECODETABLE* table, ushort* lookup)
+{
+	__m256i first = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	__m256i second = _mm256_add_epi32(first, _mm256_set1_epi32(1));
+	__m256i low_byte = _mm256_set1_epi32(0xFF);
+	uint c;
+
+	if ((sizeof(DECODEENTRY) != 3 * sizeof(int)) || (offsetof(DECODEENTRY, count) != 2) || (offsetof(DECODEENTRY, first_length) != 4)) {
+		return fill_lookup_scalar(table, lookup);
+	}
+	for (c = 0; c < (1 << DECODE_TABLE_BITS); c += 8) {
+		int* words = (int*)&table->entries[c];
+		__m256i head = _mm256_i32gather_epi32(words, first, 4);
+		__m256i tail = _mm256_i32gather_epi32(words, second, 4);
+		__m256i counts = _mm256_and_si256(_mm256_srli_epi32(head, 16), low_byte);
+		__m256i values;
+		// Linked entry means some code is longer than the first level
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(counts, _mm256_setzero_si256())) != 0) {
+			return 0;
+		}
+		values = _mm256_or_si256(_mm256_and_si256(head, low_byte), _mm256_slli_epi32(_mm256_and_si256(tail, low_byte), UCHAR_WIDTH));
+		// Pack to 16 bits, both halves of the vector keep their own values
+		values = _mm256_permute4x64_epi64(_mm256_packus_epi32(values, values), 0x08);
+		_mm_storeu_si128((__m128i*)&lookup[c], _mm256_castsi256_si128(values));
+	}
+	return 1;
+}
+
+// Waiting bits are kept in the low bits of the buffer, every code is masked
+// to its length with bzhi and shifted in with shlx, and after every code the
+// whole word is stored highest byte first with the complete bytes moved past
+// (so a code of up to 55 bits always fits after less than a byte). The bits
+// over the waiting ones are shifted out by the store and never cleared
+TARGET_BMI2
+int encode_strided_bmi2(BITSTREAM* bs, CODETABLE* table, uchar* in, ulong count, uint stride)
+{
+	uint64 buffer;
+	uint buffer_count;
+	uchar* next;
+	ulong room;
+	ulong end;
+	ulong i = 0;
+
+	// Uniform table codes its only character with zero bits
+	if (table->uniform) {
+		return SUCCESS;
+	}
+
+	while (i < count) {
+		room = (count - i) * CODE_STORE_BYTES + BIT_BUFFER_BYTES;
+		if (bs_reserve(bs, (room < bs->block_size / 2) ? room : bs->block_size / 2) == FAILURE) {
+			return FAILURE;
+		}
+		// Near the end of the memory block the plain kernel writes the rest
+		room = bs->block_size - bs->block_position;
+		if (room < BIT_BUFFER_BYTES + CODE_STORE_BYTES) {
+			return encode_strided_scalar(bs, table, in + i * stride, count - i, stride);
+		}
+		end = i + (room - BIT_BUFFER_BYTES) / CODE_STORE_BYTES;
+		if (end > count) {
+			end = count;
+		}
+
+		buffer_count = bs->bit_buffer_count;
+		buffer = _shrx_u64(bs->bit_buffer, BIT_BUFFER_WIDTH - buffer_count);
+		next = &bs->block[bs->block_position];
+		for (; i < end; i++) {
+			uint length = table->length[in[i * stride]];
+			uint64 word;
+			buffer = _shlx_u64(buffer, length) | _bzhi_u64(table->code[in[i * stride]], length);
+			buffer_count += length;
+			word = __builtin_bswap64(_shlx_u64(buffer, BIT_BUFFER_WIDTH - buffer_count));
+			memcpy(next, &word, sizeof(word));
+			next += buffer_count >> 3;
+			buffer_count &= UCHAR_WIDTH - 1;
+		}
+		bs->block_position = next - bs->block;
+		bs->bit_buffer = _shlx_u64(_bzhi_u64(buffer, buffer_count), BIT_BUFFER_WIDTH - buffer_count);
+		bs->bit_buffer_count = buffer_count;
+	}
+	return SUCCESS;
+}
+
+// Bits of the stream are taken from its block the same way the stream fills
+// its buffer, but without a call for every code: the refill loads whole word
+// and shifts it after the waiting bits with shrx, the lookups take the top
+// bits with shrx and drop them with shlx. The plain kernel decodes the
+// characters where the block has less than a word left
+TARGET_BMI2
+int decode_chars_bmi2(BITSTREAM* bs, DECODETABLE* table, uchar* out, ulong count)
+{
+	DECODEENTRY* entries = table->entries;
+	uint64 bits;
+	uint bits_count;
+	uchar* next;
+	uchar* last;
+	ulong i = 0;
+
+	// Uniform table takes no bits from the stream
+	if (table->uniform) {
+		memset(out, table->uniform_ch, count);
+		return SUCCESS;
+	}
+
+	while (i < count) {
+		bits = bs->bit_buffer;
+		bits_count = bs->bit_buffer_count;
+		next = &bs->block[bs->block_position];
+		last = &bs->block[bs->block_length];
+		// After the refill there are at least 56 bits, which is enough for
+		// four first level lookups (up to two characters each) or any
+		// linked code
+		while ((last - next >= BIT_BUFFER_BYTES) && (i + 8 <= count)) {
+			DECODEENTRY* entry;
+			uint64 word;
+			uint round;
+			memcpy(&word, next, sizeof(word));
+			bits |= _shrx_u64(__builtin_bswap64(word), bits_count);
+			next += (BIT_BUFFER_WIDTH - 1 - bits_count) >> 3;
+			bits_count |= BIT_BUFFER_WIDTH - UCHAR_WIDTH;
+
+			entry = &entries[_shrx_u64(bits, BIT_BUFFER_WIDTH - DECODE_TABLE_BITS)];
+			if (entry->count == 0) {
+				while (entry->count == 0) {
+					if (entry->link_bits == 0) {
+						// Should not reach here unless the codes are incomplete
+						fprintf(stderr, "Archive is corrupted!\n");
+						return FAILURE;
+					}
+					bits = _shlx_u64(bits, entry->length);
+					bits_count -= entry->length;
+					entry = &entries[entry->link + _shrx_u64(bits, BIT_BUFFER_WIDTH - entry->link_bits)];
+				}
+				out[i++] = entry->ch[0];
+				bits = _shlx_u64(bits, entry->length);
+				bits_count -= entry->length;
+				continue;
+			}
+			// Second character is written even if entry has only one, next
+			// character overwrites it
+			for (round = 0; round < 4; round++) {
+				entry = &entries[_shrx_u64(bits, BIT_BUFFER_WIDTH - DECODE_TABLE_BITS)];
+				if (entry->count == 0) {
+					break;
+				}
+				out[i] = entry->ch[0];
+				out[i + 1] = entry->ch[1];
+				i += entry->count;
+				bits = _shlx_u64(bits, entry->length);
+				bits_count -= entry->length;
+			}
+		}
+		bs->bit_buffer = bits;
+		bs->bit_buffer_count = bits_count;
+		bs->block_position = next - bs->block;
+
+		// Stream reads the next block or checks the end of the data
+		if (i < count) {
+			ulong n = (count - i < DECODE_SLOW_CHARS) ? count - i : DECODE_SLOW_CHARS;
+			if (decode_chars_scalar(bs, table, out + i, n) == FAILURE) {
+				return FAILURE;
+			}
+			i += n;
+		}
+	}
+	return SUCCESS;
+}
+
+// Same readers as in decode_interleaved_scalar, but the refill loads whole
+// word and shifts it after the waiting bits with shrx, and the lookups take
+// the top bits with shrx and drop them with shlx. The refill leaves at least
+// 56 bits, so four lookups are made between the refills (linked code is at
+// most 15 bits and decode_linked fills the reader before it)
+TARGET_BMI2
+int decode_interleaved_bmi2(uchar** streams, ulong* sizes, DECODETABLE* table, uchar* out, ulong count)
+{
+	BITREADER readers[INTERLEAVE_STREAMS];
+	ulong positions[INTERLEAVE_STREAMS];
+	DECODEENTRY* entries = table->entries;
+	uint round;
+	uint s;
+
+	// Uniform table takes no bits from the streams
+	if (table->uniform) {
+		memset(out, table->uniform_ch, count);
+		return SUCCESS;
+	}
+	for (s = 0; s < INTERLEAVE_STREAMS; s++) {
+		memset(&readers[s], 0, sizeof(BITREADER));
+		readers[s].next = streams[s];
+		readers[s].end = streams[s] + sizes[s];
+		positions[s] = s;
+	}
+
+	// Main loop runs while every stream has room for eight more characters
+	while ((positions[0] + 7 * INTERLEAVE_STREAMS < count) && (positions[1] + 7 * INTERLEAVE_STREAMS < count) &&
+		(positions[2] + 7 * INTERLEAVE_STREAMS < count) && (positions[3] + 7 * INTERLEAVE_STREAMS < count)) {
+		for (s = 0; s < INTERLEAVE_STREAMS; s++) {
+			BITREADER* reader = &readers[s];
+			uint64 word;
+			if (reader->end - reader->next < BIT_BUFFER_BYTES) {
+				fill_reader(reader);
+				continue;
+			}
+			memcpy(&word, reader->next, sizeof(word));
+			reader->bits |= _shrx_u64(__builtin_bswap64(word), reader->count);
+			reader->next += (BIT_BUFFER_WIDTH - 1 - reader->count) >> 3;
+			reader->count |= BIT_BUFFER_WIDTH - UCHAR_WIDTH;
+		}
+		for (round = 0; round < 4; round++) {
+			for (s = 0; s < INTERLEAVE_STREAMS; s++) {
+				BITREADER* reader = &readers[s];
+				DECODEENTRY* entry = &entries[_shrx_u64(reader->bits, BIT_BUFFER_WIDTH - DECODE_TABLE_BITS)];
+				if (entry->count == 0) {
+					if (decode_linked(reader, table, &out[positions[s]]) == FAILURE) {
+						return FAILURE;
+					}
+					positions[s] += INTERLEAVE_STREAMS;
+					continue;
+				}
+				out[positions[s]] = entry->ch[0];
+				out[positions[s] + INTERLEAVE_STREAMS] = entry->ch[1];
+				positions[s] += entry->count * INTERLEAVE_STREAMS;
+				reader->bits = _shlx_u64(reader->bits, entry->length);
+				reader->count -= entry->length;
+			}
+		}
+	}
+
+	// Finish each stream one character at a time
+	for (s = 0; s < INTERLEAVE_STREAMS; s++) {
+		BITREADER* reader = &readers[s];
+		while (positions[s] < count) {
+			DECODEENTRY* entry;
+			fill_reader(reader);
+			entry = &entries[_shrx_u64(reader->bits, BIT_BUFFER_WIDTH - DECODE_TABLE_BITS)];
+			if (entry->count == 0) {
+				if (decode_linked(reader, table, &out[positions[s]]) == FAILURE) {
+					return FAILURE;
+				}
+				positions[s] += INTERLEAVE_STREAMS;
+				continue;
+			}
+			out[positions[s]] = entry->ch[0];
+			positions[s] += INTERLEAVE_STREAMS;
+			if ((entry->count > 1) && (positions[s] < count)) {
+				out[positions[s]] = entry->ch[1];
+				positions[s] += INTERLEAVE_STREAMS;
+				reader->bits = _shlx_u64(reader->bits, entry->length);
+				reader->count -= entry->length;
+			} else {
+				reader->bits = _shlx_u64(reader->bits, entry->first_length);
+				reader->count -= entry->first_length;
+			}
+		}
+		// Codes must not run over the end of the stream
+		if (reader->padding > reader->count) {
+			fprintf(stderr, "Unexpected end of file!\n");
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+
+#else
+
+// Other processors copy one entry at a time
+int fill_lookup_avx2(DECODETABLE* table, ushort* lookup)
+{
+	return fill_lookup_scalar(table, lookup);
+}
+
+// Other processors write through the stream
+int encode_strided_bmi2(BITSTREAM* bs, CODETABLE* table, uchar* in, ulong count, uint stride)
+{
+	return encode_strided_scalar(bs, table, in, count, stride);
+}
+
+// Other processors read through the stream
+int decode_chars_bmi2(BITSTREAM* bs, DECODETABLE* table, uchar* out, ulong count)
+{
+	return decode_chars_scalar(bs, table, out, count);
+}
+
+// Other processors use plain shifts
+int decode_interleaved_bmi2(uchar** streams, ulong* sizes, DECODETABLE* table, uchar* out, ulong count)
+{
+	return decode_interleaved_scalar(streams, sizes, table, out, count);
+}
+
+#endif
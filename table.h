@@ -0,0 +1,96 @@
+/**
+ * table.h
+ *
+ * Lookup tables for encoding and decoding characters without walking the tree
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 16:40
+ */
+
+#ifndef __INCLUDES_TABLE_H__
+#define __INCLUDES_TABLE_H__
+
+#ifndef __USHORT_DEFINED__
+#define __USHORT_DEFINED__
+typedef unsigned short ushort;
+#endif
+
+// Number of bits resolved by the first level of the decoding table
+#define DECODE_TABLE_BITS 11
+
+// Maximum number of bits resolved by single subtable of the decoding table
+#define DECODE_SUBTABLE_BITS 8
+
+// Maximum length of single character code
+#define MAX_CODE_LENGTH 56
+
+// Number of bitstreams the characters are spread over in interleaved blocks
+#define INTERLEAVE_STREAMS 4
+
+// Holds the code of every character in the tree
+typedef struct CODETABLE
+{
+	uint64 code[MAX_CHAR];		// code bits of the character (lowest bits used)
+	uchar length[MAX_CHAR];		// code length of the character (0 if not used)
+	int uniform;				// set if only one character is coded (0 bits)
+	uchar uniform_ch;			// the character for uniform table
+} CODETABLE;
+
+// Describes what single lookup of the decoding table resolves
+typedef struct DECODEENTRY
+{
+	uchar ch[2];				// characters resolved by this entry
+	uchar count;				// how many characters are resolved (0 if linked)
+	uchar length;				// how many bits are consumed by all characters
+	uchar first_length;			// how many bits are consumed by first character
+	uchar link_bits;			// how many bits are used to index the subtable
+	uint link;					// location of the subtable in the entry list
+} DECODEENTRY;
+
+// Holds the decoding table and all its subtables
+typedef struct DECODETABLE
+{
+	DECODEENTRY* entries;		// first level table followed by the subtables
+	uint entry_count;			// how many entries are in use
+	uint entry_capacity;		// how many entries are allocated
+	int uniform;				// set if only one character is coded (0 bits)
+	uchar uniform_ch;			// the character for uniform table
+} DECODETABLE;
+
+// Finds the codes of all characters in the tree, fails without a message if
+// the tree is deeper than MAX_CODE_LENGTH
+int build_code_table(TREE* tree, CODETABLE* table);
+
+// Constructs decoding table for the given codes
+DECODETABLE* build_decode_table(CODETABLE* codes);
+
+// Fills the existing decoding table for the given codes, entries allocated
+// by the earlier calls are reused (table must be zeroed before first use)
+int fill_decode_table(DECODETABLE* table, CODETABLE* codes);
+
+// Releases memory allocated by the decoding table
+void release_decode_table(DECODETABLE* table);
+
+// Encodes count characters from the input buffer to the stream
+int encode_chars(BITSTREAM* bs, CODETABLE* table, uchar* in, ulong count);
+
+// Encodes count characters taking every stride-th character of the input
+int encode_strided(BITSTREAM* bs, CODETABLE* table, uchar* in, ulong count, uint stride);
+
+// Decodes count characters from the stream to the output buffer
+int decode_chars(BITSTREAM* bs, DECODETABLE* table, uchar* out, ulong count);
+
+// Decodes count characters from the interleaved streams in memory, character
+// i of the output is taken from the stream i % INTERLEAVE_STREAMS
+int decode_interleaved(uchar** streams, ulong* sizes, DECODETABLE* table, uchar* out, ulong count);
+
+// Encodes count characters with the code table which the previous character
+// selects from the tables (first character follows the character 0)
+int encode_contexts(BITSTREAM* bs, CODETABLE* tables, uchar* map, uchar* in, ulong count);
+
+// Decodes count characters from the stream in memory, code table of each
+// character is selected by the previous character (same as encode_contexts)
+// from table_count tables
+int decode_contexts(uchar* stream, ulong size, DECODETABLE* tables, uint table_count, uchar* map, uchar* out, ulong count);
+
+#endif // __INCLUDES_TABLE_H__
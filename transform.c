@@ -0,0 +1,424 @@
+/**
+ * transform.c
+ *
+ * Implementation of the block transforms
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 21:40
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree.h"
+#include "transform.h"
+
+#ifndef SUCCESS
+#define SUCCESS 0
+#endif
+
+#ifndef FAILURE
+#define FAILURE 1
+#endif
+
+// Tells if the suffix at i is the leftmost suffix of S type (smaller than
+// the suffix which follows it) after the suffix of L type
+#define is_lms(types, i) (((i) > 0) && (types)[i] && !(types)[(i) - 1])
+
+/**
+ * Definitions for the private methods of the library
+ */
+
+// Sorts the suffixes of the string of n characters from 0 to k (last
+// character is the only 0) to the suffix array by induced sorting (SA-IS)
+// Returns error code
+int sort_suffixes(int* string, int* sa, int n, int k);
+
+// Finds the start or the end of the bucket of each character in the suffix
+// array
+void find_buckets(int* string, int n, int k, int* buckets, int end);
+
+// Sorts the L type suffixes from the sorted suffixes, then the S type
+// suffixes from the L type suffixes
+void induce_suffixes(int* string, uchar* types, int* sa, int n, int k, int* buckets);
+
+/**
+ * Implementation of the public library methods
+ */
+
+// Characters are moved up by one, so the end of the block is the smallest
+// character, and the character before every suffix is read from the suffix
+// array
+int bwt_encode(uchar* block, ulong size, uchar* output, uint* primary)
+{
+	int* string;
+	int* sa;
+	ulong i;
+	ulong j = 0;
+	int result;
+
+	if (size > TRANSFORM_MAX_SIZE) {
+		fprintf(stderr, "Block is too large for the transform!\n");
+		return FAILURE;
+	}
+	string = (int*)malloc((size + 1) * sizeof(int));
+	sa = (int*)malloc((size + 1) * sizeof(int));
+	if ((string == NULL) || (sa == NULL)) {
+		perror("Could not allocate memory for the suffix array (out of memory)");
+		free(string);
+		free(sa);
+		return FAILURE;
+	}
+	for (i = 0; i < size; i++) {
+		string[i] = block[i] + 1;
+	}
+	string[size] = 0;
+	result = sort_suffixes(string, sa, (int)size + 1, MAX_CHAR);
+	if (result == SUCCESS) {
+		for (i = 0; i <= size; i++) {
+			if (sa[i] == 0) {
+				*primary = (uint)i;
+			} else {
+				output[j++] = block[sa[i] - 1];
+			}
+		}
+	}
+	free(string);
+	free(sa);
+	return result;
+}
+
+// Row of each character is followed back from the row of the end of the
+// block (row 0), every character is preceded by the character in the row
+// of the same occurrence among the first characters of the rows
+int bwt_decode(uchar* input, ulong size, uint primary, uchar* block)
+{
+	uint* previous;
+	ulong starts[MAX_CHAR];
+	ulong total = 1;
+	ulong row;
+	ulong i;
+	uint c;
+
+	if ((primary == 0) || (primary > size) || (size > TRANSFORM_MAX_SIZE)) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	previous = (uint*)malloc((size + 1) * sizeof(uint));
+	if (previous == NULL) {
+		perror("Could not allocate memory for the transform (out of memory)");
+		return FAILURE;
+	}
+
+	// Rows of each character start after the rows of the smaller characters
+	// and the row of the end of the block
+	memset(starts, 0, sizeof(starts));
+	for (i = 0; i < size; i++) {
+		starts[input[i]]++;
+	}
+	for (c = 0; c < MAX_CHAR; c++) {
+		ulong count = starts[c];
+		starts[c] = total;
+		total += count;
+	}
+	for (i = 0; i < size; i++) {
+		previous[i + (i >= primary)] = (uint)starts[input[i]]++;
+	}
+
+	// Primary row is the whole block, it is reached only after the first
+	// character unless the input is corrupted
+	row = 0;
+	for (i = size; i > 0; i--) {
+		if (row == primary) {
+			free(previous);
+			fprintf(stderr, "Archive is corrupted!\n");
+			return FAILURE;
+		}
+		block[i - 1] = input[row - (row > primary)];
+		row = previous[row];
+	}
+	free(previous);
+	return SUCCESS;
+}
+
+// List starts with the characters in their natural order, recent characters
+// are found near its front, so the search is short
+void mtf_encode(uchar* block, ulong size)
+{
+	uchar list[MAX_CHAR];
+	ulong i;
+	uint c;
+
+	for (c = 0; c < MAX_CHAR; c++) {
+		list[c] = (uchar)c;
+	}
+	for (i = 0; i < size; i++) {
+		uchar character = block[i];
+		uint rank = 0;
+		while (list[rank] != character) {
+			rank++;
+		}
+		memmove(list + 1, list, rank);
+		list[0] = character;
+		block[i] = (uchar)rank;
+	}
+}
+
+// Same list is kept while decoding
+void mtf_decode(uchar* block, ulong size)
+{
+	uchar list[MAX_CHAR];
+	ulong i;
+	uint c;
+
+	for (c = 0; c < MAX_CHAR; c++) {
+		list[c] = (uchar)c;
+	}
+	for (i = 0; i < size; i++) {
+		uint rank = block[i];
+		uchar character = list[rank];
+		memmove(list + 1, list, rank);
+		list[0] = character;
+		block[i] = character;
+	}
+}
+
+// Run of length n takes about log2(n) characters, ranks 254 and 255 take two
+// characters
+void zero_run_encode(uchar* block, ulong size, uchar* output, ulong* output_size)
+{
+	ulong position = 0;
+	ulong i = 0;
+
+	while (i < size) {
+		if (block[i] == 0) {
+			ulong run = 0;
+			while ((i < size) && (block[i] == 0)) {
+				run++;
+				i++;
+			}
+			while (run > 0) {
+				if (run & 1) {
+					output[position++] = ZERO_RUN_A;
+					run = (run - 1) / 2;
+				} else {
+					output[position++] = ZERO_RUN_B;
+					run = (run - 2) / 2;
+				}
+			}
+			continue;
+		}
+		if (block[i] >= ZERO_RUN_ESCAPE - 1) {
+			output[position++] = ZERO_RUN_ESCAPE;
+			output[position++] = block[i] - (ZERO_RUN_ESCAPE - 1);
+		} else {
+			output[position++] = block[i] + 1;
+		}
+		i++;
+	}
+	*output_size = position;
+}
+
+// Digits of the run are added up until the first other character
+int zero_run_decode(uchar* input, ulong input_size, uchar* block, ulong size)
+{
+	ulong position = 0;
+	ulong i = 0;
+
+	while (i < input_size) {
+		if (input[i] <= ZERO_RUN_B) {
+			ulong run = 0;
+			ulong weight = 1;
+			while ((i < input_size) && (input[i] <= ZERO_RUN_B) && (run <= size - position)) {
+				run += (input[i++] == ZERO_RUN_A) ? weight : 2 * weight;
+				weight *= 2;
+			}
+			if (run > size - position) {
+				break;
+			}
+			memset(block + position, 0, run);
+			position += run;
+			continue;
+		}
+		if (position == size) {
+			break;
+		}
+		if (input[i] == ZERO_RUN_ESCAPE) {
+			if ((i + 1 == input_size) || (input[i + 1] > 1)) {
+				break;
+			}
+			block[position++] = ZERO_RUN_ESCAPE - 1 + input[i + 1];
+			i += 2;
+		} else {
+			block[position++] = input[i++] - 1;
+		}
+	}
+	if ((i != input_size) || (position != size)) {
+		fprintf(stderr, "Archive is corrupted!\n");
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+/**
+ * Private methods of the library
+ */
+
+// Leftmost S type suffixes are put to the ends of their buckets and the
+// other suffixes are induced from them, which sorts the substrings between
+// them, then the substrings are named by their order and the suffixes of
+// the string of the names are sorted the same way (recursively unless all
+// the names differ), which gives the order of the leftmost S type suffixes
+// to induce the whole suffix array from
+int sort_suffixes(int* string, int* sa, int n, int k)
+{
+	uchar* types;
+	int* buckets;
+	int* names;
+	int count = 0;
+	int name = 0;
+	int previous = -1;
+	int i;
+	int j;
+	int result = SUCCESS;
+
+	types = (uchar*)malloc(n);
+	buckets = (int*)malloc((k + 1) * sizeof(int));
+	if ((types == NULL) || (buckets == NULL)) {
+		perror("Could not allocate memory for the suffix array (out of memory)");
+		free(types);
+		free(buckets);
+		return FAILURE;
+	}
+
+	// Suffix is of S type if it is smaller than the suffix which follows it,
+	// last suffix is the smallest
+	types[n - 1] = 1;
+	for (i = n - 2; i >= 0; i--) {
+		types[i] = (string[i] < string[i + 1]) || ((string[i] == string[i + 1]) && types[i + 1]);
+	}
+
+	// Sort the substrings between the leftmost S type suffixes
+	find_buckets(string, n, k, buckets, 1);
+	for (i = 0; i < n; i++) {
+		sa[i] = -1;
+	}
+	for (i = 1; i < n; i++) {
+		if (is_lms(types, i)) {
+			sa[--buckets[string[i]]] = i;
+		}
+	}
+	induce_suffixes(string, types, sa, n, k, buckets);
+
+	// Sorted substrings are moved to the front and named, substrings which
+	// are equal get the same name
+	for (i = 0; i < n; i++) {
+		if (is_lms(types, sa[i])) {
+			sa[count++] = sa[i];
+		}
+	}
+	for (i = count; i < n; i++) {
+		sa[i] = -1;
+	}
+	for (i = 0; i < count; i++) {
+		int position = sa[i];
+		int differs = 0;
+		int d;
+		for (d = 0; d < n; d++) {
+			if ((previous < 0) || (string[position + d] != string[previous + d]) || (types[position + d] != types[previous + d])) {
+				differs = 1;
+				break;
+			}
+			if ((d > 0) && (is_lms(types, position + d) || is_lms(types, previous + d))) {
+				break;
+			}
+		}
+		if (differs) {
+			name++;
+			previous = position;
+		}
+		sa[count + position / 2] = name - 1;
+	}
+	for (i = n - 1, j = n - 1; i >= count; i--) {
+		if (sa[i] >= 0) {
+			sa[j--] = sa[i];
+		}
+	}
+
+	// Names are in the order of the substrings in the string, suffixes of
+	// the names are sorted to the front of the suffix array
+	names = sa + n - count;
+	if (name < count) {
+		result = sort_suffixes(names, sa, count, name - 1);
+	} else {
+		for (i = 0; i < count; i++) {
+			sa[names[i]] = i;
+		}
+	}
+
+	// Leftmost S type suffixes are put to their buckets in their order and
+	// the suffix array is induced again
+	if (result == SUCCESS) {
+		for (i = 1, j = 0; i < n; i++) {
+			if (is_lms(types, i)) {
+				names[j++] = i;
+			}
+		}
+		for (i = 0; i < count; i++) {
+			sa[i] = names[sa[i]];
+		}
+		for (i = count; i < n; i++) {
+			sa[i] = -1;
+		}
+		find_buckets(string, n, k, buckets, 1);
+		for (i = count - 1; i >= 0; i--) {
+			j = sa[i];
+			sa[i] = -1;
+			sa[--buckets[string[j]]] = j;
+		}
+		induce_suffixes(string, types, sa, n, k, buckets);
+	}
+	free(types);
+	free(buckets);
+	return result;
+}
+
+// End of the bucket is the start of the next bucket
+void find_buckets(int* string, int n, int k, int* buckets, int end)
+{
+	int total = 0;
+	int i;
+
+	memset(buckets, 0, (k + 1) * sizeof(int));
+	for (i = 0; i < n; i++) {
+		buckets[string[i]]++;
+	}
+	for (i = 0; i <= k; i++) {
+		total += buckets[i];
+		buckets[i] = end ? total : total - buckets[i];
+	}
+}
+
+// Suffixes of L type are put to the starts of their buckets going forward,
+// S type suffixes to the ends of their buckets going backward
+void induce_suffixes(int* string, uchar* types, int* sa, int n, int k, int* buckets)
+{
+	int i;
+	int j;
+
+	find_buckets(string, n, k, buckets, 0);
+	for (i = 0; i < n; i++) {
+		j = sa[i] - 1;
+		if ((j >= 0) && !types[j]) {
+			sa[buckets[string[j]]++] = j;
+		}
+	}
+	find_buckets(string, n, k, buckets, 1);
+	for (i = n - 1; i >= 0; i--) {
+		j = sa[i] - 1;
+		if ((j >= 0) && types[j]) {
+			sa[--buckets[string[j]]] = j;
+		}
+	}
+}
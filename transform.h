@@ -0,0 +1,56 @@
+/**
+ * transform.h
+ *
+ * Transforms which are applied to the block before its characters are
+ * coded: Burrows-Wheeler transform, move-to-front and coding of the zero
+ * runs, so the order-0 codes see the structure of the higher orders
+ *
+ * @author Janno Pldma
+ * @version 16.10.2026 21:40
+ */
+
+#ifndef __INCLUDES_TRANSFORM_H__
+#define __INCLUDES_TRANSFORM_H__
+
+// Largest block the suffix array can sort (suffixes are numbered by int)
+#define TRANSFORM_MAX_SIZE 0x40000000UL
+
+// Characters of the zero runs, length of the run is written in bijective
+// base 2 with RUNA for digit 1 and RUNB for digit 2 (least significant first)
+#define ZERO_RUN_A 0
+#define ZERO_RUN_B 1
+
+// Character which is followed by the byte telling the two largest ranks
+// (other ranks are written as rank + 1)
+#define ZERO_RUN_ESCAPE 255
+
+// Returns the largest size the zero runs of size ranks are coded to
+#define zero_run_bound(size) (2 * (size))
+
+// Writes the last characters of the sorted rotations of the block (the end
+// of the block is the smallest character) to the output, primary tells the
+// row of the whole block which has no character in the output
+// Returns error code
+int bwt_encode(uchar* block, ulong size, uchar* output, uint* primary);
+
+// Restores the block from the output of bwt_encode
+// Returns error code (fails for the primary row which does not fit)
+int bwt_decode(uchar* input, ulong size, uint primary, uchar* block);
+
+// Replaces every character of the block with its rank in the list of the
+// recently seen characters, which is then moved to the front
+void mtf_encode(uchar* block, ulong size);
+
+// Restores the characters of the block from their ranks
+void mtf_decode(uchar* block, ulong size);
+
+// Codes the runs of zero ranks and the other ranks to the output (which must
+// hold zero_run_bound characters), output_size tells its size
+void zero_run_encode(uchar* block, ulong size, uchar* output, ulong* output_size);
+
+// Restores the ranks of the block from the zero runs, the ranks must fill the
+// block exactly
+// Returns error code
+int zero_run_decode(uchar* input, ulong input_size, uchar* block, ulong size);
+
+#endif // __INCLUDES_TRANSFORM_H__
@@ -12,6 +12,8 @@
 #include <string.h>
 
 #include "tree.h"
+#include "pool.h"
+#include "histogram.h"
 
 #ifndef SUCCESS
 #define SUCCESS 0
@@ -21,8 +23,18 @@
 #define FAILURE 1
 #endif
 
-// Type for defining how many times each character occurs in compressed file
-typedef uint FREQTABLE[MAX_CHAR];
+// Queue of the branch nodes, branches are created in the order of their
+// frequencies, but from the branches of equal frequency the newest one is
+// taken first (so the queue is split to runs of equal frequency and every
+// run is taken like a stack)
+typedef struct BRANCHQUEUE
+{
+	NODE* nodes[MAX_CHAR];	// Branches in the order they were created
+	uint head;				// First branch of the current run
+	uint run_count;			// How many branches are left in the current run
+	uint limit;				// First branch after the current run
+	uint tail;				// Where the next branch is added
+} BRANCHQUEUE;
 
 /*
  * Definitions for all functions this library is using
@@ -31,17 +43,21 @@ typedef uint FREQTABLE[MAX_CHAR];
 // Calculates frequencies of all characters in file we are compressing
 int calc_freq_table(FILE* file_in, FREQTABLE freq_table);
 
-// Initializes list of nodes in the tree, returns not 0 on success
-int init_node_list(TREE* tree, FREQTABLE freq_table);
+// Creates leaf node for each character and sorts them in the order they
+// are merged, returns the number of leafs
+uint init_leafs(TREE* tree, FREQTABLE freq_table, NODE** leafs);
 
 // Function for sorting nodes by the frequency of the character it contains
 int compare_nodes(const void* n1, const void* n2);
 
-// Adds new node to the node list depending on its value
-void add_node(NODE** nodes, uint count, NODE* node);
+// Returns the branch which should be taken next (NULL if there is none)
+NODE* peek_branch(BRANCHQUEUE* queue);
+
+// Adds new branch to the end of the queue
+void push_branch(BRANCHQUEUE* queue, NODE* node);
 
-// Releases all memory allocated by this node and all its subnodes
-void release_node(NODE* node);
+// Takes the node of the lowest frequency from either of the queues
+NODE* take_node(NODE** leafs, uint* leaf, uint leaf_count, BRANCHQUEUE* queue);
 
 /*
  * Implementation of all public library methods
@@ -50,183 +66,135 @@ void release_node(NODE* node);
 // Builds new character/huffmann tree based on information from the source file
 TREE* build_tree(FILE* file_in)
 {
-	TREE* tree;
-	NODE* sorted_nodes[MAX_CHAR];
-	uint node_count;
-	NODE* smallest;
-	NODE* small;
-	NODE* node;
-	uint i;
-
 	// Calculate character frequencies
 	FREQTABLE freq_table;
 	if (calc_freq_table(file_in, freq_table) == FAILURE) {
 		return NULL;
 	}
-	
-	// Allocate memory for the tree
-	tree = (TREE*)malloc(sizeof(TREE));
+	return build_freq_tree(freq_table);
+}
+
+// Builds new character/huffmann tree based on given character frequencies
+TREE* build_freq_tree(FREQTABLE freq_table)
+{
+	// Allocate memory for the tree and all of its nodes at once
+	TREE* tree = (TREE*)malloc(sizeof(TREE));
 	if (tree == NULL) {
 		perror("Failed to allocate memory for frequency-tree (out of memory)");
 		return NULL;
 	}
-	tree->root = NULL;
-	
+	init_freq_tree(tree, freq_table);
+	return tree;
+}
+
+// Arranges nodes to the tree, creating branches and leafs according to
+// Huffmann algorithm
+// Leafs are sorted once, branches are created in the order of their
+// frequencies, so two least frequent nodes are always at the front of
+// either queue and each merge takes constant time
+void init_freq_tree(TREE* tree, FREQTABLE freq_table)
+{
+	NODE* leafs[MAX_CHAR];
+	BRANCHQUEUE queue;
+	uint leaf_count;
+	uint leaf = 0;
+	uint i;
+	NODE* smallest;
+	NODE* small;
+	NODE* node = NULL;
+
 	// Create list of leaf nodes
-	if (init_node_list(tree, freq_table) == FAILURE) {
-		// Release the memory allocated by the tree
-		release_tree(tree);
-		return NULL;
+	clear_tree(tree);
+	leaf_count = init_leafs(tree, freq_table, leafs);
+	if (leaf_count == 0) {
+		return;
 	}
+	memset(&queue, 0, sizeof(BRANCHQUEUE));
 	
-	// Sort the nodes depending on character frequency in file
-	memcpy(sorted_nodes, tree->node_list, MAX_CHAR * sizeof(NODE*));
-	qsort(sorted_nodes, MAX_CHAR, sizeof(NODE*), compare_nodes);
-	
-	// Find out how many nodes are in the list
-	// (maximum is the number of different characters [256])
-	node_count = 0;
-	while ((sorted_nodes[node_count] != NULL) && (node_count < MAX_CHAR)) {
-		node_count++;
-	}
-	
-	// Arrange nodes to the tree, creating branches and leaf according to
-	// Huffmann algorithm
-	// Loops through all the nodes by taking least frequent character nodes
-	// adding them together and inserting to the list
-	// Each iteration decreases elements in temporary node list by one element
-	for ( ; node_count > 1; node_count--) {
-		// Two lowest frequency characters in list
-		smallest = sorted_nodes[node_count - 1];
-		sorted_nodes[node_count - 1] = NULL;
-		small = sorted_nodes[node_count - 2];
-		sorted_nodes[node_count - 2] = NULL;
+	// Each iteration takes two lowest frequency nodes and adds them together,
+	// n leafs are merged with n - 1 branches
+	for (i = 1; i < leaf_count; i++) {
+		smallest = take_node(leafs, &leaf, leaf_count, &queue);
+		small = take_node(leafs, &leaf, leaf_count, &queue);
 		
-		// Allocate space for branch node
-		node = (NODE*)malloc(sizeof(NODE));
-		if (node == NULL) {
-			perror("Failed to allocate memory for branch node (out of memory)");
-			// Release nodes we just extracted from the list
-			release_node(smallest);
-			release_node(small);
-			// Release all nodes in the list
-			for (i = 0; i < node_count - 2; i++) {
-				if (sorted_nodes[i] != NULL) {
-					release_node(sorted_nodes[i]);
-				}
-			}
-			// Release memory allocated by the tree structure
-			release_tree(tree);
-			return NULL;
-		}
-		
-		// Set initial values for the branch node
-		node->ch = 0;
+		// Set initial values for the branch node (nodes of the tree are
+		// always available for the branches)
+		node = new_node(tree);
 		node->freq = smallest->freq + small->freq;
-		node->parent = NULL;
 		
 		// Set leafs for this node (including parent info for the leafs)
 		node->left = smallest;
 		node->left->parent = node;
 		node->right = small;
 		node->right->parent = node;
-		
-		// Insert node to the nodes list at proper position
-		// (ordered by frequency)
-		add_node(sorted_nodes, node_count - 2, node);
+		push_branch(&queue, node);
 	}
 	
-	// Now there should be exactly one element left which is root node to all
-	// of other nodes
-	tree->root = sorted_nodes[0];
-	
-	return tree;
+	// Last branch is the root node to all of other nodes (or the only leaf,
+	// if there are no branches)
+	tree->root = (node != NULL) ? node : leafs[0];
 }
 
 // Releases memory allocated by the tree structure
 void release_tree(TREE* tree)
 {
-	// If tree already has a root node, then release it and all its child nodes
-	if (tree->root != NULL) {
-		release_node(tree->root);
-	}
-	// Free memory allocated by the tree itself
+	// Nodes are part of the tree, so they are released together with it
 	free(tree);
 }
 
-/**
- * Private methods for the library
- */
+// Removes all nodes from the tree
+void clear_tree(TREE* tree)
+{
+	tree->root = NULL;
+	tree->node_count = 0;
+	memset(tree->node_list, 0, MAX_CHAR * sizeof(NODE*));
+}
 
-// Releases single node and all its childs
-void release_node(NODE* node)
+// Takes next node from the memory of the tree
+NODE* new_node(TREE* tree)
 {
-	// If node has left child, then release it and all its child nodes
-	if (node->left) {
-		release_node(node->left);
-	}
-	// If node has right child, then release it and all its child nodes
-	if (node->right) {
-		release_node(node->right);
+	NODE* node;
+
+	if (tree->node_count >= MAX_NODES) {
+		return NULL;
 	}
-	// Free the memory allocated by the node itself
-	free(node);
+	node = &tree->nodes[tree->node_count++];
+	memset(node, 0, sizeof(NODE));
+	return node;
 }
 
+/**
+ * Private methods for the library
+ */
+
 // Calculate character frequencies by the contents of the input file
 int calc_freq_table(FILE* file_in, FREQTABLE freq_table)
 {
-	// Set all current values in the table 0
-	memset(freq_table, 0, sizeof(FREQTABLE));
-	// Go through the file and calculate each character count in the file
-	while (!feof(file_in)) {
-		int ch = fgetc(file_in);
-		if ((ch == EOF) && ferror(file_in)) {
-			perror("Failed to read from input file");
-			return FAILURE;
-		}
-		freq_table[ch]++;
-	}
-	return SUCCESS;
+	// Go through the file in large pieces and calculate each character count
+	return histogram_file(file_in, freq_table, 1);
 }
 
 // Initialize all leaf nodes for the tree (nodes that contain character info)
-int init_node_list(TREE* tree, FREQTABLE freq_table)
+uint init_leafs(TREE* tree, FREQTABLE freq_table, NODE** leafs)
 {
+	uint count = 0;
 	uint i;
-	uint j;
-
-	// Clear the table (so it contains only NULL pointers)
-	memset(tree->node_list, 0, MAX_CHAR * sizeof(NODE*));
 
-	// Create node object for each character,
-	// which occurs at least once in the file 
+	// Create node object for each character, which occurs at least once in
+	// the file
 	for (i = 0; i < MAX_CHAR; i++) {
 		if (freq_table[i] > 0) {
-			// Allocate memory for the new node
-			NODE* node = (NODE*)malloc(sizeof(NODE));
-			if (node == NULL) {
-				break;
-			}
-			memset(node, 0, sizeof(NODE));
+			NODE* node = new_node(tree);
 			node->ch = (uchar)i;
 			node->freq = freq_table[i];
-			tree->node_list[i] = node;		
+			tree->node_list[i] = node;
+			leafs[count++] = node;
 		}
 	}
 	
-	if (i >= MAX_CHAR)
-		return SUCCESS;
-	
-	perror("Failed to allocate memory for leaf node (out of memory)");
-
-	// Release nodes we have already allocated
-	for (j = 0; j < i; j++) {
-		release_node(tree->node_list[j]);
-	}
-	
-	// Return error code
-	return FAILURE;
+	// Sort the nodes depending on character frequency in file
+	qsort(leafs, count, sizeof(NODE*), compare_nodes);
+	return count;
 }
 
 // Compares nodes for sorting by their character frequencies
@@ -236,30 +204,55 @@ int compare_nodes(const void* n1, const void* n2)
 	NODE* node1 = *((NODE**)n1);
 	NODE* node2 = *((NODE**)n2);
 	
-	// In case we have node which is NULL then it should be at the bottom of the
-	// list, so its value is maximum negative value
-	// Otherwise it equals to the frequency of the character
-	uint v1 = (node1 == NULL) ? -MAX_CHAR : node1->freq;
-	uint v2 = (node2 == NULL) ? -MAX_CHAR : node2->freq;
-	
-	// We want to order nodes so that the bigger frequencies are at the top
-	return v2 - v1;
+	// We want to order nodes so that the smaller frequencies are at the top
+	// (frequencies do not fit to int, so they are not subtracted), from the
+	// characters of equal frequency the last one is merged first
+	if (node1->freq != node2->freq) {
+		return (node1->freq > node2->freq) - (node1->freq < node2->freq);
+	}
+	return (int)node2->ch - (int)node1->ch;
 }
 
-// Inserts new node to the nodes list
-// (inserts it at the position which corresponds to the frequency it holds)
-void add_node(NODE** nodes, uint count, NODE* node)
+// Finds the branch at the top of the current run, starting the next run
+// when the current one is used up
+NODE* peek_branch(BRANCHQUEUE* queue)
 {
-	// Start from the bottom of the list to find out the location of the node
-	for ( ; count > 0; count--) {
-		// Check if current node is bigger than the node we are adding
-		if (nodes[count - 1]->freq >= node->freq) {
-			// Found the correct position of the node, so we're done here
-			break;
+	if (queue->run_count == 0) {
+		if (queue->limit == queue->tail) {
+			return NULL;
+		}
+		// Branches of equal frequency form the next run
+		queue->head = queue->limit;
+		while ((queue->limit < queue->tail) && (queue->nodes[queue->limit]->freq == queue->nodes[queue->head]->freq)) {
+			queue->limit++;
 		}
-		// Move current node one position towards the end of the list
-		nodes[count] = nodes[count - 1];
+		queue->run_count = queue->limit - queue->head;
+	}
+	return queue->nodes[queue->head + queue->run_count - 1];
+}
+
+// Adds the branch to the queue, if the current run is the last one and the
+// branch has the same frequency, it goes to the top of the run
+void push_branch(BRANCHQUEUE* queue, NODE* node)
+{
+	if ((queue->run_count > 0) && (queue->limit == queue->tail) &&
+		(queue->nodes[queue->head]->freq == node->freq)) {
+		queue->nodes[queue->head + queue->run_count] = node;
+		queue->run_count++;
+		queue->limit = queue->head + queue->run_count;
+		queue->tail = queue->limit;
+		return;
+	}
+	queue->nodes[queue->tail++] = node;
+}
+
+// From the leaf and branch of equal frequency the branch is taken first
+NODE* take_node(NODE** leafs, uint* leaf, uint leaf_count, BRANCHQUEUE* queue)
+{
+	NODE* branch = peek_branch(queue);
+	if ((branch != NULL) && ((*leaf >= leaf_count) || (branch->freq <= leafs[*leaf]->freq))) {
+		queue->run_count--;
+		return branch;
 	}
-	// Add the node to the list
-	nodes[count] = node;
+	return leafs[(*leaf)++];
 }
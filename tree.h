@@ -12,6 +12,9 @@
 
 #define MAX_CHAR 256
 
+// Number of nodes in the tree of all characters (leafs and branches)
+#define MAX_NODES (2 * MAX_CHAR - 1)
+
 #ifndef __UCHAR_DEFINED__
 #define __UCHAR_DEFINED__
 typedef unsigned char uchar;
@@ -27,11 +30,19 @@ typedef unsigned int uint;
 typedef unsigned long ulong;
 #endif
 
+#ifndef __UINT64_DEFINED__
+#define __UINT64_DEFINED__
+typedef unsigned long long uint64;
+#endif
+
+// Type for defining how many times each character occurs in compressed file
+typedef uint64 FREQTABLE[MAX_CHAR];
+
 // Describes single object in the tree which contains statistical info
 typedef struct NODE
 {
 	uchar ch;				// What character this node represents
-	uint freq;				// How frequent characters this node contains
+	uint64 freq;			// How frequent characters this node contains
 	struct NODE* parent;	// Parent node for this node
 	struct NODE* left;		// Left child node (NULL if this node is leaf)
 	struct NODE* right;		// Right child node (NULL if this node is leaf)
@@ -42,11 +53,26 @@ typedef struct TREE
 {
 	struct NODE* root;					// Node which is the base for the others
 	struct NODE* node_list[MAX_CHAR];	// Allows easy access to all nodes 
+	struct NODE nodes[MAX_NODES];		// Memory of all the nodes of the tree
+	uint node_count;					// How many nodes are in use
 } TREE;
 
 // Constructs new tree based on file contents
 TREE* build_tree(FILE* file_in);
 
+// Constructs new tree based on given character frequencies
+TREE* build_freq_tree(FREQTABLE freq_table);
+
+// Builds the tree for given character frequencies into the existing tree
+// structure (no memory is allocated, so the tree may be on the stack)
+void init_freq_tree(TREE* tree, FREQTABLE freq_table);
+
+// Removes all nodes from the tree
+void clear_tree(TREE* tree);
+
+// Takes next unused node from the tree (NULL if all nodes are in use)
+NODE* new_node(TREE* tree);
+
 // Releases memory allocated by the tree structure
 void release_tree(TREE* tree);
 